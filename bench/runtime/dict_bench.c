@@ -0,0 +1,203 @@
+#include <not_python.h>
+#include <stdlib.h>
+
+#include "harness.h"
+
+typedef struct {
+    size_t key_size;
+    NpDictKeyCmpFunc cmp;
+    void (*make_key)(uint64_t random, void* out);
+} KeyType;
+
+static void
+make_int_key(uint64_t random, void* out)
+{
+    *(NpInt*)out = (NpInt)(random >> 1);
+}
+
+static void
+make_str_key(uint64_t random, void* out)
+{
+    // 16 hex digits like an identifier that's been built at runtime
+    *(NpString*)out = np_str_fmt("%016llx", (unsigned long long)random);
+}
+
+static const KeyType INT_KEYS = {sizeof(NpInt), np_void_int_eq, make_int_key};
+static const KeyType STR_KEYS = {sizeof(NpString), np_void_str_eq, make_str_key};
+
+static void*
+xmalloc(size_t bytes)
+{
+    void* ptr = malloc(bytes);
+    if (!ptr) abort();
+    return ptr;
+}
+
+static uint8_t*
+make_keys(const KeyType* type, size_t n, uint64_t seed)
+{
+    uint8_t* keys = xmalloc(type->key_size * n);
+    for (size_t i = 0; i < n; i++)
+        type->make_key(bench_random(&seed), keys + i * type->key_size);
+    return keys;
+}
+
+// visiting the keys in another order than they were inserted in keeps the item array
+// from being walked sequentially
+static size_t*
+shuffled_indices(size_t n, uint64_t seed)
+{
+    size_t* indices = xmalloc(sizeof(size_t) * n);
+    for (size_t i = 0; i < n; i++) indices[i] = i;
+    for (size_t i = n - 1; i > 0; i--) {
+        size_t j = bench_random(&seed) % (i + 1);
+        size_t tmp = indices[i];
+        indices[i] = indices[j];
+        indices[j] = tmp;
+    }
+    return indices;
+}
+
+static void
+run_dict(Bench* bench, size_t n, const KeyType* type)
+{
+    uint8_t* keys = make_keys(type, n, 0x9e3779b97f4a7c15ULL);
+    size_t* order = shuffled_indices(n, 42);
+    NpInt value = 0;
+
+    NpDict* dict = np_dict_init(type->key_size, sizeof(NpInt), type->cmp);
+    bench_start(bench);
+    for (size_t i = 0; i < n; i++) {
+        value = (NpInt)i;
+        np_dict_set_item(dict, keys + i * type->key_size, &value);
+    }
+    bench_stop(bench, "set new", n);
+
+    NpInt sum = 0;
+    bench_start(bench);
+    for (size_t i = 0; i < n; i++) {
+        np_dict_get_val(dict, keys + order[i] * type->key_size, &value);
+        sum += value;
+    }
+    bench_stop(bench, "get", n);
+
+    bench_start(bench);
+    for (size_t i = 0; i < n; i++) {
+        value = (NpInt)i;
+        np_dict_set_item(dict, keys + order[i] * type->key_size, &value);
+    }
+    bench_stop(bench, "set existing", n);
+
+    NpDict* merged = np_dict_init(type->key_size, sizeof(NpInt), type->cmp);
+    bench_start(bench);
+    np_dict_update(merged, dict);
+    bench_stop(bench, "update", n);
+
+    // the dict shrinks as it empties
+    bench_start(bench);
+    for (size_t i = 0; i < n; i++) {
+        np_dict_pop_val(dict, keys + order[i] * type->key_size, &value);
+        sum += value;
+    }
+    bench_stop(bench, "pop", n);
+
+    bench_consume(&sum, sizeof(sum));
+    free(keys);
+    free(order);
+}
+
+static void
+dict_int(Bench* bench, size_t n)
+{
+    run_dict(bench, n, &INT_KEYS);
+}
+
+static void
+dict_str(Bench* bench, size_t n)
+{
+    run_dict(bench, n, &STR_KEYS);
+}
+
+// `n` is picked relative to a capacity the dict grows to so the lookup table is as full
+// as the variant says
+static void
+dict_get_at_load(Bench* bench, size_t n)
+{
+    uint8_t* keys = make_keys(&INT_KEYS, n, 7);
+    size_t* order = shuffled_indices(n, 11);
+    NpDict* dict = np_dict_init(sizeof(NpInt), sizeof(NpInt), np_void_int_eq);
+    NpInt value = 0;
+    for (size_t i = 0; i < n; i++)
+        np_dict_set_item(dict, keys + i * sizeof(NpInt), &value);
+
+    NpInt sum = 0;
+    bench_start(bench);
+    for (size_t i = 0; i < n; i++) {
+        np_dict_get_val(dict, keys + order[i] * sizeof(NpInt), &value);
+        sum += value;
+    }
+    bench_stop(bench, "get", n);
+
+    bench_consume(&sum, sizeof(sum));
+    free(keys);
+    free(order);
+}
+
+// keeps the dict at `n` items by deleting the oldest key for every new one, the
+// tombstones left behind force it to rehash every so often
+static void
+dict_churn(Bench* bench, size_t n)
+{
+    size_t ops = n * 8;
+    uint8_t* keys = make_keys(&INT_KEYS, n + ops, 3);
+    NpDict* dict = np_dict_init(sizeof(NpInt), sizeof(NpInt), np_void_int_eq);
+    NpInt value = 0;
+    for (size_t i = 0; i < n; i++)
+        np_dict_set_item(dict, keys + i * sizeof(NpInt), &value);
+
+    bench_start(bench);
+    for (size_t i = 0; i < ops; i++) {
+        np_dict_set_item(dict, keys + (n + i) * sizeof(NpInt), &value);
+        np_dict_del(dict, keys + i * sizeof(NpInt));
+    }
+    bench_stop(bench, "set + del", ops);
+
+    free(keys);
+}
+
+// grows from empty and shrinks back down in turns so every operation is paying for
+// its share of the rehashes
+static void
+dict_grow_shrink(Bench* bench, size_t n)
+{
+    uint8_t* keys = make_keys(&INT_KEYS, n, 5);
+    NpDict* dict = np_dict_init(sizeof(NpInt), sizeof(NpInt), np_void_int_eq);
+    NpInt value = 0;
+    size_t rounds = 8;
+
+    bench_start(bench);
+    for (size_t round = 0; round < rounds; round++) {
+        for (size_t i = 0; i < n; i++)
+            np_dict_set_item(dict, keys + i * sizeof(NpInt), &value);
+        for (size_t i = 0; i < n; i++) np_dict_del(dict, keys + i * sizeof(NpInt));
+    }
+    bench_stop(bench, "set + del all", rounds * n * 2);
+
+    free(keys);
+}
+
+// the lookup table has twice the capacity of the items and the items double when full
+#define LOAD_CAPACITY (DICT_MIN_CAPACITY << 14)
+
+const BenchCase DICT_CASES[] = {
+    {"dict", "int 1k", dict_int, 1000},
+    {"dict", "int 100k", dict_int, 100000},
+    {"dict", "str 1k", dict_str, 1000},
+    {"dict", "str 100k", dict_str, 100000},
+    {"dict", "int load 0.25", dict_get_at_load, LOAD_CAPACITY + 1},
+    {"dict", "int load 0.38", dict_get_at_load, LOAD_CAPACITY * 3 / 4},
+    {"dict", "int load 0.50", dict_get_at_load, LOAD_CAPACITY},
+    {"dict", "int churn 10k", dict_churn, 10000},
+    {"dict", "int grow/shrink", dict_grow_shrink, 100000},
+    {0},
+};
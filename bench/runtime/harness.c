@@ -0,0 +1,247 @@
+#define _GNU_SOURCE
+
+#include "harness.h"
+
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "timing.h"
+
+#define REPEATS_DEFAULT 5
+
+static const char* COUNTER_NAMES[COUNTERS_COUNT] = {
+    [COUNTER_CACHE_MISSES] = "misses/op",
+    [COUNTER_L1D_READ_MISSES] = "l1d/op",
+    [COUNTER_INSTRUCTIONS] = "instr/op",
+};
+
+static const struct perf_event_attr COUNTER_ATTRS[COUNTERS_COUNT] = {
+    [COUNTER_CACHE_MISSES] =
+        {.type = PERF_TYPE_HARDWARE, .config = PERF_COUNT_HW_CACHE_MISSES},
+    [COUNTER_L1D_READ_MISSES] =
+        {.type = PERF_TYPE_HW_CACHE,
+         .config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                   (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    [COUNTER_INSTRUCTIONS] =
+        {.type = PERF_TYPE_HARDWARE, .config = PERF_COUNT_HW_INSTRUCTIONS},
+};
+
+// containers and paranoid kernels refuse these, the times are reported without them
+static void
+open_counters(Bench* bench)
+{
+    for (Counter counter = 0; counter < COUNTERS_COUNT; counter++) {
+        struct perf_event_attr attr = COUNTER_ATTRS[counter];
+        attr.size = sizeof(attr);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        bench->counter_fds[counter] =
+            (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (bench->counter_fds[counter] < 0) bench->counters_errno = errno;
+    }
+}
+
+static void
+close_counters(Bench* bench)
+{
+    for (Counter counter = 0; counter < COUNTERS_COUNT; counter++) {
+        if (bench->counter_fds[counter] >= 0) close(bench->counter_fds[counter]);
+    }
+}
+
+static bool
+has_counters(Bench* bench)
+{
+    for (Counter counter = 0; counter < COUNTERS_COUNT; counter++) {
+        if (bench->counter_fds[counter] >= 0) return true;
+    }
+    return false;
+}
+
+void
+bench_start(Bench* bench)
+{
+    for (Counter counter = 0; counter < COUNTERS_COUNT; counter++) {
+        int fd = bench->counter_fds[counter];
+        if (fd < 0) continue;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    bench->start = wall_seconds();
+}
+
+void
+bench_stop(Bench* bench, const char* name, size_t ops)
+{
+    double seconds = wall_seconds() - bench->start;
+    if (bench->sections_count == SECTIONS_MAX) {
+        fprintf(stderr, "more than %d sections timed by one case\n", SECTIONS_MAX);
+        exit(1);
+    }
+    Sample* sample = bench->section_samples + bench->sections_count;
+    *sample = (Sample){.seconds = seconds};
+    for (Counter counter = 0; counter < COUNTERS_COUNT; counter++) {
+        int fd = bench->counter_fds[counter];
+        if (fd < 0) continue;
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(fd, sample->counters + counter, sizeof(uint64_t)) != sizeof(uint64_t))
+            sample->counters[counter] = 0;
+    }
+    bench->section_names[bench->sections_count] = name;
+    bench->section_ops[bench->sections_count++] = (ops) ? ops : 1;
+}
+
+uint64_t
+bench_random(uint64_t* state)
+{
+    // xorshift64*
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+void
+bench_consume(const void* data, size_t size)
+{
+    static volatile unsigned char sink;
+    const unsigned char* bytes = data;
+    for (size_t i = 0; i < size; i++) sink ^= bytes[i];
+}
+
+static int
+compare_doubles(const void* a, const void* b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+typedef struct {
+    size_t repeats;
+    const char** filters;
+    size_t filters_count;
+} Options;
+
+static bool
+selected(Options* opts, const BenchCase* bench_case)
+{
+    if (opts->filters_count == 0) return true;
+    char name[256];
+    snprintf(name, sizeof(name), "%s/%s", bench_case->group, bench_case->variant);
+    for (size_t i = 0; i < opts->filters_count; i++) {
+        if (strstr(name, opts->filters[i])) return true;
+    }
+    return false;
+}
+
+// every section is reported by its median over the repeats, the counters are those of
+// the repeat with the median time
+static void
+run_case(Options* opts, const BenchCase* bench_case, bool* counters_reported)
+{
+    Bench runs[opts->repeats];
+    for (size_t r = 0; r < opts->repeats; r++) {
+        runs[r] = (Bench){0};
+        open_counters(runs + r);
+        bench_case->run(runs + r, bench_case->n);
+        close_counters(runs + r);
+    }
+    if (!*counters_reported && !has_counters(runs)) {
+        fprintf(
+            stderr,
+            "perf_event_open is unavailable (%s), reporting times only\n",
+            strerror(runs[0].counters_errno)
+        );
+    }
+    *counters_reported = true;
+
+    for (size_t s = 0; s < runs[0].sections_count; s++) {
+        double times[opts->repeats];
+        for (size_t r = 0; r < opts->repeats; r++)
+            times[r] = runs[r].section_samples[s].seconds;
+        qsort(times, opts->repeats, sizeof(double), compare_doubles);
+        double median = times[opts->repeats / 2];
+        Bench* median_run = runs;
+        for (size_t r = 0; r < opts->repeats; r++) {
+            if (runs[r].section_samples[s].seconds == median) median_run = runs + r;
+        }
+
+        double ops = (double)runs[0].section_ops[s];
+        char label[64];
+        snprintf(label, sizeof(label), "%s/%s", bench_case->group, bench_case->variant);
+        printf(
+            "%-24s %-16s %9zu %10.2f %10.2f",
+            label,
+            runs[0].section_names[s],
+            runs[0].section_ops[s],
+            median / ops * 1e9,
+            times[0] / ops * 1e9
+        );
+        for (Counter counter = 0; counter < COUNTERS_COUNT; counter++) {
+            if (median_run->counter_fds[counter] < 0)
+                printf(" %10s", "-");
+            else
+                printf(
+                    " %10.2f",
+                    (double)median_run->section_samples[s].counters[counter] / ops
+                );
+        }
+        printf("\n");
+    }
+}
+
+static Options
+parse_args(int argc, char** argv)
+{
+    Options opts = {.repeats = REPEATS_DEFAULT};
+    opts.filters = malloc(sizeof(char*) * argc);
+    if (!opts.filters) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            opts.repeats = strtoul(argv[++i], NULL, 10);
+            if (opts.repeats == 0) opts.repeats = 1;
+        }
+        else if (argv[i][0] == '-') {
+            fprintf(stderr, "usage: %s [-r repeats] [filter...]\n", argv[0]);
+            exit(1);
+        }
+        else
+            opts.filters[opts.filters_count++] = argv[i];
+    }
+    return opts;
+}
+
+int
+main(int argc, char** argv)
+{
+    Options opts = parse_args(argc, argv);
+    const BenchCase* tables[] = {DICT_CASES, LIST_CASES, STR_CASES};
+    bool counters_reported = false;
+
+    printf(
+        "%-24s %-16s %9s %10s %10s", "case", "section", "ops", "ns/op", "min ns/op"
+    );
+    for (Counter counter = 0; counter < COUNTERS_COUNT; counter++)
+        printf(" %10s", COUNTER_NAMES[counter]);
+    printf("\n");
+
+    for (size_t t = 0; t < sizeof(tables) / sizeof(*tables); t++) {
+        for (const BenchCase* bench_case = tables[t]; bench_case->group; bench_case++) {
+            if (selected(&opts, bench_case))
+                run_case(&opts, bench_case, &counters_reported);
+        }
+    }
+    free(opts.filters);
+    return 0;
+}
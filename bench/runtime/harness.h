@@ -0,0 +1,57 @@
+#ifndef BENCH_HARNESS_H
+#define BENCH_HARNESS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// counted over the timed section of a case when the kernel lets perf_event_open open them
+typedef enum {
+    COUNTER_CACHE_MISSES,
+    COUNTER_L1D_READ_MISSES,
+    COUNTER_INSTRUCTIONS,
+    COUNTERS_COUNT,
+} Counter;
+
+typedef struct {
+    double seconds;
+    uint64_t counters[COUNTERS_COUNT];
+} Sample;
+
+#define SECTIONS_MAX 8
+
+typedef struct {
+    int counter_fds[COUNTERS_COUNT];
+    // why the counters couldn't be opened
+    int counters_errno;
+    double start;
+    // filled in by bench_stop as a case may time more than one section
+    size_t sections_count;
+    const char* section_names[SECTIONS_MAX];
+    size_t section_ops[SECTIONS_MAX];
+    Sample section_samples[SECTIONS_MAX];
+} Bench;
+
+// times the code between the two calls as `ops` operations named `name`
+void bench_start(Bench* bench);
+void bench_stop(Bench* bench, const char* name, size_t ops);
+
+typedef struct {
+    const char* group;
+    // distinguishes cases of the same group run with different parameters
+    const char* variant;
+    void (*run)(Bench* bench, size_t n);
+    size_t n;
+} BenchCase;
+
+// every case file defines a table of cases terminated by an entry with no group
+extern const BenchCase DICT_CASES[];
+extern const BenchCase LIST_CASES[];
+extern const BenchCase STR_CASES[];
+
+// deterministic so every run works on the same data
+uint64_t bench_random(uint64_t* state);
+// stops the compiler from optimizing away a result that's otherwise unused
+void bench_consume(const void* data, size_t size);
+
+#endif
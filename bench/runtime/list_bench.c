@@ -0,0 +1,152 @@
+#include <not_python.h>
+#include <stdlib.h>
+
+#include "harness.h"
+
+static NpList*
+int_list(void)
+{
+    return np_list_init(
+        sizeof(NpInt), np_int_sort_fn, np_int_sort_fn_rev, np_void_int_eq
+    );
+}
+
+static NpList*
+random_int_list(size_t n, uint64_t seed)
+{
+    NpList* list = int_list();
+    for (size_t i = 0; i < n; i++) {
+        NpInt value = (NpInt)(bench_random(&seed) % 1000000);
+        np_list_append(list, &value);
+    }
+    return list;
+}
+
+static void
+list_append_get_set(Bench* bench, size_t n)
+{
+    NpList* list = int_list();
+    bench_start(bench);
+    for (size_t i = 0; i < n; i++) {
+        NpInt value = (NpInt)i;
+        np_list_append(list, &value);
+    }
+    bench_stop(bench, "append", n);
+
+    uint64_t seed = 17;
+    NpInt sum = 0;
+    bench_start(bench);
+    for (size_t i = 0; i < n; i++) {
+        NpInt value;
+        np_list_get_item(list, (NpInt)(bench_random(&seed) % n), &value);
+        sum += value;
+    }
+    bench_stop(bench, "get random", n);
+
+    bench_start(bench);
+    for (size_t i = 0; i < n; i++) {
+        NpInt value = (NpInt)i;
+        np_list_set_item(list, -(NpInt)i - 1, &value);
+    }
+    bench_stop(bench, "set", n);
+
+    // the list shrinks as it empties
+    bench_start(bench);
+    for (size_t i = 0; i < n; i++) {
+        NpInt value;
+        np_list_pop(list, -1, &value);
+        sum += value;
+    }
+    bench_stop(bench, "pop end", n);
+
+    bench_consume(&sum, sizeof(sum));
+}
+
+// every insert and pop at the front moves the whole list
+static void
+list_insert_pop_front(Bench* bench, size_t n)
+{
+    NpList* list = int_list();
+    NpInt value = 0;
+    // insert wants an existing index
+    np_list_append(list, &value);
+
+    bench_start(bench);
+    for (size_t i = 0; i < n; i++) np_list_insert(list, 0, &value);
+    bench_stop(bench, "insert front", n);
+
+    bench_start(bench);
+    for (size_t i = 0; i < n / 2; i++) np_list_insert(list, list->count / 2, &value);
+    bench_stop(bench, "insert middle", n / 2);
+
+    bench_start(bench);
+    for (size_t i = 0; i < n; i++) np_list_pop(list, 0, &value);
+    bench_stop(bench, "pop front", n);
+}
+
+static void
+list_sort(Bench* bench, size_t n)
+{
+    NpList* list = random_int_list(n, 23);
+    bench_start(bench);
+    np_list_sort(list, false);
+    bench_stop(bench, "sort random", n);
+
+    bench_start(bench);
+    np_list_sort(list, false);
+    bench_stop(bench, "sort sorted", n);
+
+    bench_start(bench);
+    np_list_sort(list, true);
+    bench_stop(bench, "sort reversed", n);
+
+    NpList* strs = np_list_init(
+        sizeof(NpString), np_str_sort_fn, np_str_sort_fn_rev, np_void_str_eq
+    );
+    uint64_t seed = 29;
+    for (size_t i = 0; i < n; i++) {
+        NpString str = np_str_fmt("%llx", (unsigned long long)bench_random(&seed));
+        np_list_append(strs, &str);
+    }
+    bench_start(bench);
+    np_list_sort(strs, false);
+    bench_stop(bench, "sort str", n);
+}
+
+// linear searches for elements spread evenly through the list
+static void
+list_search(Bench* bench, size_t n)
+{
+    NpList* list = int_list();
+    for (size_t i = 0; i < n; i++) {
+        NpInt value = (NpInt)i;
+        np_list_append(list, &value);
+    }
+
+    size_t searches = 1000;
+    NpInt found = 0;
+    bench_start(bench);
+    for (size_t i = 0; i < searches; i++) {
+        NpInt value = (NpInt)(i * n / searches);
+        found += np_list_index(list, &value);
+    }
+    bench_stop(bench, "index", searches);
+
+    bench_start(bench);
+    for (size_t i = 0; i < searches; i++) {
+        NpInt value = (NpInt)(i * n / searches);
+        found += np_list_count(list, &value);
+    }
+    bench_stop(bench, "count", searches);
+
+    bench_consume(&found, sizeof(found));
+}
+
+const BenchCase LIST_CASES[] = {
+    {"list", "int 1k", list_append_get_set, 1000},
+    {"list", "int 1m", list_append_get_set, 1000000},
+    {"list", "int 20k", list_insert_pop_front, 20000},
+    {"list", "sort 100k", list_sort, 100000},
+    {"list", "search 10k", list_search, 10000},
+    {0},
+};
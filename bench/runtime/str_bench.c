@@ -0,0 +1,92 @@
+#include <not_python.h>
+#include <stdlib.h>
+
+#include "harness.h"
+
+static NpString
+repeated(const char* pattern, NpInt times)
+{
+    NpString unit = np_str_fmt("%s", pattern);
+    return np_str_mul(unit, times);
+}
+
+// strings of `n` characters that are compared where they differ and where they don't
+static void
+str_compare(Bench* bench, size_t n)
+{
+    NpString a = repeated("a", (NpInt)n);
+    NpString same = repeated("a", (NpInt)n);
+    NpString differs_first = np_str_add(np_str_fmt("b"), repeated("a", (NpInt)n - 1));
+    NpString differs_last = np_str_add(repeated("a", (NpInt)n - 1), np_str_fmt("b"));
+    size_t ops = 100000;
+    NpInt matches = 0;
+
+    bench_start(bench);
+    for (size_t i = 0; i < ops; i++) matches += np_str_eq(a, same);
+    bench_stop(bench, "eq equal", ops);
+
+    bench_start(bench);
+    for (size_t i = 0; i < ops; i++) matches += np_str_eq(a, differs_first);
+    bench_stop(bench, "eq first differs", ops);
+
+    bench_start(bench);
+    for (size_t i = 0; i < ops; i++) matches += np_str_lt(a, differs_last);
+    bench_stop(bench, "lt last differs", ops);
+
+    bench_consume(&matches, sizeof(matches));
+}
+
+static void
+str_build(Bench* bench, size_t n)
+{
+    NpString left = repeated("x", (NpInt)n);
+    NpString right = repeated("y", (NpInt)n);
+    size_t ops = 100000;
+    size_t length = 0;
+
+    bench_start(bench);
+    for (size_t i = 0; i < ops; i++) length += np_str_add(left, right).length;
+    bench_stop(bench, "concat", ops);
+
+    bench_start(bench);
+    for (size_t i = 0; i < ops; i++) length += np_str_mul(left, 4).length;
+    bench_stop(bench, "mul 4", ops);
+
+    // appending one character at a time copies the whole string every time
+    NpString built = np_str_fmt("");
+    NpString one = np_str_fmt("z");
+    bench_start(bench);
+    for (size_t i = 0; i < n * 8; i++) built = np_str_add(built, one);
+    bench_stop(bench, "append char", n * 8);
+    length += built.length;
+
+    bench_consume(&length, sizeof(length));
+}
+
+static void
+str_format(Bench* bench, size_t n)
+{
+    size_t length = 0;
+    bench_start(bench);
+    for (size_t i = 0; i < n; i++) length += np_int_to_str((NpInt)i * 7919).length;
+    bench_stop(bench, "int to str", n);
+
+    bench_start(bench);
+    for (size_t i = 0; i < n; i++) length += np_float_to_str((NpFloat)i / 7).length;
+    bench_stop(bench, "float to str", n);
+
+    bench_start(bench);
+    for (size_t i = 0; i < n; i++) length += np_str_fmt("%s=%li", "key", (long)i).length;
+    bench_stop(bench, "fmt", n);
+
+    bench_consume(&length, sizeof(length));
+}
+
+const BenchCase STR_CASES[] = {
+    {"str", "16 chars", str_compare, 16},
+    {"str", "1k chars", str_compare, 1000},
+    {"str", "16 chars", str_build, 16},
+    {"str", "1k chars", str_build, 1000},
+    {"str", "format", str_format, 100000},
+    {0},
+};
@@ -0,0 +1,188 @@
+#!/usr/bin/env python3
+
+"""
+Builds the workloads in test/bench with npc, runs each of them several times and reports
+the median and standard deviation of the wall time along with the peak RSS.
+
+With --python the same files are also run by python3 (with the typing names npc provides
+as builtins imported first) to compare against CPython. Results can be saved as a
+baseline with --save-baseline, later runs are compared against it and exit with a
+non-zero status if any workload got slower than the threshold allows.
+"""
+
+import os
+import sys
+import json
+import time
+import argparse
+import pathlib
+import statistics
+import subprocess
+
+PROJECT_ROOT = pathlib.Path(__file__).parent.parent
+WORKLOADS_DIR = PROJECT_ROOT / "test/bench"
+BUILD_DIR = PROJECT_ROOT / "npc_build/bench"
+BASELINE_FILE = WORKLOADS_DIR / "baseline.json"
+# lets the workloads run unchanged under python3
+PYTHON_PRELUDE = "from typing import Callable, Dict, List\nFunction = Callable\n"
+
+TERMINAL_RED = "\033[0;31m"
+TERMINAL_GREEN = "\033[0;32m"
+TERMINAL_RESET = "\033[0m"
+
+
+def run_once(command):
+    start = time.perf_counter()
+    process = subprocess.Popen(
+        command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True
+    )
+    output = process.stdout.read()
+    process.stdout.close()
+    # wait4 gives the peak RSS of this process alone rather than of every child so far
+    _, status, usage = os.wait4(process.pid, 0)
+    elapsed = time.perf_counter() - start
+    if os.waitstatus_to_exitcode(status) != 0:
+        sys.stdout.write(output)
+        raise SystemExit(f"`{' '.join(command)}` failed")
+    return elapsed, usage.ru_maxrss, output
+
+
+def measure(command, runs):
+    times = []
+    peak_rss = 0
+    output = None
+    for _ in range(runs):
+        elapsed, rss, output = run_once(command)
+        times.append(elapsed)
+        peak_rss = max(peak_rss, rss)
+    return dict(
+        median=statistics.median(times),
+        stddev=statistics.stdev(times) if len(times) > 1 else 0.0,
+        peak_rss_kib=peak_rss,
+        runs=runs,
+        output=output,
+    )
+
+
+def build(npc, workload, opt_level):
+    BUILD_DIR.mkdir(parents=True, exist_ok=True)
+    binary = BUILD_DIR / workload.stem
+    subprocess.run(
+        [str(npc), str(workload), "-o", str(binary), f"-O{opt_level}"],
+        cwd=PROJECT_ROOT,
+        check=True,
+    )
+    return binary
+
+
+def python_source(workload):
+    path = BUILD_DIR / f"{workload.stem}.py"
+    path.write_text(PYTHON_PRELUDE + workload.read_text())
+    return path
+
+
+def load_baseline():
+    if not BASELINE_FILE.exists():
+        return None
+    return json.loads(BASELINE_FILE.read_text())
+
+
+def format_row(name, measurement, extra=""):
+    return (
+        f"{name:<16} {measurement['median'] * 1000:>10.1f} "
+        f"{measurement['stddev'] * 1000:>9.1f} "
+        f"{measurement['peak_rss_kib'] / 1024:>9.1f}{extra}"
+    )
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument(
+        "workloads", nargs="*", help="names of the workloads to run, defaults to all"
+    )
+    parser.add_argument("--runs", type=int, default=5, help="runs of each workload")
+    parser.add_argument("-O", dest="opt_level", type=int, default=2, choices=range(4))
+    parser.add_argument("--npc", default=str(PROJECT_ROOT / "npc"))
+    parser.add_argument(
+        "--python", action="store_true", help="also time each workload under python3"
+    )
+    parser.add_argument(
+        "--save-baseline",
+        action="store_true",
+        help=f"store the results in {BASELINE_FILE.relative_to(PROJECT_ROOT)}",
+    )
+    parser.add_argument(
+        "--threshold",
+        type=float,
+        default=10.0,
+        help="percent slower than the baseline that counts as a regression",
+    )
+    args = parser.parse_args()
+
+    workloads = sorted(WORKLOADS_DIR.glob("*.np"))
+    if args.workloads:
+        workloads = [w for w in workloads if w.stem in args.workloads]
+        if not workloads:
+            raise SystemExit("no workloads matched")
+
+    baseline = None if args.save_baseline else load_baseline()
+    if baseline and baseline["opt_level"] != args.opt_level:
+        print(f"baseline was taken at -O{baseline['opt_level']}, not comparing")
+        baseline = None
+
+    print(f"{'workload':<16} {'median ms':>10} {'stddev ms':>9} {'rss MiB':>9}")
+    results = {}
+    regressions = []
+    for workload in workloads:
+        binary = build(args.npc, workload, args.opt_level)
+        result = measure([str(binary)], args.runs)
+        results[workload.stem] = result
+
+        extra = ""
+        before = baseline and baseline["results"].get(workload.stem)
+        if before:
+            slower = result["median"] - before["median"]
+            change = slower / before["median"] * 100
+            # a change within the noise of either run isn't a regression
+            noise = max(result["stddev"], before["stddev"]) * 2
+            regressed = change > args.threshold and slower > noise
+            color = TERMINAL_RED if regressed else TERMINAL_GREEN
+            extra += f"  {color}{change:+.1f}% vs baseline{TERMINAL_RESET}"
+            if regressed:
+                regressions.append(workload.stem)
+
+        if args.python:
+            cpython = measure([sys.executable, str(python_source(workload))], args.runs)
+            result["python"] = cpython
+            speedup = cpython["median"] / result["median"]
+            extra += f"  python {cpython['median'] * 1000:.1f} ms ({speedup:.1f}x)"
+            if cpython["output"] != result["output"]:
+                extra += f"  {TERMINAL_RED}output differs from python{TERMINAL_RESET}"
+        print(format_row(workload.stem, result, extra))
+
+    if args.save_baseline:
+        for result in results.values():
+            result.pop("output")
+            result.get("python", {}).pop("output", None)
+        BASELINE_FILE.write_text(
+            json.dumps(
+                {
+                    "date": time.strftime("%Y-%m-%d %H:%M:%S"),
+                    "opt_level": args.opt_level,
+                    "results": results,
+                },
+                indent=4,
+            )
+            + "\n"
+        )
+        print(f"\nsaved baseline to {BASELINE_FILE.relative_to(PROJECT_ROOT)}")
+
+    if regressions:
+        raise SystemExit(
+            f"\n{len(regressions)} workloads regressed by more than "
+            f"{args.threshold:.0f}%: {', '.join(regressions)}"
+        )
+
+
+if __name__ == "__main__":
+    main()
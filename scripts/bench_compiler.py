@@ -0,0 +1,366 @@
+#!/usr/bin/env python3
+
+"""
+Generates synthetic programs of increasing size and reports how long npc spends in each
+phase and how much memory it holds while compiling them.
+
+Each size is a program with that many top level definitions: mostly functions built
+around deeply nested expressions that call one another, with a class every tenth
+definition and a function returning large list, dict and str literals every hundredth.
+npc is run at -O2 with --emit-c-only so the numbers cover npc's optimizer but not cc.
+
+The growth of each phase from one size to the next is reported as an exponent (1.0 is
+linear) so quadratic behaviour stands out, and every run is appended to a history file
+keyed by the git commit so a run can be compared against the previous commit.
+"""
+
+import os
+import re
+import sys
+import json
+import math
+import time
+import argparse
+import pathlib
+import subprocess
+
+PROJECT_ROOT = pathlib.Path(__file__).parent.parent
+WORK_DIR = PROJECT_ROOT / "npc_build/bench-compiler"
+HISTORY_FILE = PROJECT_ROOT / "bench/compiler_history.jsonl"
+# 50k and 100k take minutes and gigabytes so they're only run when asked for with --sizes
+DEFAULT_SIZES = (1000, 2000, 5000, 10000, 20000)
+PHASES = ("lex", "compile", "write")
+# phases this quick are mostly noise so their growth isn't flagged
+MIN_FLAGGED_SECONDS = 0.05
+SUPERLINEAR_EXPONENT = 1.3
+
+CLASS_EVERY = 10
+LITERALS_EVERY = 100
+LITERAL_ELEMENTS = 512
+# how many earlier functions each function calls
+CALLS_PER_FUNCTION = 2
+
+
+def deep_expression(depth, index):
+    """a right leaning expression nested `depth` parentheses deep over x and y"""
+    ops = ("+", "-", "*", "+", "//", "%")
+    expr = "y"
+    for level in range(depth):
+        op = ops[(index + level) % len(ops)]
+        operand = "x" if level % 2 else str(level + index % 7 + 1)
+        if op in ("//", "%"):
+            # keep the divisor non-zero whatever x and y are
+            expr = f"({operand} {op} ({expr} * 0 + {level + 2}))"
+        else:
+            expr = f"({operand} {op} {expr})"
+    return expr
+
+
+def function_definition(index, depth, functions):
+    lines = [f"def f{index}(x: int, y: int) -> int:"]
+    lines.append(f"    a = {deep_expression(depth, index)}")
+    lines.append("    b = a % 1000")
+    lines.append("    if b < 0:")
+    lines.append("        b = -b")
+    for call in range(CALLS_PER_FUNCTION):
+        if not functions:
+            break
+        callee = functions[(index * 31 + call * 17) % len(functions)]
+        lines.append(f"    b = b + {callee}(b % 10, {call}) % 100")
+    lines.append("    return b")
+    return lines
+
+
+def class_definition(index):
+    return [
+        f"class C{index}:",
+        "    count: int",
+        "    ratio: float",
+        "    name: str",
+        "",
+        "    def total(self, n: int) -> int:",
+        f"        return self.count * n + {index}",
+        "",
+        "    def scaled(self, f: float) -> float:",
+        "        return self.ratio * f + self.count",
+        "",
+        "    def describe(self) -> str:",
+        '        return self.name + "!"',
+    ]
+
+
+def literals_definition(index):
+    ints = ", ".join(str((index + i) * 7919 % 100003) for i in range(LITERAL_ELEMENTS))
+    pairs = ", ".join(f"{i}: {i * index % 997}" for i in range(LITERAL_ELEMENTS // 4))
+    text = "".join(chr(ord("a") + (index + i) % 26) for i in range(LITERAL_ELEMENTS * 4))
+    return [
+        f"def literals{index}() -> int:",
+        f"    values = [{ints}]",
+        f"    table = {{{pairs}}}",
+        f'    text = "{text}"',
+        "    if text:",
+        "        return values[3] + table[5]",
+        "    return 0",
+    ]
+
+
+def generate_program(size, depth):
+    lines = []
+    functions = []
+    classes = []
+    literals = []
+    for index in range(size):
+        if index % LITERALS_EVERY == LITERALS_EVERY - 1:
+            lines += literals_definition(index)
+            literals.append(f"literals{index}")
+        elif index % CLASS_EVERY == CLASS_EVERY - 1:
+            lines += class_definition(index)
+            classes.append(f"C{index}")
+        else:
+            lines += function_definition(index, depth, functions)
+            functions.append(f"f{index}")
+        lines += ["", ""]
+
+    # only a sample is run, the benchmark is about compiling the rest
+    lines.append("checksum = 0")
+    for name in functions[:: max(1, len(functions) // 16)]:
+        lines.append(f"checksum = checksum + {name}(3, 4) % 1000")
+    for name in classes[:: max(1, len(classes) // 8)]:
+        lines.append(f'obj_{name} = {name}(2, 1.5, "{name}")')
+        lines.append(f"checksum = checksum + obj_{name}.total(3)")
+    for name in literals[:4]:
+        lines.append(f"checksum = checksum + {name}()")
+    lines.append("print(checksum)")
+    return "\n".join(lines) + "\n"
+
+
+def parse_memory_stats(stderr):
+    """the kilobytes used by each phase from --mem-stats"""
+    memory = {}
+    pattern = re.compile(
+        r"memory after (\w+).*?\n"
+        r"\s+static:.*?([\d.]+) KiB used of ([\d.]+) KiB.*?\n"
+        r"\s+dynamic:.*?([\d.]+) KiB live \(peak ([\d.]+) KiB\)"
+    )
+    for match in pattern.finditer(stderr):
+        phase, used, reserved, live, peak = match.groups()
+        memory[phase] = {
+            "static_kib_used": float(used),
+            "static_kib_reserved": float(reserved),
+            "dynamic_kib_live": float(live),
+            "dynamic_kib_peak": float(peak),
+        }
+    return memory
+
+
+def run_npc(npc, program, jobs):
+    outfile = program.with_suffix("")
+    command = [
+        str(npc),
+        str(program),
+        "-o",
+        str(outfile),
+        "--emit-c-only",
+        "--no-cache",
+        # the optimizer passes only run at -O1 and above
+        "-O2",
+        "--time-phases=json",
+        "--mem-stats",
+        f"-j{jobs}",
+    ]
+    start = time.perf_counter()
+    process = subprocess.Popen(
+        command, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE, text=True
+    )
+    # wait4 reports the peak RSS of this process alone rather than of every child
+    _, status, usage = os.wait4(process.pid, 0)
+    stderr = process.stderr.read()
+    process.stderr.close()
+    elapsed = time.perf_counter() - start
+    if os.waitstatus_to_exitcode(status) != 0:
+        sys.stderr.write(stderr)
+        raise SystemExit(f"npc failed on {program}")
+
+    times = None
+    for line in stderr.splitlines():
+        if line.startswith("{"):
+            times = json.loads(line)
+    if times is None:
+        raise SystemExit(f"npc printed no timings for {program}")
+    for path in WORK_DIR.glob(f"{outfile.name}*.[ch]"):
+        path.unlink()
+
+    return {
+        "wall": elapsed,
+        "peak_rss_kib": usage.ru_maxrss,
+        "phases": {phase: times["phases"][phase] for phase in PHASES},
+        "tokens": times["tokens"],
+        "statements": times["statements"],
+        "c_bytes": times["c_bytes"],
+        "memory": parse_memory_stats(stderr),
+    }
+
+
+def growth_exponent(small, large, small_size, large_size):
+    if small <= 0 or large <= 0:
+        return None
+    return math.log(large / small) / math.log(large_size / small_size)
+
+
+def print_results(results):
+    header = f"{'functions':>10} {'lines':>8} {'total s':>8}"
+    for phase in PHASES:
+        header += f" {phase + ' s':>10}"
+    header += f" {'arena MiB':>10} {'rss MiB':>8} {'us/def':>7}"
+    print(header)
+    for result in results:
+        row = f"{result['size']:>10} {result['lines']:>8} {result['wall']:>8.3f}"
+        for phase in PHASES:
+            row += f" {result['phases'][phase]['wall']:>10.4f}"
+        memory = result["memory"].get("write", {})
+        arena = memory.get("static_kib_used", 0) + memory.get("dynamic_kib_peak", 0)
+        row += f" {arena / 1024:>10.1f} {result['peak_rss_kib'] / 1024:>8.1f}"
+        row += f" {result['wall'] / result['size'] * 1e6:>7.1f}"
+        print(row)
+
+
+def print_scaling(results):
+    """flags any phase whose time grows faster than the program does"""
+    print("\ngrowth exponent between sizes (1.0 is linear):")
+    flagged = []
+    for small, large in zip(results, results[1:]):
+        row = f"  {small['size']:>7} -> {large['size']:<7}"
+        for phase in PHASES + ("total",):
+            if phase == "total":
+                small_time, large_time = small["wall"], large["wall"]
+            else:
+                small_time = small["phases"][phase]["wall"]
+                large_time = large["phases"][phase]["wall"]
+            exponent = growth_exponent(
+                small_time, large_time, small["size"], large["size"]
+            )
+            row += f" {phase} {'-' if exponent is None else f'{exponent:.2f}':>5}"
+            if (
+                exponent is not None
+                and exponent > SUPERLINEAR_EXPONENT
+                and large_time > MIN_FLAGGED_SECONDS
+            ):
+                flagged.append((phase, small["size"], large["size"], exponent))
+        print(row)
+    for phase, small_size, large_size, exponent in flagged:
+        print(
+            f"warning: {phase} grew with exponent {exponent:.2f} "
+            f"from {small_size} to {large_size} functions"
+        )
+    return flagged
+
+
+def git_commit():
+    try:
+        commit = subprocess.run(
+            ["git", "rev-parse", "--short", "HEAD"],
+            cwd=PROJECT_ROOT,
+            capture_output=True,
+            text=True,
+            check=True,
+        ).stdout.strip()
+        dirty = subprocess.run(
+            ["git", "diff", "--quiet", "HEAD", "--", "src"], cwd=PROJECT_ROOT
+        ).returncode
+    except (OSError, subprocess.CalledProcessError):
+        return "unknown"
+    return commit + ("-dirty" if dirty else "")
+
+
+def load_history():
+    if not HISTORY_FILE.exists():
+        return []
+    return [json.loads(line) for line in HISTORY_FILE.read_text().splitlines() if line]
+
+
+def compare_with_history(history, commit, results):
+    previous = next(
+        (run for run in reversed(history) if run["commit"] != commit), None
+    )
+    if previous is None:
+        return
+    previous_sizes = {result["size"]: result for result in previous["results"]}
+    print(f"\ncompared with {previous['commit']} ({previous['date']}):")
+    for result in results:
+        before = previous_sizes.get(result["size"])
+        if before is None:
+            continue
+        change = (result["wall"] - before["wall"]) / before["wall"] * 100
+        rss_change = (
+            (result["peak_rss_kib"] - before["peak_rss_kib"])
+            / before["peak_rss_kib"]
+            * 100
+        )
+        print(
+            f"  {result['size']:>7} functions: {before['wall']:.3f}s -> "
+            f"{result['wall']:.3f}s ({change:+.1f}%), rss {rss_change:+.1f}%"
+        )
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument(
+        "--sizes",
+        type=lambda arg: [int(size) for size in arg.split(",")],
+        default=list(DEFAULT_SIZES),
+        help="comma separated numbers of top level definitions to generate",
+    )
+    parser.add_argument(
+        "--depth", type=int, default=24, help="how deeply each expression is nested"
+    )
+    parser.add_argument("--jobs", type=int, default=1, help="passed to npc as -j")
+    parser.add_argument("--npc", default=str(PROJECT_ROOT / "npc"))
+    parser.add_argument(
+        "--generate-only",
+        action="store_true",
+        help="write the programs to the work directory without running npc",
+    )
+    parser.add_argument(
+        "--no-history", action="store_true", help="don't record this run"
+    )
+    args = parser.parse_args()
+
+    WORK_DIR.mkdir(parents=True, exist_ok=True)
+    results = []
+    for size in sorted(args.sizes):
+        program = WORK_DIR / f"bench_{size}.np"
+        source = generate_program(size, args.depth)
+        program.write_text(source)
+        if args.generate_only:
+            print(program)
+            continue
+        result = run_npc(args.npc, program, args.jobs)
+        result["size"] = size
+        result["lines"] = source.count("\n")
+        results.append(result)
+        print(f"{size} functions: {result['wall']:.3f}s", file=sys.stderr)
+    if args.generate_only:
+        return
+
+    print()
+    print_results(results)
+    print_scaling(results)
+
+    commit = git_commit()
+    history = load_history()
+    compare_with_history(history, commit, results)
+    if not args.no_history:
+        HISTORY_FILE.parent.mkdir(parents=True, exist_ok=True)
+        with HISTORY_FILE.open("a") as f:
+            run = {
+                "commit": commit,
+                "date": time.strftime("%Y-%m-%d %H:%M:%S"),
+                "depth": args.depth,
+                "jobs": args.jobs,
+                "results": results,
+            }
+            f.write(json.dumps(run) + "\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -79,7 +79,8 @@ class CFunc:
     @property
     def definition_lines(self):
         return [
-            self.declaration_line[:-1],
+            self.type,
+            f"{self.name}({', '.join(self.sig)})",
             "{",
             *[f"    {line}" for line in self.body],
             "}",
@@ -147,58 +148,104 @@ KEYWORDS = (
 )
 
 
-def kw_hash(kw, redundancy):
-    value = ord(kw[0]) * 3
-    for c in kw:
-        value += ord(c)
-    return value % (len(KEYWORDS) + redundancy)
-
-
-def find_good_keyword_hash_redundancy_value():
-    redundancy = 0
-    while redundancy < 500:
-        seen = set()
-        try:
-            for kw in KEYWORDS:
-                value = kw_hash(kw, redundancy)
-                assert value not in seen
-                # 0 is reserved return value to indicate NOT a keyword
-                assert value != 0
-                seen.add(value)
-        except AssertionError:
-            redundancy += 1
-        else:
-            return redundancy
-    raise AssertionError("no good redundancy value found")
+KEYWORD_LENGTH_MAX = max(len(kw) for kw in KEYWORDS)
+
+
+def perfect_hash(key, seed):
+    """
+    32 bit FNV-1a with the offset basis mixed with `seed`, mirrored by the C version, the
+    high bits are folded in as the low bits of FNV only depend on the low bits of the key
+    """
+    value = 2166136261 ^ seed
+    for c in key.encode():
+        value = ((value ^ c) * 16777619) & 0xFFFFFFFF
+    return value ^ (value >> 16)
+
+
+class PerfectHash:
+    """
+    a minimal perfect hash built by hash and displace, the keys are spread over buckets
+    by an unseeded hash and each bucket is given the first seed that moves all of its
+    keys into free slots
+
+    the slot of a key is its value minus one since 0 is kept for NOT_A_... values
+    """
+
+    def __init__(self, keys):
+        self.keys = tuple(keys)
+        self.buckets_count = max(1, len(self.keys) // 2)
+        self.seeds = [0] * self.buckets_count
+        self.slots = [None] * len(self.keys)
+
+        buckets = [[] for _ in range(self.buckets_count)]
+        for key in self.keys:
+            buckets[perfect_hash(key, 0) % self.buckets_count].append(key)
+        # the biggest buckets are the hardest to place so they go first
+        for i in sorted(range(self.buckets_count), key=lambda i: -len(buckets[i])):
+            if buckets[i]:
+                self.seeds[i] = self._place(buckets[i])
+
+    def _place(self, bucket):
+        for seed in range(1, 1 << 16):
+            slots = [perfect_hash(key, seed) % len(self.keys) for key in bucket]
+            if len(set(slots)) != len(slots):
+                continue
+            if any(self.slots[slot] is not None for slot in slots):
+                continue
+            for key, slot in zip(bucket, slots):
+                self.slots[slot] = key
+            return seed
+        raise AssertionError("no perfect hash seed found")
+
+    def value(self, key):
+        seed = self.seeds[perfect_hash(key, 0) % self.buckets_count]
+        slot = perfect_hash(key, seed) % len(self.keys)
+        assert self.slots[slot] == key
+        return slot + 1
+
+    def seeds_array(self, name):
+        return CArray("static const uint32_t", name, self.buckets_count, *self.seeds)
+
+    def lookup_body(self, seeds_name, table_name, result_type, missing):
+        bucket = f"perfect_hash(str, length, 0) % {self.buckets_count}"
+        slot = f"perfect_hash(str, length, seed) % {len(self.keys)}"
+        return [
+            f"uint32_t seed = {seeds_name}[{bucket}];",
+            f"{result_type} value = {slot} + 1;",
+            f"const char* candidate = {table_name}[value];",
+            r"if (strncmp(str, candidate, length) == 0 && candidate[length] == '\0')",
+            "    return value;",
+            f"return {missing};",
+        ]
 
 
-kw_hash_function = CFunc(
-    name="kw_hash",
-    type="size_t",
-    sig=["char* kw"],
+KW_HASH = PerfectHash(KEYWORDS)
+
+perfect_hash_function = CFunc(
+    name="perfect_hash",
+    type="static uint32_t",
+    sig=["const char* str", "size_t length", "uint32_t seed"],
     body=[
-        "size_t hash = kw[0] * 3;",
-        r"for (size_t i = 0; kw[i] != '\0'; i++) hash += kw[i];",
-        "return hash % KEYWORDS_MAX;",
+        "uint32_t hash = 2166136261u ^ seed;",
+        "for (size_t i = 0; i < length; i++)",
+        "    hash = (hash ^ (unsigned char)str[i]) * 16777619u;",
+        "return hash ^ (hash >> 16);",
     ],
 )
+kw_seeds_array = KW_HASH.seeds_array("KW_SEEDS")
 is_kw_function = CFunc(
     name="is_keyword",
     type="Keyword",
-    sig=["char* word"],
+    sig=["const char* str", "size_t length"],
     body=[
-        "if (!word) return NOT_A_KEYWORD;",
-        "size_t hash = kw_hash(word);",
-        "const char* kw = kw_hashtable[hash];",
-        "if (!kw) return NOT_A_KEYWORD;",
-        "if (strcmp(word, kw_hashtable[hash]) == 0) return hash;",
-        "return NOT_A_KEYWORD;",
+        "if (length == 0 || length > KEYWORD_LENGTH_MAX) return NOT_A_KEYWORD;",
+        *KW_HASH.lookup_body("KW_SEEDS", "kw_hashtable", "Keyword", "NOT_A_KEYWORD"),
     ],
 )
 kw_hashtable_array = CArray(
-    name="kw_hashtable",
-    type="static const char*",
-    length="KEYWORDS_MAX",
+    "static const char*",
+    "kw_hashtable",
+    "KEYWORDS_MAX",
     **{f"KW_{kw.upper()}": f'"{kw}"' for kw in KEYWORDS},
 )
 kw_to_cstr_function = CFunc(
@@ -257,28 +304,7 @@ OPS = {
 }
 
 
-def op_hash(op, redundancy):
-    value = ord(op[0])
-    for c in op:
-        value += ord(c)
-    return value % (len(OPS) + redundancy)
-
-
-def find_good_op_hash_redundancy_value():
-    redundancy = 0
-    while redundancy < 500:
-        seen = set()
-        try:
-            for dict_ in OPS.values():
-                value = op_hash(dict_["value"], redundancy)
-                assert value not in seen
-                seen.add(value)
-        except AssertionError:
-            redundancy += 1
-        else:
-            return redundancy
-    raise AssertionError("no good redundancy value found")
-
+OP_HASH = PerfectHash(d["value"] for d in OPS.values())
 
 precedence_table_array = CArray(
     name="PRECEDENCE_TABLE",
@@ -312,14 +338,16 @@ is_assignement_op_array = CArray(
         "OPERATOR_LSHIFT_ASSIGNMENT": "true",
     },
 )
+op_seeds_array = OP_HASH.seeds_array("OP_SEEDS")
 op_from_cstr_function = CFunc(
     name="op_from_cstr",
     type="Operator",
-    sig=["char* op"],
+    sig=["const char* str", "size_t length"],
     body=[
-        "size_t hash = op[0];",
-        r"for (size_t i = 0; op[i] != '\0'; i++) hash += op[i];",
-        "return (Operator)hash % OPERATORS_MAX;",
+        "if (length == 0) return NOT_AN_OPERATOR;",
+        *OP_HASH.lookup_body(
+            "OP_SEEDS", "OP_TO_CSTR_TABLE", "Operator", "NOT_AN_OPERATOR"
+        ),
     ],
 )
 op_to_cstr_function = CFunc(
@@ -330,12 +358,87 @@ op_to_cstr_function = CFunc(
 )
 
 
-def main(outdir, module):
-    kw_redundancy = find_good_keyword_hash_redundancy_value()
-    kw_max = len(KEYWORDS) + kw_redundancy
+# the operators written with symbols rather than being keywords or only used internally
+SCANNED_OPS = {
+    op: d["value"]
+    for op, d in OPS.items()
+    if not any(c.isalnum() or c == "_" for c in d["value"])
+}
+
+# the class of every character the scanner can start a token with, anything not listed
+# is CHAR_INVALID
+CHAR_CLASSES = {
+    "CHAR_BLANK": " \t",
+    "CHAR_NEWLINE": "\n",
+    "CHAR_COMMENT": "#",
+    "CHAR_ALPHA": "_ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz",
+    "CHAR_DIGIT": "0123456789",
+    "CHAR_DOT": ".",
+    "CHAR_QUOTE": "'\"",
+    "CHAR_PUNCTUATION": "@,:()[]{}",
+    "CHAR_OPERATOR": "".join(sorted(set("".join(SCANNED_OPS.values())))),
+}
+
 
-    op_redundancy = find_good_op_hash_redundancy_value()
-    op_max = len(OPS) + op_redundancy
+def c_char(c):
+    escapes = {"\t": "\\t", "\n": "\\n", "'": "\\'", "\\": "\\\\"}
+    return f"'{escapes.get(c, c)}'"
+
+
+char_class_array = CArray(
+    "const unsigned char",
+    "CHAR_CLASS_TABLE",
+    256,
+    **{c_char(c): cls for cls, chars in CHAR_CLASSES.items() for c in chars},
+)
+
+
+class OperatorDFA:
+    """
+    the scanner walks this from state 0 taking the longest operator it can, state 0 is
+    never re-entered so a transition to 0 means the operator has ended
+    """
+
+    def __init__(self, operators):
+        # column 0 is for every character that can't continue an operator
+        self.chars = CHAR_CLASSES["CHAR_OPERATOR"]
+        self.transitions = [[0] * (len(self.chars) + 1)]
+        self.accepts = ["NOT_AN_OPERATOR"]
+        for name, value in operators.items():
+            state = 0
+            for c in value:
+                column = self.chars.index(c) + 1
+                if not self.transitions[state][column]:
+                    self.transitions[state][column] = len(self.transitions)
+                    self.transitions.append([0] * (len(self.chars) + 1))
+                    self.accepts.append("NOT_AN_OPERATOR")
+                state = self.transitions[state][column]
+            self.accepts[state] = name
+
+
+OP_DFA = OperatorDFA(SCANNED_OPS)
+
+operator_char_index_array = CArray(
+    "const unsigned char",
+    "OPERATOR_CHAR_INDEX",
+    256,
+    **{c_char(c): i + 1 for i, c in enumerate(OP_DFA.chars)},
+)
+operator_transitions_array = CArray(
+    "const unsigned char",
+    "OPERATOR_DFA",
+    "OPERATOR_STATES][OPERATOR_COLUMNS",
+    *[f"{{{', '.join(str(s) for s in row)}}}" for row in OP_DFA.transitions],
+)
+operator_accepts_array = CArray(
+    "const Operator",
+    "OPERATOR_ACCEPTS",
+    "OPERATOR_STATES",
+    *OP_DFA.accepts,
+)
+
+
+def main(outdir, module):
     max_precedence = max(d["precedence"] for d in OPS.values())
 
     header = CSource(module, header=True)
@@ -345,40 +448,57 @@ def main(outdir, module):
     header.append_sep("#include <stddef.h>")
     header.append_enum(
         "Keyword",
-        **{"NOT_A_KEYWORD": 0, **{f"kw_{kw}": kw_hash(kw, kw_redundancy) for kw in KEYWORDS}},
+        **{"NOT_A_KEYWORD": 0, **{f"kw_{kw}": KW_HASH.value(kw) for kw in KEYWORDS}},
     )
-    header.append(f"#define KEYWORDS_MAX {kw_max}")
-    header.append(kw_hash_function.declaration_line)
+    header.append(f"#define KEYWORDS_MAX {len(KEYWORDS) + 1}")
+    header.append(f"#define KEYWORD_LENGTH_MAX {KEYWORD_LENGTH_MAX}")
     header.append(is_kw_function.declaration_line)
     header.append_sep(kw_to_cstr_function.declaration_line)
     header.append_enum(
-        "Operator", **{op: op_hash(d["value"], op_redundancy) for op, d in OPS.items()}
+        "Operator",
+        **{
+            "NOT_AN_OPERATOR": 0,
+            **{op: OP_HASH.value(d["value"]) for op, d in OPS.items()},
+        },
     )
-    header.append(f"#define OPERATORS_MAX {op_max}")
+    header.append(f"#define OPERATORS_MAX {len(OPS) + 1}")
     header.append(f"#define MAX_PRECEDENCE {max_precedence}")
     header.append(precedence_table_array.extern_declaration_line)
     header.append(is_assignement_op_array.extern_declaration_line)
     header.append(op_from_cstr_function.declaration_line)
-    header.append(op_to_cstr_function.declaration_line)
+    header.append_sep(op_to_cstr_function.declaration_line)
+    header.append_enum("CharClass", "CHAR_INVALID", *CHAR_CLASSES)
+    header.append_sep(char_class_array.extern_declaration_line)
+    header.append(f"#define OPERATOR_COLUMNS {len(OP_DFA.chars) + 1}")
+    header.append(f"#define OPERATOR_STATES {len(OP_DFA.transitions)}")
+    header.append(operator_char_index_array.extern_declaration_line)
+    header.append(operator_transitions_array.extern_declaration_line)
+    header.append(operator_accepts_array.extern_declaration_line)
 
     source.append_sep(f'#include "{header.filename}"')
+    source.append("#include <stdint.h>")
     source.append_sep("#include <string.h>")
+    source.extend_sep(perfect_hash_function.definition_lines)
     source.extend_sep(kw_hashtable_array.definition_lines)
-    source.extend_sep(kw_hash_function.definition_lines)
+    source.extend_sep(kw_seeds_array.definition_lines)
     source.extend_sep(is_kw_function.definition_lines)
     source.extend_sep(kw_to_cstr_function.definition_lines)
     source.extend_sep(precedence_table_array.definition_lines)
     source.extend_sep(is_assignement_op_array.definition_lines)
     source.extend_sep(op_to_cstr_array.definition_lines)
+    source.extend_sep(op_seeds_array.definition_lines)
     source.extend_sep(op_from_cstr_function.definition_lines)
     source.extend_sep(op_to_cstr_function.definition_lines)
+    source.extend_sep(char_class_array.definition_lines)
+    source.extend_sep(operator_char_index_array.definition_lines)
+    source.extend_sep(operator_transitions_array.definition_lines)
+    source.extend(operator_accepts_array.definition_lines)
 
     with open(outdir / header.filename, "w") as f:
         f.write(str(header))
     with open(outdir / source.filename, "w") as f:
         f.write(str(source))
 
-
 if __name__ == "__main__":
     parser = argparse.ArgumentParser()
     parser.add_argument(
@@ -330,13 +330,40 @@ class CompilerIterdirGroup:
         return None
 
 
+class SharedCacheIterdirGroup(CompilerIterdirGroup):
+    """builds every file in the directory one after another from the same working
+    directory so later builds can be served from the build cache of earlier ones"""
+
+    def __init__(self, directory, cli_flags, args, opts):
+        super().__init__(directory, cli_flags, args, opts._replace(sync=True))
+
+    def begin(self):
+        cwd = TMP / str(next(counter))
+        cwd.mkdir(parents=True)
+        for fp in sorted(self.directory.iterdir()):
+            self.runner.run(
+                cwd=cwd,
+                test_key=f"{self.cli_flags.strip('-')} {fp.relative_to(PROJECT_ROOT)}",
+                command=f"{self.npc} -o testmain {self.cli_flags} {str(fp.absolute())}",
+            )
+
+
 def init_test_groups(args, opts):
     tests = []
     outer_dirs = (PROJECT_ROOT / "test/features", PROJECT_ROOT / "test/errors")
     for d in outer_dirs:
         for test_dir in d.iterdir():
+            if test_dir.name == "build_cache":
+                # the allocation sites name the file the binary was built from
+                tests.append(SharedCacheIterdirGroup(
+                    test_dir, "--trace-allocs --run", args, opts))
+                continue
             tests.append(CompilerIterdirGroup(
                 test_dir, "--run", args, opts))
+            # npc's optimizer passes only run from -O1 up
+            if d.name == "features":
+                tests.append(CompilerIterdirGroup(
+                    test_dir, "-O1 --run", args, opts))
     """
     if args.programs:
         tests.append(CompilerIterdirGroup(
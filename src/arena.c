@@ -18,66 +18,239 @@ out_of_static_memory()
 static inline void
 out_of_dynamic_memory()
 {
-    fprintf(stderr, "ERROR: arena out of dynamic memory chunks");
+    fprintf(stderr, "ERROR: arena out of dynamic memory");
     exit(1);
 }
 
+// every dynamic allocation is preceded by its header, which keeps the data 16 byte
+// aligned
+typedef struct {
+    size_t size;
+    // the region a run of chunks was taken from, or SIZE_CLASS_BLOCK
+    uint32_t region;
+    // how many chunks a run spans or the size class of a block
+    uint32_t extent;
+} DynamicHeader;
+
+#define SIZE_CLASS_BLOCK UINT32_MAX
+#define SIZE_CLASS_MIN_BLOCK 32
+// how many chunks are split into blocks when a size class runs out
+#define SIZE_CLASS_SLAB_CHUNKS 4
+
+static_assert(sizeof(DynamicHeader) == 16, "dynamic allocations should stay aligned");
+static_assert(
+    (SIZE_CLASS_MIN_BLOCK << (ARENA_SIZE_CLASSES - 1)) <= ARENA_DYNAMIC_CHUNK_SIZE,
+    "the largest size class should fit within a chunk"
+);
+
+#define BLOCK_SIZE(size_class) ((size_t)SIZE_CLASS_MIN_BLOCK << (size_class))
+#define REQUIRED_DYNAMIC_CHUNKS(size)                                                    \
+    ((sizeof(DynamicHeader) + (size) + ARENA_DYNAMIC_CHUNK_SIZE - 1) /                   \
+     ARENA_DYNAMIC_CHUNK_SIZE)
+#define CHUNK_NOT_FOUND SIZE_MAX
+
+static inline DynamicHeader*
+dynamic_header(void* allocation)
+{
+    return (DynamicHeader*)((uint8_t*)allocation - sizeof(DynamicHeader));
+}
+
+// the smallest size class with room for `size`, ARENA_SIZE_CLASSES if there's none
+static inline uint32_t
+size_class(size_t size)
+{
+    uint32_t class = 0;
+    while (class < ARENA_SIZE_CLASSES && BLOCK_SIZE(class) < sizeof(DynamicHeader) + size)
+        class++;
+    return class;
+}
+
+static void
+set_chunks(
+    Arena* arena, ArenaDynamicRegion* region, size_t start, size_t count, bool in_use
+)
+{
+    if (in_use) {
+        region->free_chunks -= count;
+        arena->dynamic_chunks_in_use += count;
+        if (arena->dynamic_chunks_in_use > arena->dynamic_chunks_peak)
+            arena->dynamic_chunks_peak = arena->dynamic_chunks_in_use;
+    }
+    else {
+        region->free_chunks += count;
+        arena->dynamic_chunks_in_use -= count;
+    }
+    while (count > 0) {
+        size_t bit = start % 64;
+        size_t width = (64 - bit < count) ? 64 - bit : count;
+        uint64_t mask = ((width == 64) ? UINT64_MAX : ((uint64_t)1 << width) - 1) << bit;
+        if (in_use)
+            region->in_use[start / 64] |= mask;
+        else
+            region->in_use[start / 64] &= ~mask;
+        start += width;
+        count -= width;
+    }
+}
+
+static bool
+chunks_free(ArenaDynamicRegion* region, size_t start, size_t count)
+{
+    if (start + count > region->chunks_count) return false;
+    while (count > 0) {
+        size_t bit = start % 64;
+        size_t width = (64 - bit < count) ? 64 - bit : count;
+        uint64_t mask = ((width == 64) ? UINT64_MAX : ((uint64_t)1 << width) - 1) << bit;
+        if (region->in_use[start / 64] & mask) return false;
+        start += width;
+        count -= width;
+    }
+    return true;
+}
+
+// first fit, the free chunks up to the next chunk in use are counted a word at a time
 static size_t
-find_dynamic_chunk(Arena* arena, size_t required_chunks)
+find_free_run(ArenaDynamicRegion* region, size_t count)
 {
-    bool zero[required_chunks];
-    memset(zero, 0, sizeof(zero));
-
-    for (size_t off = 0, stride = 8; off < stride; off++) {
-        size_t chunk = off;
-        while (chunk < ARENA_DYNAMIC_CHUNK_COUNT) {
-            if (memcmp(zero, arena->dynamic_chunks_in_use + chunk, sizeof(zero)) == 0)
-                return chunk;
-            chunk += stride;
-        }
+    if (region->free_chunks < count) return CHUNK_NOT_FOUND;
+
+    size_t chunk = 0;
+    size_t run = 0;
+    while (chunk < region->chunks_count) {
+        size_t bit = chunk % 64;
+        uint64_t used = region->in_use[chunk / 64] >> bit;
+        size_t free = (used) ? (size_t)__builtin_ctzll(used) : 64 - bit;
+        run += free;
+        chunk += free;
+        if (run >= count) return chunk - run;
+        if (!used) continue;
+        // no bit is clear when the rest of the word is in use
+        uint64_t set = ~(used >> free);
+        chunk += (set) ? (size_t)__builtin_ctzll(set) : 64 - bit - free;
+        run = 0;
     }
+    return CHUNK_NOT_FOUND;
+}
 
-    error("unable to find an available dynamic memory chunk");
-    UNREACHABLE();
+static size_t
+find_largest_free_run(ArenaDynamicRegion* region)
+{
+    size_t largest = 0;
+    size_t run = 0;
+    for (size_t chunk = 0; chunk < region->chunks_count; chunk++) {
+        bool in_use = region->in_use[chunk / 64] & ((uint64_t)1 << (chunk % 64));
+        run = (in_use) ? 0 : run + 1;
+        if (run > largest) largest = run;
+    }
+    return largest;
 }
 
-static void
-assert_is_dynamic_allocation(Arena* arena, void* allocation)
+static ArenaDynamicRegion*
+add_dynamic_region(Arena* arena, size_t min_chunks)
 {
-    assert((uint8_t*)allocation >= (uint8_t*)arena->dynamic_region);
-    assert(
-        (uint8_t*)allocation <=
-        (uint8_t*)arena->dynamic_region[ARENA_DYNAMIC_CHUNK_COUNT - 1]
+    size_t count = arena->dynamic_regions_count;
+    size_t chunks = ARENA_DYNAMIC_REGION_CHUNKS;
+    if (count > 0) chunks = arena->dynamic_regions[count - 1].chunks_count * 2;
+    while (chunks < min_chunks) chunks *= 2;
+
+    arena->dynamic_regions = realloc(
+        arena->dynamic_regions,
+        sizeof(ArenaDynamicRegion) * (arena->dynamic_regions_count + 1)
     );
+    if (!arena->dynamic_regions) out_of_dynamic_memory();
+    ArenaDynamicRegion* region = arena->dynamic_regions + arena->dynamic_regions_count++;
+    region->chunks_count = chunks;
+    region->free_chunks = chunks;
+    region->memory = malloc(chunks * ARENA_DYNAMIC_CHUNK_SIZE);
+    region->in_use = calloc(chunks / 64, sizeof(uint64_t));
+    if (!region->memory || !region->in_use) out_of_dynamic_memory();
+    return region;
 }
 
-static size_t
-dynamic_allocation_to_chunk(Arena* arena, void* dynamic_allocation)
+// returns the header at the start of a run of `count` chunks now marked in use
+static DynamicHeader*
+take_chunks(Arena* arena, size_t count)
 {
-    // assert `dynamic_alloction` is indeed located in the dynamic allocation region
-    uint8_t* head = (uint8_t*)dynamic_allocation - sizeof(size_t);
-    size_t offset = head - (uint8_t*)arena->dynamic_region;
-    assert(offset % ARENA_DYNAMIC_CHUNK_SIZE == 0);
-    return offset / ARENA_DYNAMIC_CHUNK_SIZE;
+    ArenaDynamicRegion* region = NULL;
+    size_t chunk = CHUNK_NOT_FOUND;
+    for (size_t i = 0; i < arena->dynamic_regions_count; i++) {
+        region = arena->dynamic_regions + i;
+        chunk = find_free_run(region, count);
+        if (chunk != CHUNK_NOT_FOUND) break;
+    }
+    if (chunk == CHUNK_NOT_FOUND) {
+        region = add_dynamic_region(arena, count);
+        chunk = 0;
+    }
+    set_chunks(arena, region, chunk, count, true);
+
+    DynamicHeader* header =
+        (DynamicHeader*)(region->memory + chunk * ARENA_DYNAMIC_CHUNK_SIZE);
+    header->region = (uint32_t)(region - arena->dynamic_regions);
+    header->extent = (uint32_t)count;
+    return header;
 }
 
-#define REQUIRED_DYNAMIC_CHUNKS(size)                                                    \
-    (1 + ((sizeof(size_t) + size) / ARENA_DYNAMIC_CHUNK_SIZE))
+static inline size_t
+run_first_chunk(Arena* arena, DynamicHeader* header)
+{
+    ArenaDynamicRegion* region = arena->dynamic_regions + header->region;
+    return ((uint8_t*)header - region->memory) / ARENA_DYNAMIC_CHUNK_SIZE;
+}
+
+static DynamicHeader*
+take_block(Arena* arena, uint32_t class)
+{
+    if (!arena->free_blocks[class]) {
+        // the slab is never returned to its region, its blocks are reused by the class
+        DynamicHeader* slab = take_chunks(arena, SIZE_CLASS_SLAB_CHUNKS);
+        size_t block_size = BLOCK_SIZE(class);
+        size_t blocks = SIZE_CLASS_SLAB_CHUNKS * ARENA_DYNAMIC_CHUNK_SIZE / block_size;
+        for (size_t i = blocks; i > 0; i--) {
+            void** block = (void**)((uint8_t*)slab + (i - 1) * block_size);
+            *block = arena->free_blocks[class];
+            arena->free_blocks[class] = block;
+        }
+    }
+    DynamicHeader* header = arena->free_blocks[class];
+    arena->free_blocks[class] = *(void**)header;
+    header->region = SIZE_CLASS_BLOCK;
+    header->extent = class;
+    return header;
+}
+
+static inline void
+resize_dynamic_bytes(Arena* arena, size_t prev_size, size_t size)
+{
+    arena->dynamic_bytes_in_use = arena->dynamic_bytes_in_use - prev_size + size;
+    if (arena->dynamic_bytes_in_use > arena->dynamic_bytes_peak)
+        arena->dynamic_bytes_peak = arena->dynamic_bytes_in_use;
+}
+
+static void
+assert_is_dynamic_allocation(Arena* arena, void* allocation)
+{
+    DynamicHeader* header = dynamic_header(allocation);
+    (void)header;
+    (void)arena;
+    assert(
+        (header->region == SIZE_CLASS_BLOCK && header->extent < ARENA_SIZE_CLASSES) ||
+        header->region < arena->dynamic_regions_count
+    );
+}
 
 void*
 arena_dynamic_alloc(Arena* arena, size_t size)
 {
     assert(size > 0);
 
-    size_t required_chunks = REQUIRED_DYNAMIC_CHUNKS(size);
-    assert(required_chunks < ARENA_DYNAMIC_CHUNK_COUNT);
-
-    size_t chunk = find_dynamic_chunk(arena, required_chunks);
-
-    memset(arena->dynamic_chunks_in_use + chunk, 1, sizeof(bool) * required_chunks);
-    uint8_t* head = arena->dynamic_region[chunk];
-    *((size_t*)head) = size;
-    void* allocation = (void*)(head + sizeof(size_t));
+    uint32_t class = size_class(size);
+    DynamicHeader* header = (class < ARENA_SIZE_CLASSES)
+                                ? take_block(arena, class)
+                                : take_chunks(arena, REQUIRED_DYNAMIC_CHUNKS(size));
+    header->size = size;
+    resize_dynamic_bytes(arena, 0, size);
+    void* allocation = header + 1;
     memset(allocation, 0, size);
     return allocation;
 }
@@ -86,89 +259,63 @@ void*
 arena_dynamic_realloc(Arena* arena, void* allocation, size_t size)
 {
     assert_is_dynamic_allocation(arena, allocation);
-
-    size_t required_chunks = REQUIRED_DYNAMIC_CHUNKS(size);
-    assert(required_chunks < ARENA_DYNAMIC_CHUNK_COUNT);
-
-    size_t* size_tag = (size_t*)((uint8_t*)allocation - sizeof(size_t));
-    size_t prev_required_chunks = REQUIRED_DYNAMIC_CHUNKS(*size_tag);
-
-    // if we don't have a change in number of required chunks just update size
-    // and return the same alllocation
-    if (prev_required_chunks == required_chunks) {
-        *size_tag = size;
-        return allocation;
-    }
-
-    size_t prev_chunk = dynamic_allocation_to_chunk(arena, allocation);
-
-    // if more chunks are now required first check if the allocation will need to move
-    if (prev_required_chunks < required_chunks) {
-        bool zero[required_chunks - prev_required_chunks];
-        memset(zero, 0, sizeof(zero));
-        if (memcmp(
-                zero,
-                arena->dynamic_chunks_in_use + prev_chunk + prev_required_chunks,
-                sizeof(zero)
-            ) == 0) {
-            // forward space is free, no move required:
-            //      mark chunks in use
-            //      zero init new region
-            //      update size tag
-            //      return the same allocation
-            memset(
-                arena->dynamic_chunks_in_use + prev_chunk,
-                1,
-                sizeof(bool) * required_chunks
-            );
-            memset((uint8_t*)allocation + *size_tag, 0, size - *size_tag);
-            *size_tag = size;
-            return allocation;
-        }
-        else {
-            // forward space is not free, move required:
-            //      find a new allocation
-            //      copy old data into new buffer and zero initialize the end
-            //      mark old chunks not in use
-            //      return new allocation
-            size_t new_chunk = find_dynamic_chunk(arena, required_chunks);
-            memset(
-                arena->dynamic_chunks_in_use + new_chunk,
-                1,
-                sizeof(bool) * required_chunks
+    DynamicHeader* header = dynamic_header(allocation);
+    size_t prev_size = header->size;
+
+    // the allocation can stay where it is when it already has room for `size` or the
+    // chunks following its run are free
+    bool fits;
+    if (header->region == SIZE_CLASS_BLOCK)
+        fits = sizeof(DynamicHeader) + size <= BLOCK_SIZE(header->extent);
+    else {
+        ArenaDynamicRegion* region = arena->dynamic_regions + header->region;
+        size_t first = run_first_chunk(arena, header);
+        size_t required_chunks = REQUIRED_DYNAMIC_CHUNKS(size);
+        fits = required_chunks <= header->extent;
+        if (fits)
+            set_chunks(
+                arena,
+                region,
+                first + required_chunks,
+                header->extent - required_chunks,
+                false
             );
-            uint8_t* head = arena->dynamic_region[new_chunk];
-            *((size_t*)head) = size;
-            void* new = (void*)(head + sizeof(size_t));
-            memcpy(new, allocation, *size_tag);
-            memset((uint8_t*)new + *size_tag, 0, size - *size_tag);
-            memset(
-                arena->dynamic_chunks_in_use + prev_chunk,
-                0,
-                sizeof(bool) * prev_required_chunks
+        else if (chunks_free(
+                     region,
+                     first + header->extent,
+                     required_chunks - header->extent
+                 )) {
+            set_chunks(
+                arena,
+                region,
+                first + header->extent,
+                required_chunks - header->extent,
+                true
             );
-            return new;
+            fits = true;
         }
+        if (fits) header->extent = (uint32_t)required_chunks;
     }
-    // if shrinking update the size and chunks in use then return the same allocation
-    else {
-        *size_tag = size;
-        memset(
-            arena->dynamic_chunks_in_use + prev_chunk + required_chunks,
-            0,
-            sizeof(bool) * (prev_required_chunks - required_chunks)
-        );
+    if (fits) {
+        if (size > prev_size)
+            memset((uint8_t*)allocation + prev_size, 0, size - prev_size);
+        header->size = size;
+        resize_dynamic_bytes(arena, prev_size, size);
         return allocation;
     }
-    UNREACHABLE();
+
+    void* new = arena_dynamic_alloc(arena, size);
+    memcpy(new, allocation, (prev_size < size) ? prev_size : size);
+    arena_dynamic_free(arena, allocation);
+    return new;
 }
 
 void*
 arena_dynamic_finalize(Arena* arena, void* dynamic_allocation)
 {
     assert_is_dynamic_allocation(arena, dynamic_allocation);
-    uint8_t* head = (uint8_t*)dynamic_allocation - sizeof(size_t);
-    void* new = arena_copy(arena, dynamic_allocation, *(size_t*)head);
+    size_t size = dynamic_header(dynamic_allocation)->size;
+    void* new = arena_copy(arena, dynamic_allocation, size);
     arena_dynamic_free(arena, dynamic_allocation);
     return new;
 }
@@ -177,10 +324,16 @@ void
 arena_dynamic_free(Arena* arena, void* dynamic_allocation)
 {
     assert_is_dynamic_allocation(arena, dynamic_allocation);
-    size_t chunk = dynamic_allocation_to_chunk(arena, dynamic_allocation);
-    size_t* size_tag = (size_t*)((uint8_t*)dynamic_allocation - sizeof(size_t));
-    size_t nchunks = REQUIRED_DYNAMIC_CHUNKS(*size_tag);
-    memset(arena->dynamic_chunks_in_use + chunk, 0, sizeof(bool) * nchunks);
+    DynamicHeader* header = dynamic_header(dynamic_allocation);
+    resize_dynamic_bytes(arena, header->size, 0);
+    if (header->region == SIZE_CLASS_BLOCK) {
+        uint32_t class = header->extent;
+        *(void**)header = arena->free_blocks[class];
+        arena->free_blocks[class] = header;
+        return;
+    }
+    ArenaDynamicRegion* region = arena->dynamic_regions + header->region;
+    set_chunks(arena, region, run_first_chunk(arena, header), header->extent, false);
 }
 
 #define ARENA_STATIC_CHUNK_MIN_SIZE 4096
@@ -254,6 +407,30 @@ arena_init(void)
     return arena;
 }
 
+ArenaStats
+arena_stats(Arena* arena)
+{
+    ArenaStats stats = {
+        .static_chunks = arena->static_chunks_count,
+        .dynamic_regions = arena->dynamic_regions_count,
+        .dynamic_chunks_in_use = arena->dynamic_chunks_in_use,
+        .dynamic_chunks_peak = arena->dynamic_chunks_peak,
+        .dynamic_bytes_in_use = arena->dynamic_bytes_in_use,
+        .dynamic_bytes_peak = arena->dynamic_bytes_peak,
+    };
+    for (size_t i = 0; i < arena->static_chunks_count; i++) {
+        stats.static_bytes_reserved += arena->static_chunks[i].capacity;
+        stats.static_bytes_used += arena->static_chunks[i].head;
+    }
+    for (size_t i = 0; i < arena->dynamic_regions_count; i++) {
+        ArenaDynamicRegion* region = arena->dynamic_regions + i;
+        stats.dynamic_chunks += region->chunks_count;
+        size_t run = find_largest_free_run(region);
+        if (run > stats.dynamic_largest_free_run) stats.dynamic_largest_free_run = run;
+    }
+    return stats;
+}
+
 const char*
 arena_snprintf(Arena* arena, size_t bufsize, const char* fmt, ...)
 {
@@ -272,5 +449,10 @@ arena_free(Arena* arena)
         free(arena->static_chunks[i].buffer);
     }
     free(arena->static_chunks);
+    for (size_t i = 0; i < arena->dynamic_regions_count; i++) {
+        free(arena->dynamic_regions[i].memory);
+        free(arena->dynamic_regions[i].in_use);
+    }
+    free(arena->dynamic_regions);
     free(arena);
 }
@@ -12,17 +12,52 @@ typedef struct {
 } ArenaStaticChunk;
 
 #define ARENA_DYNAMIC_CHUNK_SIZE 1024
-#define ARENA_DYNAMIC_CHUNK_COUNT 1024
+// chunks in the first dynamic region, each region added after is twice as big
+#define ARENA_DYNAMIC_REGION_CHUNKS 1024
+// small dynamic allocations are blocks of 32, 64, 128, 256 or 512 bytes
+#define ARENA_SIZE_CLASSES 5
+
+typedef struct {
+    uint8_t* memory;
+    size_t chunks_count;
+    size_t free_chunks;
+    // one bit per chunk, set while the chunk is in use
+    uint64_t* in_use;
+} ArenaDynamicRegion;
 
 typedef struct {
     size_t static_chunks_count;
     size_t static_chunks_capacity;
     size_t current_static_chunk;
     ArenaStaticChunk* static_chunks;
-    uint8_t dynamic_region[ARENA_DYNAMIC_CHUNK_COUNT][ARENA_DYNAMIC_CHUNK_SIZE];
-    bool dynamic_chunks_in_use[ARENA_DYNAMIC_CHUNK_COUNT];
+    size_t dynamic_regions_count;
+    ArenaDynamicRegion* dynamic_regions;
+    // freed blocks of each size class linked through their first bytes
+    void* free_blocks[ARENA_SIZE_CLASSES];
+    size_t dynamic_chunks_in_use;
+    size_t dynamic_chunks_peak;
+    size_t dynamic_bytes_in_use;
+    size_t dynamic_bytes_peak;
 } Arena;
 
+typedef struct {
+    size_t static_chunks;
+    size_t static_bytes_reserved;
+    // the rest of a chunk is left unused once an allocation doesn't fit in it
+    size_t static_bytes_used;
+    size_t dynamic_regions;
+    size_t dynamic_chunks;
+    // slabs of size class blocks count as in use whether or not their blocks are
+    size_t dynamic_chunks_in_use;
+    size_t dynamic_chunks_peak;
+    // the bytes requested by live allocations, not counting headers
+    size_t dynamic_bytes_in_use;
+    size_t dynamic_bytes_peak;
+    // chunks free in total versus the most that can be taken at once shows how
+    // fragmented the dynamic regions are
+    size_t dynamic_largest_free_run;
+} ArenaStats;
+
 Arena* arena_init(void);
 void arena_free(Arena* arena);
 
@@ -45,6 +80,9 @@ void* arena_alloc(Arena* arena, size_t nbytes);
 // copy into static arena memory
 void* arena_copy(Arena* arena, void* data, size_t nbytes);
 
+// a snapshot of how much memory the arena holds, peaks are since arena_init
+ArenaStats arena_stats(Arena* arena);
+
 const char* arena_snprintf(Arena* arena, size_t bufsize, const char* fmt, ...);
 
 #endif
@@ -0,0 +1,229 @@
+// opendir, utime
+#define _POSIX_C_SOURCE 200809L
+
+#include "build_cache.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+
+#include "diagnostics.h"
+
+// not XXH_INLINE_ALL, gcc's -Warray-bounds misfires on XXH64_update inlined with a
+// constant length and nothing here is hot enough for the inlining to matter
+#define XXH_STATIC_LINKING_ONLY
+#define XXH_IMPLEMENTATION
+#include "../3rdparty/xxhash.h"
+
+#define NPC_VERSION "0.1.0"
+// a rebuilt npc may generate different code for the same source
+#define NPC_EXECUTABLE "/proc/self/exe"
+
+#define CACHE_PATH_CAPACITY 256
+// the entries are named by their key in hex
+#define CACHE_ENTRY_NAME_LENGTH 16
+// the least recently used entries are removed once the cache holds more than this
+#ifndef BUILD_CACHE_MAX_BYTES
+#define BUILD_CACHE_MAX_BYTES (256ull << 20)
+#endif
+#define COPY_BUFFER_SIZE 65536
+
+static void
+hash_cstr(XXH64_state_t* state, const char* cstr)
+{
+    // includes the NULL terminator so neighbouring strings can't run together
+    XXH64_update(state, cstr, strlen(cstr) + 1);
+}
+
+static void
+hash_file(XXH64_state_t* state, const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file) errorf("unable to read (%s) (%s)", path, strerror(errno));
+
+    char buffer[COPY_BUFFER_SIZE];
+    size_t read;
+    uint64_t length = 0;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        XXH64_update(state, buffer, read);
+        length += read;
+    }
+    if (ferror(file)) errorf("failed reading (%s) for hashing", path);
+    fclose(file);
+    // so the contents of neighbouring files can't run together
+    XXH64_update(state, &length, sizeof(length));
+}
+
+BuildCache
+build_cache_init(
+    const char* directory,
+    const char* const* source_paths,
+    const char* const* source_namespaces,
+    size_t source_count,
+    const char* const* runtime_files,
+    size_t runtime_files_count,
+    const char* options
+)
+{
+    XXH64_state_t state;
+    XXH64_reset(&state, 0);
+    hash_cstr(&state, NPC_VERSION);
+    hash_file(&state, NPC_EXECUTABLE);
+    for (size_t i = 0; i < runtime_files_count; i++) hash_file(&state, runtime_files[i]);
+    hash_cstr(&state, options);
+    for (size_t i = 0; i < source_count; i++) {
+        hash_cstr(&state, source_paths[i]);
+        hash_cstr(&state, source_namespaces[i]);
+        hash_file(&state, source_paths[i]);
+    }
+    return (BuildCache){.directory = directory, .key = XXH64_digest(&state)};
+}
+
+static void
+cache_entry_path(BuildCache cache, char* out)
+{
+    int length = snprintf(
+        out,
+        CACHE_PATH_CAPACITY,
+        "%s/%016llx",
+        cache.directory,
+        (unsigned long long)cache.key
+    );
+    if (length >= CACHE_PATH_CAPACITY)
+        errorf("build cache path (%s) is too long", cache.directory);
+}
+
+static bool
+copy_file(const char* from, const char* to)
+{
+    FILE* src = fopen(from, "rb");
+    if (!src) return false;
+    FILE* dest = fopen(to, "wb");
+    if (!dest) errorf("unable to open (%s) for writing (%s)", to, strerror(errno));
+
+    char buffer[COPY_BUFFER_SIZE];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), src)) > 0) {
+        if (fwrite(buffer, 1, read, dest) != read)
+            errorf("failed writing to (%s) (%s)", to, strerror(errno));
+    }
+    if (ferror(src)) errorf("failed reading from (%s)", from);
+    fclose(src);
+    if (fclose(dest) != 0) errorf("failed writing to (%s) (%s)", to, strerror(errno));
+
+    if (chmod(to, 0755) != 0)
+        errorf("unable to make (%s) executable (%s)", to, strerror(errno));
+    return true;
+}
+
+// copies under a temporary name first so nothing ever sees a partially written file
+// and a program that is still running can be replaced
+static bool
+install_file(const char* from, const char* to)
+{
+    char tmp_path[CACHE_PATH_CAPACITY + 32];
+    int length = snprintf(tmp_path, sizeof(tmp_path), "%s.%ld.tmp", to, (long)getpid());
+    if (length >= (int)sizeof(tmp_path)) errorf("path (%s) is too long", to);
+
+    if (!copy_file(from, tmp_path)) return false;
+    if (rename(tmp_path, to) != 0)
+        errorf("unable to move (%s) to (%s) (%s)", tmp_path, to, strerror(errno));
+    return true;
+}
+
+bool
+build_cache_fetch(BuildCache cache, const char* outfile)
+{
+    char path[CACHE_PATH_CAPACITY];
+    cache_entry_path(cache, path);
+    if (!install_file(path, outfile)) return false;
+    // the modification time marks when an entry was last used
+    utime(path, NULL);
+    return true;
+}
+
+typedef struct {
+    char name[CACHE_ENTRY_NAME_LENGTH + 1];
+    time_t used;
+    uint64_t bytes;
+} CacheEntry;
+
+static int
+compare_least_recently_used(const void* a, const void* b)
+{
+    time_t used_a = ((const CacheEntry*)a)->used;
+    time_t used_b = ((const CacheEntry*)b)->used;
+    return (used_a > used_b) - (used_a < used_b);
+}
+
+static void
+entry_path(const char* directory, const char* name, char* out)
+{
+    int length = snprintf(out, CACHE_PATH_CAPACITY, "%s/%s", directory, name);
+    if (length >= CACHE_PATH_CAPACITY)
+        errorf("build cache path (%s) is too long", directory);
+}
+
+static void
+evict_least_recently_used(const char* directory)
+{
+    DIR* dir = opendir(directory);
+    if (!dir) errorf("unable to open (%s) (%s)", directory, strerror(errno));
+
+    CacheEntry* entries = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    uint64_t total_bytes = 0;
+    struct dirent* dirent;
+    while ((dirent = readdir(dir))) {
+        // anything else is still being copied in under a temporary name
+        if (strlen(dirent->d_name) != CACHE_ENTRY_NAME_LENGTH) continue;
+        char path[CACHE_PATH_CAPACITY];
+        entry_path(directory, dirent->d_name, path);
+        struct stat info;
+        // another npc may have evicted it in the meantime
+        if (stat(path, &info) != 0) continue;
+
+        if (count == capacity) {
+            capacity = (capacity) ? capacity * 2 : 64;
+            entries = realloc(entries, sizeof(CacheEntry) * capacity);
+            if (!entries) error("out of memory");
+        }
+        CacheEntry* entry = entries + count++;
+        memcpy(entry->name, dirent->d_name, sizeof(entry->name));
+        entry->used = info.st_mtime;
+        entry->bytes = (uint64_t)info.st_size;
+        total_bytes += entry->bytes;
+    }
+    closedir(dir);
+
+    if (total_bytes > BUILD_CACHE_MAX_BYTES) {
+        qsort(entries, count, sizeof(CacheEntry), compare_least_recently_used);
+        // the most recently used entry is kept even when it alone is over the limit
+        for (size_t i = 0; i + 1 < count && total_bytes > BUILD_CACHE_MAX_BYTES; i++) {
+            char path[CACHE_PATH_CAPACITY];
+            entry_path(directory, entries[i].name, path);
+            if (unlink(path) == 0 || errno == ENOENT) total_bytes -= entries[i].bytes;
+        }
+    }
+    free(entries);
+}
+
+void
+build_cache_store(BuildCache cache, const char* outfile)
+{
+    int status = mkdir(cache.directory, 0777);
+    if (status != 0 && errno != EEXIST)
+        errorf("failed to make (%s) directory (%s)", cache.directory, strerror(errno));
+
+    char path[CACHE_PATH_CAPACITY];
+    cache_entry_path(cache, path);
+    if (!install_file(outfile, path))
+        errorf("unable to open (%s) for reading (%s)", outfile, strerror(errno));
+    evict_least_recently_used(cache.directory);
+}
@@ -0,0 +1,31 @@
+#ifndef BUILD_CACHE_H
+#define BUILD_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    const char* directory;
+    uint64_t key;
+} BuildCache;
+
+// The key covers the source files along with their paths and namespaces, which end up in
+// the binary's diagnostics and symbols, npc itself, the runtime files (the archive the
+// program links against and the headers its C includes) and `options`, which should
+// describe every flag that changes the build
+BuildCache build_cache_init(
+    const char* directory,
+    const char* const* source_paths,
+    const char* const* source_namespaces,
+    size_t source_count,
+    const char* const* runtime_files,
+    size_t runtime_files_count,
+    const char* options
+);
+// copies a previously built binary to `outfile`, returns false on a cache miss
+bool build_cache_fetch(BuildCache cache, const char* outfile);
+// removes the least recently stored or fetched entries once the cache grows too large
+void build_cache_store(BuildCache cache, const char* outfile);
+
+#endif
@@ -5,6 +5,7 @@
 #include "compiler.h"
 #include "diagnostics.h"
 #include "tokens.h"
+#include "writer.h"
 
 #define STRING_CONSTANTS_TABLE_NAME "NOT_PYTHON_STRING_CONSTANTS"
 
@@ -28,6 +29,7 @@ typedef enum {
     SEC_FORWARD,
     SEC_TYPEDEFS,
     SEC_DECLARATIONS,
+    SEC_GLOBALS,
     SEC_DEFS,
     SEC_INIT,
     SEC_MAIN,
@@ -39,59 +41,246 @@ typedef struct {
     size_t remaining;
     char* buffer;
     char* write;
+    // the source line named by the last #line directive and how many directives mapping
+    // the writer's own code back onto the C are waiting for the line they're written at
+    Location line;
+    size_t line_resets;
 } Section;
 
+// a file the sections are written to, `name` is what cc knows it by
+typedef struct {
+    FILE* file;
+    const char* name;
+    size_t lines;
+} COutput;
+
 typedef struct {
     const char* current_loop_after_label;
     Section sections[SEC_COUNT];
-    FILE* out;
+    // the function definitions of each translation unit, the unit being written to is
+    // swapped into `sections[SEC_DEFS]`
+    Section* units;
+    size_t units_count;
+    size_t current_unit;
+    // how deeply nested the function definition being written is
+    size_t function_depth;
+    bool profile;
+    bool trace_allocs;
+    bool line_directives;
+    // the site the program is known to have set when it reaches the code being written,
+    // unset when that depends on the path it took to get there
+    Location alloc_site;
 } Writer;
 
 static void section_free(Section* section);
 static void write(Section* section, const char* data);
-static void write_string_constants_table(StringHashmap strings, Section* forward);
+static void write_many(Section* section, const char** null_terminated_string_list);
+static void write_string_constants_table(
+    StringHashmap strings, const char* id_namespace, Writer* writer
+);
 static void write_instruction(Writer* writer, SectionID s, Instruction inst);
+static void write_line_reset(Section* section);
 
-void
-write_c_program(CompiledInstructions instructions, FILE* out)
+static void
+write_program(Writer* writer, CompiledInstructions instructions, WriterOptions opts)
 {
-    Writer writer = {.out = out};
-
 #if DEBUG
-    write(writer.sections + SEC_FORWARD, "\n// FORWARD COMPILER SECTION\n");
-    write(writer.sections + SEC_TYPEDEFS, "\n// TYPEDEFS COMPILER SECTION\n");
-    write(writer.sections + SEC_DECLARATIONS, "\n// DECLARATIONS COMPILER SECTION\n");
-    write(writer.sections + SEC_DEFS, "\n// FUNCTION DEFINITIONS COMPILER SECTION\n");
-    write(writer.sections + SEC_INIT, "\n// INIT MODULE FUNCTION COMPILER SECTION\n");
-    write(writer.sections + SEC_MAIN, "\n// MAIN FUNCTION COMPILER SECTION\n");
+    write(writer->sections + SEC_FORWARD, "\n// FORWARD COMPILER SECTION\n");
+    write(writer->sections + SEC_TYPEDEFS, "\n// TYPEDEFS COMPILER SECTION\n");
+    write(writer->sections + SEC_DECLARATIONS, "\n// DECLARATIONS COMPILER SECTION\n");
+    write(writer->sections + SEC_GLOBALS, "\n// GLOBALS COMPILER SECTION\n");
+    write(writer->sections + SEC_DEFS, "\n// FUNCTION DEFINITIONS COMPILER SECTION\n");
+    write(writer->sections + SEC_INIT, "\n// INIT MODULE FUNCTION COMPILER SECTION\n");
+    write(writer->sections + SEC_MAIN, "\n// MAIN FUNCTION COMPILER SECTION\n");
 #endif
 
-    write(writer.sections + SEC_FORWARD, "#include <not_python.h>\n");
-    write(writer.sections + SEC_INIT, "static int init_module(void) {\n");
-    write(writer.sections + SEC_MAIN, "int main(void) {\ninit_module();\n");
+    writer->profile = opts.profile;
+    writer->trace_allocs = opts.trace_allocs;
+    writer->line_directives = opts.line_directives;
+    // the init function and main are the writer's own and follow the functions' #lines
+    if (opts.line_directives) write_line_reset(writer->sections + SEC_INIT);
+    if (opts.inline_runtime)
+        write(writer->sections + SEC_FORWARD, "#include <not_python_inline.h>\n");
+    else
+        write(writer->sections + SEC_FORWARD, "#include <not_python.h>\n");
+    if (instructions.module_init) {
+        // a module imported by several others still only runs once
+        write_many(
+            writer->sections + SEC_INIT,
+            (const char*[]){"int ", instructions.module_init, "(void) {\n", NULL}
+        );
+        write(
+            writer->sections + SEC_INIT,
+            "static int initialized = 0;\n"
+            "if (initialized) return 0;\n"
+            "initialized = 1;\n"
+        );
+    }
+    else {
+        write(writer->sections + SEC_INIT, "static int init_module(void) {\n");
+        write(writer->sections + SEC_MAIN, "int main(void) {\n");
+        if (opts.trace_allocs)
+            write(writer->sections + SEC_MAIN, "np_alloc_trace_start();\n");
+        write(writer->sections + SEC_MAIN, "init_module();\n");
+    }
     write_string_constants_table(
-        instructions.str_constants, writer.sections + SEC_FORWARD
+        instructions.str_constants, instructions.id_namespace, writer
     );
 
     if (instructions.req.libs[LIB_MATH])
-        write(writer.sections + SEC_FORWARD, "#include <math.h>\n");
+        write(writer->sections + SEC_FORWARD, "#include <math.h>\n");
 
     // TODO: write instructions
     for (size_t i = 0; i < instructions.seq.count; i++) {
         Instruction inst = instructions.seq.instructions[i];
-        write_instruction(&writer, SEC_INIT, inst);
+        write_instruction(writer, SEC_INIT, inst);
     }
 
-    write(writer.sections + SEC_INIT, "}");
-    write(writer.sections + SEC_MAIN, "return 0;\n}");
+    if (opts.line_directives) write_line_reset(writer->sections + SEC_INIT);
+    write(writer->sections + SEC_INIT, "}");
+    if (!instructions.module_init) write(writer->sections + SEC_MAIN, "return 0;\n}");
+}
+
+// stands in for a #line naming the C until the line it's written at is known
+#define LINE_RESET "#line reset\n"
+
+static size_t
+write_chunk(COutput* out, const char* data, size_t length)
+{
+    fwrite(data, length, 1, out->file);
+    for (const char* end = data + length; (data = memchr(data, '\n', end - data)); data++)
+        out->lines += 1;
+    return length;
+}
 
-    for (SectionID s = 0; s < SEC_COUNT; s++) {
-        Section sec = writer.sections[s];
-        fwrite(sec.buffer, sec.capacity - sec.remaining, 1, out);
-        section_free(&sec);
+static size_t
+write_section(Section* section, COutput* out)
+{
+    const char* data = section->buffer;
+    const char* end = data + (section->capacity - section->remaining);
+    size_t written = 0;
+    for (size_t i = 0; i < section->line_resets; i++) {
+        const char* reset = data;
+        while ((reset = strstr(reset, LINE_RESET)) != data && reset[-1] != '\n') reset++;
+        written += write_chunk(out, data, reset - data);
+        // a #line names the line after its own
+        int directive =
+            fprintf(out->file, "#line %zu \"%s\"\n", out->lines + 2, out->name);
+        if (directive > 0) written += directive;
+        out->lines += 1;
+        data = reset + strlen(LINE_RESET);
     }
+    written += write_chunk(out, data, end - data);
+    section_free(section);
+    return written;
+}
 
+struct PendingC {
+    Writer writer;
+    const char* c_filepath;
+};
+
+PendingC*
+generate_c_program(CompiledInstructions instructions, WriterOptions opts)
+{
+    PendingC* program = calloc(1, sizeof(PendingC));
+    if (!program) error("out of memory");
+    program->c_filepath = opts.c_filepath;
+    write_program(&program->writer, instructions, opts);
+    return program;
+}
+
+size_t
+write_pending_c(PendingC* program, FILE* out)
+{
+    COutput c_out = {.file = out, .name = program->c_filepath};
+    size_t written = 0;
+    for (SectionID s = 0; s < SEC_COUNT; s++)
+        written += write_section(program->writer.sections + s, &c_out);
     fflush(out);
+    free(program);
+    return written;
+}
+
+size_t
+write_c_program(CompiledInstructions instructions, FILE* out, WriterOptions opts)
+{
+    return write_pending_c(generate_c_program(instructions, opts), out);
+}
+
+size_t
+write_c_program_split(
+    CompiledInstructions instructions, SplitOutput out, WriterOptions opts
+)
+{
+    Writer writer = {.units_count = out.units_count};
+    writer.units = calloc(out.units_count, sizeof(Section));
+    if (!writer.units) error("out of memory");
+    write_program(&writer, instructions, opts);
+    writer.units[writer.current_unit] = writer.sections[SEC_DEFS];
+
+    size_t written = 0;
+    COutput header = {.file = out.header, .name = out.header_name};
+    for (SectionID s = 0; s < SEC_GLOBALS; s++)
+        written += write_section(writer.sections + s, &header);
+    fflush(out.header);
+
+    for (size_t i = 0; i < out.units_count; i++) {
+        // only the first unit has code of the writer's own to map back onto the C
+        COutput unit = {.file = out.units[i], .name = opts.c_filepath, .lines = 1};
+        int include = fprintf(out.units[i], "#include \"%s\"\n", out.header_name);
+        if (include > 0) written += include;
+        if (i == 0) written += write_section(writer.sections + SEC_GLOBALS, &unit);
+        written += write_section(writer.units + i, &unit);
+        if (i == 0) {
+            written += write_section(writer.sections + SEC_INIT, &unit);
+            written += write_section(writer.sections + SEC_MAIN, &unit);
+        }
+        fflush(out.units[i]);
+    }
+    free(writer.units);
+    return written;
+}
+
+// splitting only pays for itself once there's enough for each cc to do
+#define FUNCTIONS_PER_UNIT_MIN 64
+
+static size_t
+count_function_definitions(InstructionSequence seq)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < seq.count; i++) {
+        if (seq.instructions[i].kind == INST_DEFINE_FUNCTION)
+            count++;
+        else if (seq.instructions[i].kind == INST_DEFINE_CLASS)
+            count += count_function_definitions(seq.instructions[i].define_class.body);
+    }
+    return count;
+}
+
+size_t
+split_units_count(CompiledInstructions instructions, size_t max_units)
+{
+    size_t units = count_function_definitions(instructions.seq) / FUNCTIONS_PER_UNIT_MIN;
+    if (units > max_units) units = max_units;
+    return (units) ? units : 1;
+}
+
+// top level functions go to whichever unit has the least written to it so far, closures
+// stay with the function that defines them
+static void
+select_unit(Writer* writer)
+{
+    if (writer->units_count < 2 || writer->function_depth > 0) return;
+    writer->units[writer->current_unit] = writer->sections[SEC_DEFS];
+    size_t least = 0;
+    for (size_t i = 1; i < writer->units_count; i++) {
+        if (writer->units[i].capacity - writer->units[i].remaining <
+            writer->units[least].capacity - writer->units[least].remaining)
+            least = i;
+    }
+    writer->current_unit = least;
+    writer->sections[SEC_DEFS] = writer->units[least];
 }
 
 static void
@@ -204,24 +393,52 @@ write_type_info(Section* section, TypeInfo info)
 }
 
 static void
-write_string_constants_table(StringHashmap strings, Section* forward)
+write_string_constants_table(
+    StringHashmap strings, const char* id_namespace, Writer* writer
+)
 {
-    write(forward, DATATYPE_STRING " " STRING_CONSTANTS_TABLE_NAME "[] = {\n");
+    Section* forward = writer->sections + SEC_FORWARD;
+    Section* table = forward;
+    // every module of a program has its own table, the units of a split module share
+    // theirs so it's given a name unique to the module
+    if (writer->units_count > 1) {
+        table = writer->sections + SEC_GLOBALS;
+        if (id_namespace[0]) {
+            write(forward, "#define " STRING_CONSTANTS_TABLE_NAME " ");
+            write_many(
+                forward,
+                (const char*[]){STRING_CONSTANTS_TABLE_NAME, id_namespace, "\n", NULL}
+            );
+        }
+        write(forward, "extern " DATATYPE_STRING " " STRING_CONSTANTS_TABLE_NAME "[];\n");
+    }
+    else
+        write(table, "static ");
+    write(table, DATATYPE_STRING " " STRING_CONSTANTS_TABLE_NAME "[] = {\n");
     for (size_t i = 0; i < strings.count; i++) {
         SourceString str = strings.elements[i];
-        if (i > 0) write(forward, ",\n");
-        write(forward, "{.data=\"");
-        write(forward, str.data);
-        write(forward, "\", .length=");
+        if (i > 0) write(table, ",\n");
+        write(table, "{.data=\"");
+        write(table, str.data);
+        write(table, "\", .length=");
         char length_as_str[21];
         snprintf(length_as_str, 21, "%zu", str.length);
-        write(forward, length_as_str);
-        write(forward, "}");
+        write(table, length_as_str);
+        write(table, "}");
     }
-    write(forward, "};\n");
+    write(table, "};\n");
     str_hm_free(&strings);
 }
 
+static void
+write_closure_field_name(Section* section, Variable* var)
+{
+    // the identifier alone isn't unique as closure children may shadow the parent
+    char numbuf[21];
+    snprintf(numbuf, 21, "%zu", var->closure_index);
+    write_many(section, (const char*[]){var->identifier.data, "_", numbuf, NULL});
+}
+
 static void
 write_ident(Section* section, StorageIdent ident)
 {
@@ -245,32 +462,43 @@ write_ident(Section* section, StorageIdent ident)
         case IDENT_VAR:
             if (ident.var->kind == VAR_CLOSURE ||
                 ident.var->kind == VAR_CLOSURE_ARGUMENT) {
-                // (*(type*)(__ctx__.closure + closure_offset))
-                write(section, "(*(");
-                write_type_info(section, ident.var->type_info);
-                write(section, "*)(__ctx__.closure + ");
-                char numbuf[21];
-                snprintf(numbuf, 21, "%zu", ident.var->closure_offset);
-                write(section, numbuf);
-                write(section, "))");
+                // ((closure_type*)__ctx__.closure)->field
+                write_many(
+                    section,
+                    (const char*[]){
+                        "((",
+                        ident.var->closure_type,
+                        "*)__ctx__.closure)->",
+                        NULL,
+                    }
+                );
+                write_closure_field_name(section, ident.var);
             }
             else if (ident.var->kind == VAR_SELF) {
-                // (type)__ctx__.self
-                write(section, "(");
+                // ((type)__ctx__.self)
+                write(section, "((");
                 write_type_info(section, ident.var->type_info);
-                write(section, ")__ctx__.self");
+                write(section, ")__ctx__.self)");
             }
             else {
                 write(section, ident.var->compiled_name.data);
             }
             break;
         case IDENT_INT_LITERAL:
-            if (snprintf(buffer, buflen, "%i", ident.int_value) >= buflen)
+            // negative literals are parenthesized so they can follow a unary `-`
+            if (snprintf(
+                    buffer, buflen, (ident.int_value < 0) ? "(%i)" : "%i", ident.int_value
+                ) >= buflen)
                 error("int literal buffer overflow");
             write(section, buffer);
             break;
         case IDENT_FLOAT_LITERAL:
-            if (snprintf(buffer, buflen, "%f", ident.float_value) >= buflen)
+            if (snprintf(
+                    buffer,
+                    buflen,
+                    (ident.float_value < 0) ? "(%f)" : "%f",
+                    ident.float_value
+                ) >= buflen)
                 error("float literal buffer overflow");
             write(section, buffer);
             break;
@@ -478,6 +706,49 @@ write_ident_attr(Section* section, StorageIdent object, const char* attr)
     }
 }
 
+// `return_type function_name(NpContext __ctx__, type1 param1, ...`
+static void
+write_function_signature(
+    Section* section, const char* function_name, Signature signature, bool context
+)
+{
+    write_type_info(section, signature.return_type);
+    write_many(section, (const char*[]){" ", function_name, "(", NULL});
+    if (context) write(section, DATATYPE_CONTEXT " __ctx__");
+    for (size_t i = 0; i < signature.params_count; i++) {
+        if (context || i > 0) write(section, ", ");
+        write_type_info(section, signature.types[i]);
+        write_many(section, (const char*[]){" ", signature.params[i].data, NULL});
+    }
+    if (!context && signature.params_count == 0) write(section, "void");
+}
+
+static void
+write_direct_function_call(Section* section, OperationInst call)
+{
+    FunctionStatement* fndef = call.function.func;
+    bool context = FUNCTION_USES_CONTEXT(fndef);
+
+    write_many(section, (const char*[]){fndef->compiled_name, "(", NULL});
+    if (fndef->is_method) {
+        // (NpContext){.self = self}
+        write(section, "(" DATATYPE_CONTEXT "){.self = ");
+        write_ident(section, call.self);
+        write(section, "}");
+    }
+    else if (context && fndef->scope->kind == SCOPE_CLOSURE_CHILD)
+        // closure children share the context of the function they're called from
+        write(section, "__ctx__");
+    else if (context)
+        write(section, "global_context");
+
+    for (size_t i = 0; i < fndef->sig.params_count; i++) {
+        if (context || i > 0) write(section, ", ");
+        write_ident(section, call.args[i]);
+    }
+    write(section, ")");
+}
+
 static void
 write_operation(Section* section, OperationInst operation_inst)
 {
@@ -488,6 +759,11 @@ write_operation(Section* section, OperationInst operation_inst)
             );
             break;
         case OPERATION_FUNCTION_CALL:
+            if (operation_inst.function.kind == IDENT_FUNCTION &&
+                !operation_inst.function.func->decorator) {
+                write_direct_function_call(section, operation_inst);
+                break;
+            }
             // cast func.__addr__ to correct type -> ((cast_type)function.addr)
             // cast type -> return_type (*) (NpContext, param_type_0, ...)
             write(section, "((");
@@ -552,26 +828,211 @@ write_operation(Section* section, OperationInst operation_inst)
 }
 
 static void
-write_instruction(Writer* writer, SectionID s, Instruction inst)
+write_init_closure(Writer* writer, SectionID s, ClosureInst* closure)
+{
+    // nothing is ever read from an empty closure
+    if (closure->variables_count == 0) return;
+
+    // typedef struct { type field; ... } closure_type;
+    Section* typedefs = writer->sections + SEC_DECLARATIONS;
+    write(typedefs, "typedef struct { ");
+    for (size_t i = 0; i < closure->variables_count; i++) {
+        write_type_info(typedefs, closure->variables[i]->type_info);
+        write(typedefs, " ");
+        write_closure_field_name(typedefs, closure->variables[i]);
+        write(typedefs, "; ");
+    }
+    write_many(typedefs, (const char*[]){"} ", closure->type_name, ";\n", NULL});
+
+    if (closure->escapes)
+        // closure children may outlive this call so the closure is never freed
+        // __ctx__.closure = np_alloc(sizeof(closure_type));
+        write_many(
+            writer->sections + s,
+            (const char*[]){
+                "__ctx__.closure = ",
+                NPLIB_FUNCTION_DATA[NPLIB_ALLOC].name,
+                "(sizeof(",
+                closure->type_name,
+                "));\n",
+                NULL,
+            }
+        );
+    else
+        // closure_type __closure__ = {0};
+        // __ctx__.closure = (NpByte*)&__closure__;
+        write_many(
+            writer->sections + s,
+            (const char*[]){
+                closure->type_name,
+                " __closure__ = {0};\n",
+                "__ctx__.closure = (NpByte*)&__closure__;\n",
+                NULL,
+            }
+        );
+}
+
+// the imported symbols are defined by the module's own translation unit
+static void
+write_import_module(Writer* writer, SectionID s, ImportModuleInst import)
+{
+    Section* declarations = writer->sections + SEC_DECLARATIONS;
+    write_many(
+        declarations, (const char*[]){"int ", import.init_function, "(void);\n", NULL}
+    );
+    for (size_t i = 0; i < import.variables_count; i++) {
+        Variable* var = import.variables[i];
+        write(declarations, "extern ");
+        write_type_info(declarations, var->type_info);
+        write_many(
+            declarations, (const char*[]){" ", var->compiled_name.data, ";\n", NULL}
+        );
+    }
+    for (size_t i = 0; i < import.functions_count; i++) {
+        FunctionStatement* fndef = import.functions[i];
+        write_function_signature(
+            declarations, fndef->compiled_name, fndef->sig, FUNCTION_USES_CONTEXT(fndef)
+        );
+        write(declarations, ");\n");
+        write_many(
+            declarations,
+            (const char*[]){
+                "extern " DATATYPE_FUNC " ", fndef->ns_ident.data, ";\n", NULL}
+        );
+    }
+    write_many(
+        writer->sections + s, (const char*[]){import.init_function, "();\n", NULL}
+    );
+}
+
+static void
+write_c_string(Section* section, const char* str)
+{
+    write(section, "\"");
+    for (const char* c = str; *c; c++) {
+        char escaped[3] = {'\\', *c, '\0'};
+        char plain[2] = {*c, '\0'};
+        write(section, (*c == '"' || *c == '\\') ? escaped : plain);
+    }
+    write(section, "\"");
+}
+
+static bool
+location_eq(Location a, Location b)
+{
+    return a.filepath == b.filepath && a.line == b.line;
+}
+
+// everything written up to the next directive is attributed to the same source line
+static void
+write_line_directive(Section* section, Location loc)
+{
+    if (!loc.filepath || location_eq(loc, section->line)) return;
+    char line[16];
+    snprintf(line, sizeof(line), "%u", loc.line);
+    write_many(section, (const char*[]){"#line ", line, " ", NULL});
+    write_c_string(section, loc.filepath);
+    write(section, "\n");
+    section->line = loc;
+}
+
+// maps what follows back onto the C, resolved by write_section
+static void
+write_line_reset(Section* section)
+{
+    write(section, LINE_RESET);
+    section->line = (Location){0};
+    section->line_resets += 1;
+}
+
+static bool
+calls_function(Instruction inst)
 {
     switch (inst.kind) {
-        case INST_INIT_CLOSURE: {
-            char num_buf[21];
-            snprintf(num_buf, 21, "%zu", *inst.closure_size);
+        case INST_OPERATION:
+            return inst.operation.kind == OPERATION_FUNCTION_CALL;
+        case INST_ASSIGNMENT:
+        case INST_DECL_ASSIGNMENT:
+            return inst.assignment.right.kind == OPERATION_FUNCTION_CALL;
+        case INST_IMPORT_MODULE:
+            return true;
+        default:
+            return false;
+    }
+}
 
-            write_many(
-                writer->sections + s,
-                (const char*[]){
-                    "__ctx__.closure = ",
-                    NPLIB_FUNCTION_DATA[NPLIB_ALLOC].name,
-                    "(",
-                    num_buf,
-                    ");\n",
-                    NULL,
-                }
-            );
+// the site is set again by the first instruction of a line, and after any call to a
+// function as it will have set its own
+static void
+write_alloc_site(Writer* writer, SectionID s, Instruction inst)
+{
+    switch (inst.kind) {
+        case INST_ASSIGNMENT:
+        case INST_DECL_ASSIGNMENT:
+        case INST_OPERATION:
+        case INST_ITER_NEXT:
+        case INST_INIT_CLOSURE:
+        case INST_IMPORT_MODULE:
             break;
+        case INST_DECLARE_VARIABLE:
+        case INST_RETURN:
+        case INST_NO_OP:
+            return;
+        case INST_IF:
+            // the body can only be entered from here, what's known after it is up to
+            // the body
+            return;
+        default:
+            // anything else may be jumped to or from
+            writer->alloc_site = (Location){0};
+            return;
+    }
+    if (!inst.loc.filepath) return;
+    if (!location_eq(inst.loc, writer->alloc_site)) {
+        char line[16];
+        snprintf(line, sizeof(line), "%u", inst.loc.line);
+        write(writer->sections + s, "NP_ALLOC_SITE(");
+        write_c_string(writer->sections + s, inst.loc.filepath);
+        write_many(writer->sections + s, (const char*[]){", ", line, ");\n", NULL});
+        writer->alloc_site = inst.loc;
+    }
+    if (calls_function(inst)) writer->alloc_site = (Location){0};
+}
+
+// every return of the function ends the frame started here
+static void
+write_profile_enter(Writer* writer, DefineFunctionInst define_function)
+{
+    write_many(
+        writer->sections + SEC_DEFS,
+        (const char*[]){
+            "static NpProfileEntry np_profile_entry = {\"",
+            define_function.fndef->name.data,
+            "\", \"",
+            define_function.function_name,
+            "\"};\n"
+            "NpProfileFrame np_profile_frame;\n"
+            "np_profile_enter(&np_profile_entry, &np_profile_frame);\n",
+            NULL,
         }
+    );
+}
+
+static void
+write_instruction(Writer* writer, SectionID s, Instruction inst)
+{
+    // declarations may be written to another section and definitions write their own
+    if (writer->line_directives && inst.kind != INST_DECLARE_VARIABLE &&
+        inst.kind != INST_DEFINE_FUNCTION && inst.kind != INST_DEFINE_CLASS)
+        write_line_directive(writer->sections + s, inst.loc);
+    if (writer->trace_allocs) write_alloc_site(writer, s, inst);
+    switch (inst.kind) {
+        case INST_INIT_CLOSURE:
+            write_init_closure(writer, s, inst.closure);
+            break;
+        case INST_IMPORT_MODULE:
+            write_import_module(writer, s, inst.import_module);
+            break;
         case INST_ITER_NEXT:
             // iter.next_data = iter.next(iter.iter);
             write_ident_attr(writer->sections + s, inst.iter_next.iter, "next_data");
@@ -602,22 +1063,16 @@ write_instruction(Writer* writer, SectionID s, Instruction inst)
             write(writer->sections + s, ";\n");
             break;
         case INST_RETURN:
-            if (inst.return_.should_free_closure)
-                write_many(
-                    writer->sections + s,
-                    (const char*[]){
-                        NPLIB_FUNCTION_DATA[NPLIB_FREE].name,
-                        "(__ctx__.closure);\n",
-                        NULL,
-                    }
-                );
-
+            if (writer->profile && writer->function_depth > 0)
+                write(writer->sections + s, "np_profile_exit(&np_profile_frame);\n");
             write(writer->sections + s, "return ");
             write_ident(writer->sections + s, inst.return_.rtval);
             write(writer->sections + s, ";\n");
             break;
         case INST_LABEL:
-            write_many(writer->sections + s, (const char*[]){inst.label, ":\n", NULL});
+            // the empty statement keeps the label valid when the instruction after it
+            // was optimized away or declares a variable
+            write_many(writer->sections + s, (const char*[]){inst.label, ":;\n", NULL});
             break;
         case INST_GOTO:
             write_many(
@@ -628,7 +1083,8 @@ write_instruction(Writer* writer, SectionID s, Instruction inst)
             for (size_t i = 0; i < inst.else_.count; i++)
                 write_instruction(writer, s, inst.else_.instructions[i]);
             break;
-        case INST_IF:
+        case INST_IF: {
+            Location alloc_site = writer->alloc_site;
             write(writer->sections + s, "if (");
             if (inst.if_.negate) write(writer->sections + s, "!");
             write_ident(writer->sections + s, inst.if_.condition_ident);
@@ -636,7 +1092,11 @@ write_instruction(Writer* writer, SectionID s, Instruction inst)
             for (size_t i = 0; i < inst.if_.body.count; i++)
                 write_instruction(writer, s, inst.if_.body.instructions[i]);
             write(writer->sections + s, "}\n");
+            // the site is only known if it's the same whether or not the body ran
+            if (!location_eq(writer->alloc_site, alloc_site))
+                writer->alloc_site = (Location){0};
             break;
+        }
         case INST_LOOP: {
             const char* current = writer->current_loop_after_label;
             writer->current_loop_after_label = inst.loop.after_label;
@@ -649,6 +1109,7 @@ write_instruction(Writer* writer, SectionID s, Instruction inst)
             write(writer->sections + s, "while(");
             write_ident(writer->sections + s, inst.loop.condition);
             write(writer->sections + s, ") {\n");
+            writer->alloc_site = (Location){0};
 
             // before
             for (size_t i = 0; i < inst.loop.before.count; i++)
@@ -664,6 +1125,7 @@ write_instruction(Writer* writer, SectionID s, Instruction inst)
 
             write(writer->sections + s, "}\n");
             writer->current_loop_after_label = current;
+            writer->alloc_site = (Location){0};
             break;
         }
         case INST_NO_OP:
@@ -706,11 +1168,25 @@ write_instruction(Writer* writer, SectionID s, Instruction inst)
                 }
             }
 
+            bool global =
+                s == SEC_INIT &&
+                (is_variable || inst.declare_variable.info.type == NPTYPE_FUNCTION);
             Section* section =
-                (s == SEC_INIT &&
-                 (is_variable || inst.declare_variable.info.type == NPTYPE_FUNCTION))
-                    ? writer->sections + SEC_DECLARATIONS
-                    : writer->sections + s;
+                (global) ? writer->sections + SEC_GLOBALS : writer->sections + s;
+
+            // the units of a split program all see the globals defined by the first
+            if (global && writer->units_count > 1) {
+                Section* declarations = writer->sections + SEC_DECLARATIONS;
+                write(declarations, "extern ");
+                write_type_info(
+                    declarations,
+                    (is_variable) ? inst.declare_variable.var->type_info
+                                  : inst.declare_variable.info
+                );
+                write(declarations, " ");
+                write_ident(declarations, inst.declare_variable);
+                write(declarations, ";\n");
+            }
 
             write_type_info(
                 section,
@@ -737,6 +1213,7 @@ write_instruction(Writer* writer, SectionID s, Instruction inst)
                 (Instruction){
                     .kind = INST_ASSIGNMENT,
                     .assignment = inst.assignment,
+                    .loc = inst.loc,
                 }
             );
             break;
@@ -779,40 +1256,27 @@ write_instruction(Writer* writer, SectionID s, Instruction inst)
             size_t funcs_waiting_list[FUNCS_WAITING_CAP];
             size_t funcs_waiting_count = 0;
 
+            select_unit(writer);
+            writer->function_depth++;
+
+            bool context = inst.define_function.adapter_name == NULL;
+            if (writer->line_directives)
+                write_line_directive(writer->sections + SEC_DEFS, inst.loc);
             SectionID secs[2] = {SEC_DEFS, SEC_DECLARATIONS};
             for (size_t j = 0; j < 2; j++) {
-                // `return_type function_name(NpContext __ctx__`
-                write_type_info(
-                    writer->sections + secs[j], inst.define_function.signature.return_type
-                );
-                write_many(
+                write_function_signature(
                     writer->sections + secs[j],
-                    (const char*[]){
-                        " ",
-                        inst.define_function.function_name,
-                        "(" DATATYPE_CONTEXT " __ctx__",
-                        NULL}
+                    inst.define_function.function_name,
+                    inst.define_function.signature,
+                    context
                 );
-
-                // `, type1 param1` for each param
-                for (size_t i = 0; i < inst.define_function.signature.params_count; i++) {
-                    write(writer->sections + secs[j], ", ");
-                    write_type_info(
-                        writer->sections + secs[j],
-                        inst.define_function.signature.types[i]
-                    );
-                    write_many(
-                        writer->sections + secs[j],
-                        (const char*[]){
-                            " ", inst.define_function.signature.params[i].data, NULL}
-                    );
-                }
             }
             // declaration complete
             write(writer->sections + SEC_DECLARATIONS, ");\n");
 
             // begin scope -- function body -- end scope
             write(writer->sections + SEC_DEFS, ") {\n");
+            if (writer->profile) write_profile_enter(writer, inst.define_function);
             for (size_t i = 0; i < inst.define_function.body.count; i++) {
                 Instruction body_inst = inst.define_function.body.instructions[i];
                 if (body_inst.kind == INST_DEFINE_FUNCTION) {
@@ -825,6 +1289,36 @@ write_instruction(Writer* writer, SectionID s, Instruction inst)
             }
             write(writer->sections + SEC_DEFS, "}\n");
 
+            // calls through `__addr__` always pass an NpContext, so functions
+            // compiled without one get an adapter that drops it
+            if (!context) {
+                if (writer->line_directives)
+                    write_line_directive(writer->sections + SEC_DEFS, inst.loc);
+                for (size_t j = 0; j < 2; j++) {
+                    write_function_signature(
+                        writer->sections + secs[j],
+                        inst.define_function.adapter_name,
+                        inst.define_function.signature,
+                        true
+                    );
+                }
+                write(writer->sections + SEC_DECLARATIONS, ");\n");
+                write_many(
+                    writer->sections + SEC_DEFS,
+                    (const char*[]){
+                        ") {\nreturn ", inst.define_function.function_name, "(", NULL}
+                );
+                for (size_t i = 0; i < inst.define_function.signature.params_count;
+                     i++) {
+                    if (i > 0) write(writer->sections + SEC_DEFS, ", ");
+                    write(
+                        writer->sections + SEC_DEFS,
+                        inst.define_function.signature.params[i].data
+                    );
+                }
+                write(writer->sections + SEC_DEFS, ");\n}\n");
+            }
+
             // this function is written, now we can write child functions
             for (size_t i = 0; i < funcs_waiting_count; i++)
                 write_instruction(
@@ -832,6 +1326,8 @@ write_instruction(Writer* writer, SectionID s, Instruction inst)
                     s,
                     inst.define_function.body.instructions[funcs_waiting_list[i]]
                 );
+            writer->function_depth--;
+            writer->alloc_site = (Location){0};
         }
     }
 }
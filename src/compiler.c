@@ -84,6 +84,7 @@ static void seq_stack_append_instruction(SequenceStack* stack, Instruction inst)
 
 typedef struct {
     Arena* arena;
+    CompilerOptions opts;
     Requirements reqs;
     LexicalScope* top_level_scope;
     LexicalScopeStack scope_stack;
@@ -91,20 +92,30 @@ typedef struct {
     FileIndex file_index;
     Location current_stmt_location;
     Location current_operation_location;
+    // given to instructions as they're added, restored once a nested statement is done
+    // so the rest of the outer statement's instructions are given its location
+    Location instruction_location;
     TypeChecker tc;
     StorageIdent none_ident;
     StorageIdent empty_str_ident;
+    const char* id_namespace;
     size_t unique_vars_counter;
     const char* excepts_goto;
     LexicalScope* try_scope;
     const char* loop_after;
+    ClosureInst* closure;
     SequenceStack inst_seq_stack;
 } Compiler;
 
 #define UNIQUE_ID(compiler)                                                              \
-    arena_snprintf(compiler->arena, 16, "_np_%zu", compiler->unique_vars_counter++)
+    arena_snprintf(                                                                      \
+        (compiler)->arena,                                                               \
+        strlen((compiler)->id_namespace) + 24,                                           \
+        "_np_%s%zu",                                                                     \
+        (compiler)->id_namespace,                                                        \
+        (compiler)->unique_vars_counter++                                                \
+    )
 
-static size_t str_hm_put(StringHashmap* hm, SourceString element);
 
 static void compile_statement(Compiler* compiler, Statement* stmt);
 static void compile_set_item(
@@ -140,21 +151,22 @@ static StorageIdent render_object_method_call(
     Arguments* args
 );
 
-static InstructionSequence instruction_sequence_init(Arena* arena);
-static void instruction_sequence_finalize(InstructionSequence* sequence);
 static void add_instruction(Compiler* compiler, Instruction inst);
 
 #define SOURCESTRING(string)                                                             \
     (SourceString) { .data = string, .length = sizeof(string) - 1 }
 
 CompiledInstructions
-compile(Lexer* lexer)
+compile(Lexer* lexer, CompilerOptions opts)
 {
     Compiler compiler = {
         .arena = lexer->arena,
+        .opts = opts,
         .file_index = lexer->index,
         .top_level_scope = lexer->top_level,
         .tc.arena = lexer->arena,
+        // the entry module keeps the short names
+        .id_namespace = (opts.module_init) ? lexer->file_namespace : "",
     };
     seq_stack_push_new(&compiler.inst_seq_stack, compiler.arena);
     compiler.none_ident = (StorageIdent){
@@ -177,11 +189,13 @@ compile(Lexer* lexer)
     return (CompiledInstructions){
         .seq = seq_stack_pop(&compiler.inst_seq_stack),
         .req = compiler.reqs,
+        .module_init = opts.module_init,
+        .id_namespace = compiler.id_namespace,
         // TODO: make sure writer frees this when no longer needed
         .str_constants = compiler.str_hm};
 }
 
-static InstructionSequence
+InstructionSequence
 instruction_sequence_init(Arena* arena)
 {
     InstructionSequence seq = {
@@ -213,6 +227,41 @@ instruction_sequence_finalize(InstructionSequence* sequence)
         arena_dynamic_finalize(sequence->arena, sequence->instructions);
 }
 
+size_t
+nested_sequences(Instruction* inst, InstructionSequence* out[NESTED_SEQUENCES_MAX])
+{
+    switch (inst->kind) {
+        case INST_LOOP:
+            out[0] = &inst->loop.init;
+            out[1] = &inst->loop.before;
+            out[2] = &inst->loop.body;
+            out[3] = &inst->loop.after;
+            return 4;
+        case INST_IF:
+            out[0] = &inst->if_.body;
+            return 1;
+        case INST_ELSE:
+            out[0] = &inst->else_;
+            return 1;
+        case INST_DEFINE_FUNCTION:
+            out[0] = &inst->define_function.body;
+            return 1;
+        case INST_DEFINE_CLASS:
+            out[0] = &inst->define_class.body;
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+bool
+is_exception_check(Instruction inst)
+{
+    return inst.kind == INST_IF && !inst.if_.negate &&
+           inst.if_.condition_ident.kind == IDENT_CSTR && inst.if_.condition_ident.cstr &&
+           strcmp(inst.if_.condition_ident.cstr, NPLIB_GLOBAL_EXCEPTION) == 0;
+}
+
 static void
 seq_stack_push(SequenceStack* stack, InstructionSequence seq)
 {
@@ -249,6 +298,7 @@ add_instruction(Compiler* compiler, Instruction inst)
         inst.declare_variable.info.type == NPTYPE_UNTYPED) {
         assert(0 && "trying to add untyped variable declaration");
     }
+    if (!inst.loc.filepath) inst.loc = compiler->instruction_location;
     seq_stack_append_instruction(&compiler->inst_seq_stack, inst);
     if (UNSAFE_INST(inst)) compile_check_exceptions(compiler);
 }
@@ -325,6 +375,30 @@ storage_ident_from_fndef(FunctionStatement* fndef)
     };
 }
 
+// calls may be compiled before the function definition so the compiled name is
+// assigned on first use, it's named after the function so profilers and debuggers show
+// something recognizable and the counter keeps apart closures that share a name
+static const char*
+function_compiled_name(Compiler* compiler, FunctionStatement* fndef)
+{
+    if (!fndef->compiled_name)
+        fndef->compiled_name = arena_snprintf(
+            compiler->arena,
+            fndef->ns_ident.length + 28,
+            "_np_%zu_%s",
+            compiler->unique_vars_counter++,
+            fndef->ns_ident.data
+        );
+    return fndef->compiled_name;
+}
+
+// functions rebound by a decorator must be called through the decorated object
+static bool
+is_direct_callable(FunctionStatement* fndef)
+{
+    return !fndef->decorator;
+}
+
 static void
 set_storage_type_info(Compiler* compiler, StorageIdent* ident, TypeInfo info)
 {
@@ -555,6 +629,36 @@ bind_self_to_function_object(Compiler* compiler, StorageIdent self, StorageIdent
     );
 }
 
+static StorageIdent render_function_object_copy(
+    Compiler* compiler, StorageHint hint, FunctionStatement* fndef
+);
+
+// methods are called directly with `self` bound to the call's context when possible,
+// otherwise `self` is bound to a copy of the function object
+static OperationInst
+render_method_call_operation(
+    Compiler* compiler, StorageIdent self, FunctionStatement* fndef, StorageIdent* argv
+)
+{
+    if (is_direct_callable(fndef)) {
+        function_compiled_name(compiler, fndef);
+        return (OperationInst){
+            .kind = OPERATION_FUNCTION_CALL,
+            .function = storage_ident_from_fndef(fndef),
+            .args = argv,
+            .self = self,
+        };
+    }
+
+    StorageIdent fn_ident = render_function_object_copy(compiler, NULL_HINT, fndef);
+    bind_self_to_function_object(compiler, self, fn_ident);
+    return (OperationInst){
+        .kind = OPERATION_FUNCTION_CALL,
+        .function = fn_ident,
+        .args = argv,
+    };
+}
+
 static Symbol*
 get_symbol(Compiler* compiler, SourceString identifier)
 {
@@ -1580,20 +1684,13 @@ convert_to_truthy(Compiler* compiler, StorageIdent id)
             if (!fndef) return id;
             StorageIdent rtval =
                 storage_ident_from_hint(compiler, (StorageHint){.info = BOOL_TYPE});
-            StorageIdent function_ident =
-                render_function_object_copy(compiler, NULL_HINT, fndef);
-            bind_self_to_function_object(compiler, id, function_ident);
             add_instruction(
                 compiler,
                 (Instruction){
                     .kind = INST_DECL_ASSIGNMENT,
                     .assignment.left = rtval,
                     .assignment.right =
-                        (OperationInst){
-                            .kind = OPERATION_FUNCTION_CALL,
-                            .function = function_ident,
-                            .args = NULL,
-                        },
+                        render_method_call_operation(compiler, id, fndef, NULL),
                 }
             );
             return rtval;
@@ -1655,19 +1752,12 @@ render_object_operation(
     StorageIdent rtval = storage_ident_from_hint(compiler, hint);
     check_storage_type_info(compiler, &rtval, fndef->sig.return_type);
 
-    StorageIdent function_ident = render_function_object_copy(compiler, NULL_HINT, fndef);
-    bind_self_to_function_object(compiler, self, function_ident);
     add_instruction(
         compiler,
         (Instruction){
             .kind = (IS_NULL_IDENTIFIER(hint)) ? INST_DECL_ASSIGNMENT : INST_ASSIGNMENT,
             .assignment.left = rtval,
-            .assignment.right =
-                (OperationInst){
-                    .kind = OPERATION_FUNCTION_CALL,
-                    .function = function_ident,
-                    .args = argv,
-                },
+            .assignment.right = render_method_call_operation(compiler, self, fndef, argv),
         }
     );
     return rtval;
@@ -2183,7 +2273,7 @@ render_token_operand(Compiler* compiler, StorageHint hint, Operand operand)
         // cannot be referenced and give a more informative error message.
         type_errorf(
             compiler->file_index,
-            *operand.token.loc,
+            file_index_location(&compiler->file_index, operand.token.offset),
             "unable to resolve the type for token `%s`",
             operand.token.value.data
         );
@@ -2207,6 +2297,10 @@ render_token_operand(Compiler* compiler, StorageHint hint, Operand operand)
                 value = storage_ident_from_variable(sym->variable);
                 break;
             case SYM_FUNCTION:
+                if (sym->func->scope->kind == SCOPE_CLOSURE_CHILD)
+                    // the function object may be stored and called after the parent
+                    // returns so the closure can't live on the parent's stack
+                    compiler->closure->escapes = true;
                 value = storage_ident_from_fndef(sym->func);
                 break;
             case SYM_CLASS:
@@ -2453,15 +2547,6 @@ render_object_method_call(
     Arguments* args
 )
 {
-    // copy the global function variable and bind `self` to the copy
-    StorageIdent fn_ident = render_function_object_copy(
-        compiler,
-        (StorageHint){.info.type = NPTYPE_FUNCTION, .info.sig = &fndef->sig},
-        fndef
-    );
-    bind_self_to_function_object(compiler, self_ident, fn_ident);
-
-    // make the function call
     StorageIdent rtval = storage_ident_from_hint(compiler, hint);
     check_storage_type_info(compiler, &rtval, fndef->sig.return_type);
 
@@ -2470,14 +2555,14 @@ render_object_method_call(
         (Instruction){
             .kind = (IS_NULL_IDENTIFIER(hint)) ? INST_DECL_ASSIGNMENT : INST_ASSIGNMENT,
             .assignment.left = rtval,
-            .assignment.right =
-                (OperationInst){
-                    .kind = OPERATION_FUNCTION_CALL,
-                    .function = fn_ident,
-                    .args = render_callable_args_to_variables(
-                        compiler, args, fndef->sig, fndef->name.data
-                    ),
-                },
+            .assignment.right = render_method_call_operation(
+                compiler,
+                self_ident,
+                fndef,
+                render_callable_args_to_variables(
+                    compiler, args, fndef->sig, fndef->name.data
+                )
+            ),
         }
     );
 
@@ -2585,8 +2670,10 @@ render_call_operation(
     const char* callable_name = NULL;
     if (fn_ident.kind == IDENT_VAR)
         callable_name = fn_ident.var->identifier.data;
-    else if (fn_ident.kind == IDENT_FUNCTION)
+    else if (fn_ident.kind == IDENT_FUNCTION) {
         callable_name = fn_ident.func->name.data;
+        function_compiled_name(compiler, fn_ident.func);
+    }
 
     add_instruction(
         compiler,
@@ -2757,7 +2844,7 @@ render_simple_expression(Compiler* compiler, StorageHint hint, Expression* expr)
 
     else if (expr->operations_count == 1) {
         Operation operation = expr->operations[0];
-        compiler->current_operation_location = *operation.loc;
+        compiler->current_operation_location = operation.loc;
 
         if (operation.op_type == OPERATOR_CALL) {
             Operand left = expr->operands[operation.left];
@@ -2784,7 +2871,7 @@ render_simple_expression(Compiler* compiler, StorageHint hint, Expression* expr)
             (operation.op_type == OPERATOR_LOGICAL_NOT ||
              operation.op_type == OPERATOR_NEGATIVE ||
              operation.op_type == OPERATOR_BITWISE_NOT);
-        StorageIdent operand_idents[2];
+        StorageIdent operand_idents[2] = {0};
         Operand operands[2] = {
             expr->operands[operation.left], expr->operands[operation.right]};
         for (size_t lr = (is_unary) ? 1 : 0; lr < 2; lr++) {
@@ -2798,16 +2885,17 @@ render_simple_expression(Compiler* compiler, StorageHint hint, Expression* expr)
 typedef struct {
     StorageIdent* previous_operations;
     StorageIdent** lookup_by_operand_index;
+    size_t operands_count;
     size_t operation_count;
 } ExpressionRecord;
 
 #define INIT_EXPRESSION_RECORD(varname, expression_ptr)                                  \
-    StorageIdent previous_ops_memory[(expression_ptr)->operations_count - 1];            \
+    StorageIdent previous_ops_memory[(expression_ptr)->operations_count];                \
     StorageIdent* lookup_by_operand_memory[(expression_ptr)->operands_count];            \
     memset(                                                                              \
         previous_ops_memory,                                                             \
         0,                                                                               \
-        sizeof(StorageIdent) * ((expression_ptr)->operations_count - 1)                  \
+        sizeof(StorageIdent) * ((expression_ptr)->operations_count)                      \
     );                                                                                   \
     memset(                                                                              \
         lookup_by_operand_memory,                                                        \
@@ -2817,8 +2905,27 @@ typedef struct {
     ExpressionRecord varname = {                                                         \
         .previous_operations = previous_ops_memory,                                      \
         .lookup_by_operand_index = lookup_by_operand_memory,                             \
+        .operands_count = (expression_ptr)->operands_count,                              \
         .operation_count = 0}
 
+// every operand that led to the previous result of `operand_index` is now part of the
+// current result, otherwise a later operation reaching the subexpression through one of
+// its other operands would use the stale result
+static void
+redirect_operand(
+    ExpressionRecord* record, size_t operand_index, StorageIdent* current_ref
+)
+{
+    StorageIdent* previous = record->lookup_by_operand_index[operand_index];
+    if (previous) {
+        for (size_t i = 0; i < record->operands_count; i++) {
+            if (record->lookup_by_operand_index[i] == previous)
+                record->lookup_by_operand_index[i] = current_ref;
+        }
+    }
+    record->lookup_by_operand_index[operand_index] = current_ref;
+}
+
 static void
 update_expression_record(
     ExpressionRecord* record, StorageIdent current, Operation operation
@@ -2829,23 +2936,11 @@ update_expression_record(
          operation.op_type == OPERATOR_NEGATIVE ||
          operation.op_type == OPERATOR_BITWISE_NOT);
 
-    StorageIdent** previously_rendered;
     record->previous_operations[record->operation_count] = current;
     StorageIdent* current_ref = record->previous_operations + record->operation_count++;
 
-    if (!is_unary) {
-        if ((previously_rendered = record->lookup_by_operand_index + operation.left)) {
-            *previously_rendered = current_ref;
-        }
-        else
-            record->lookup_by_operand_index[operation.left] = current_ref;
-    }
-
-    if ((previously_rendered = record->lookup_by_operand_index + operation.right)) {
-        *previously_rendered = current_ref;
-    }
-    else
-        record->lookup_by_operand_index[operation.right] = current_ref;
+    if (!is_unary) redirect_operand(record, operation.left, current_ref);
+    redirect_operand(record, operation.right, current_ref);
 }
 
 #define RETURN_EXPRESSION_RESULT(record)                                                 \
@@ -2860,7 +2955,7 @@ render_expression(Compiler* compiler, StorageHint hint, Expression* expr)
 
     for (size_t i = 0; i < expr->operations_count; i++) {
         Operation operation = expr->operations[i];
-        compiler->current_operation_location = *operation.loc;
+        compiler->current_operation_location = operation.loc;
 
         StorageHint current_hint = NULL_HINT;
         if (i == expr->operations_count - 1) current_hint = hint;
@@ -2921,12 +3016,12 @@ render_expression(Compiler* compiler, StorageHint hint, Expression* expr)
                         if (next_operation.op_type != OPERATOR_CALL) {
                             syntax_error(
                                 compiler->file_index,
-                                *next_operation.loc,
+                                next_operation.loc,
                                 0,
                                 "expecting function call"
                             );
                         }
-                        compiler->current_operation_location = *next_operation.loc;
+                        compiler->current_operation_location = next_operation.loc;
 
                         StorageIdent result = render_list_builtin(
                             compiler,
@@ -2953,12 +3048,12 @@ render_expression(Compiler* compiler, StorageHint hint, Expression* expr)
                         if (next_operation.op_type != OPERATOR_CALL) {
                             syntax_error(
                                 compiler->file_index,
-                                *next_operation.loc,
+                                next_operation.loc,
                                 0,
                                 "expecting function call"
                             );
                         }
-                        compiler->current_operation_location = *next_operation.loc;
+                        compiler->current_operation_location = next_operation.loc;
 
                         StorageIdent result = render_dict_builtin(
                             compiler,
@@ -2971,7 +3066,38 @@ render_expression(Compiler* compiler, StorageHint hint, Expression* expr)
                         update_expression_record(&record, result, next_operation);
                         continue;
                     }
-                    case NPTYPE_OBJECT:
+                    case NPTYPE_OBJECT: {
+                        // `object.method(...)` calls the method directly instead of
+                        // first creating a bound function object
+                        FunctionStatement* method = NULL;
+                        if (i + 1 < expr->operations_count &&
+                            expr->operations[i + 1].op_type == OPERATOR_CALL &&
+                            expr->operations[i + 1].left == operation.right) {
+                            Symbol* sym = symbol_hm_get(
+                                &left.info.cls->scope->hm,
+                                expr->operands[operation.right].token.value
+                            );
+                            if (sym && sym->kind == SYM_FUNCTION &&
+                                is_direct_callable(sym->func))
+                                method = sym->func;
+                        }
+                        if (method) {
+                            if (++i == expr->operations_count - 1) current_hint = hint;
+                            Operation next_operation = expr->operations[i];
+                            compiler->current_operation_location = next_operation.loc;
+
+                            StorageIdent result = render_object_method_call(
+                                compiler,
+                                current_hint,
+                                left,
+                                method,
+                                expr->operands[next_operation.right].args
+                            );
+                            update_expression_record(&record, result, operation);
+                            update_expression_record(&record, result, next_operation);
+                            continue;
+                        }
+
                         update_expression_record(
                             &record,
                             render_get_attr_operation(
@@ -2983,6 +3109,7 @@ render_expression(Compiler* compiler, StorageHint hint, Expression* expr)
                             operation
                         );
                         continue;
+                    }
                     default:
                         UNIMPLEMENTED(
                             "getattr only currently implemented on lists "
@@ -3027,27 +3154,53 @@ render_expression(Compiler* compiler, StorageHint hint, Expression* expr)
 }
 
 static void
-iterate_scopes_and_update_closure_variables(size_t* closure_size, LexicalScope* scope)
+iterate_scopes_and_update_closure_variables(
+    ClosureInst* closure, LexicalScope* scope, bool assign
+)
 {
     for (size_t i = 0; i < scope->hm.elements_count; i++) {
         Symbol* sym = scope->hm.elements + i;
         if (sym->kind == SYM_VARIABLE && (sym->variable->kind == VAR_CLOSURE ||
                                           sym->variable->kind == VAR_CLOSURE_ARGUMENT)) {
-            sym->variable->closure_offset = *closure_size;
-            *closure_size += type_info_sizeof(sym->variable->type_info);
+            if (assign) {
+                sym->variable->closure_index = closure->variables_count;
+                sym->variable->closure_type = closure->type_name;
+                closure->variables[closure->variables_count] = sym->variable;
+            }
+            closure->variables_count += 1;
         }
         else if (sym->kind == SYM_FUNCTION)
-            iterate_scopes_and_update_closure_variables(closure_size, sym->func->scope);
+            iterate_scopes_and_update_closure_variables(
+                closure, sym->func->scope, assign
+            );
     }
 }
 
+static void
+layout_closure(Compiler* compiler, ClosureInst* closure, LexicalScope* scope)
+{
+    iterate_scopes_and_update_closure_variables(closure, scope, false);
+    closure->variables =
+        arena_alloc(compiler->arena, sizeof(Variable*) * closure->variables_count);
+    closure->variables_count = 0;
+    iterate_scopes_and_update_closure_variables(closure, scope, true);
+}
+
 static void
 compile_function(Compiler* compiler, FunctionStatement* func)
 {
     Symbol* function_symbol = get_symbol(compiler, func->name);
     scope_stack_push(&compiler->scope_stack, func->scope);
 
-    const char* internal_function_name = UNIQUE_ID(compiler);
+    const char* internal_function_name = function_compiled_name(compiler, func);
+    const char* addr_function_name = internal_function_name;
+    if (!FUNCTION_USES_CONTEXT(func))
+        addr_function_name = arena_snprintf(
+            compiler->arena,
+            strlen(internal_function_name) + 6,
+            "%s_addr",
+            internal_function_name
+        );
     const char* np_function_name =
         (func->decorator) ? UNIQUE_ID(compiler) : func->ns_ident.data;
 
@@ -3059,20 +3212,24 @@ compile_function(Compiler* compiler, FunctionStatement* func)
     Instruction fndef_inst = {
         .kind = INST_DEFINE_FUNCTION,
         .define_function.function_name = internal_function_name,
+        .define_function.fndef = func,
+        .define_function.adapter_name =
+            (FUNCTION_USES_CONTEXT(func)) ? NULL : addr_function_name,
         .define_function.signature = func->sig,
         .define_function.var_ident = fn_variable,
     };
-    size_t* closure_size;
+    ClosureInst* outer_closure = compiler->closure;
 
     COMPILER_ACCUMULATE_INSTRUCTIONS(compiler, fndef_inst.define_function.body)
     {
         if (func->scope->kind == SCOPE_CLOSURE_PARENT) {
-            closure_size = arena_alloc(compiler->arena, sizeof(size_t));
+            compiler->closure = arena_alloc(compiler->arena, sizeof(ClosureInst));
+            compiler->closure->type_name = UNIQUE_ID(compiler);
             add_instruction(
                 compiler,
                 (Instruction){
                     .kind = INST_INIT_CLOSURE,
-                    .closure_size = closure_size,
+                    .closure = compiler->closure,
                 }
             );
         }
@@ -3088,9 +3245,7 @@ compile_function(Compiler* compiler, FunctionStatement* func)
                 compiler,
                 (Instruction){
                     .kind = INST_RETURN,
-                    .return_.rtval = compiler->none_ident,
-                    .return_.should_free_closure =
-                        func->scope->kind == SCOPE_CLOSURE_PARENT}
+                    .return_.rtval = compiler->none_ident}
             );
     }
 
@@ -3112,7 +3267,7 @@ compile_function(Compiler* compiler, FunctionStatement* func)
                     .object = fn_variable,
                     .attr = SOURCESTRING("__addr__"),
                     .value = (StorageIdent
-                    ){.kind = IDENT_CSTR, .cstr = internal_function_name},
+                    ){.kind = IDENT_CSTR, .cstr = addr_function_name},
                 },
         }
     );
@@ -3149,9 +3304,14 @@ compile_function(Compiler* compiler, FunctionStatement* func)
                     }}
         );
 
-    if (func->scope->kind == SCOPE_CLOSURE_PARENT)
-        // now that all types have been resolved we can assign closure offsets
-        iterate_scopes_and_update_closure_variables(closure_size, func->scope);
+    if (func->scope->kind == SCOPE_CLOSURE_PARENT) {
+        // now that all types have been resolved we can lay out the closure
+        layout_closure(compiler, compiler->closure, func->scope);
+        compiler->closure = outer_closure;
+    }
+    else if (func->scope->kind == SCOPE_CLOSURE_CHILD && func->decorator)
+        // the decorator is free to hold on to the function object
+        compiler->closure->escapes = true;
 
     if (func->decorator) {
         StorageIdent decorator_ident =
@@ -3332,19 +3492,14 @@ compile_object_op_assignment(
     StorageIdent* argv = arena_alloc(compiler->arena, sizeof(StorageIdent) * 1);
     argv[0] = other_ident;
 
-    StorageIdent fn_ident = render_function_object_copy(compiler, NULL_HINT, fndef);
-    bind_self_to_function_object(compiler, obj_ident, fn_ident);
     add_instruction(
         compiler,
         (Instruction){
             .kind = INST_ASSIGNMENT,
             .assignment.left = obj_ident,
             .assignment.right =
-                (OperationInst){
-                    .kind = OPERATION_FUNCTION_CALL,
-                    .function = fn_ident,
-                    .args = argv,
-                }}
+                render_method_call_operation(compiler, obj_ident, fndef, argv),
+        }
     );
 }
 
@@ -3658,9 +3813,6 @@ compile_return_statement(Compiler* compiler, Expression* value)
                               value
                           )
                         : compiler->none_ident,
-            .return_.should_free_closure =
-                scope->kind == SCOPE_CLOSURE_PARENT &&
-                scope->func->sig.return_type.type != NPTYPE_FUNCTION,
         }
     );
 }
@@ -4237,18 +4389,6 @@ compile_check_exceptions(Compiler* compiler)
                     );
                     break;
                 case SCOPE_CLOSURE_PARENT:
-                    add_instruction(
-                        compiler,
-                        (Instruction){
-                            .kind = INST_RETURN,
-                            .return_.rtval = default_return_val_for_type(
-                                compiler, scope->func->sig.return_type
-                            ),
-                            .return_.should_free_closure =
-                                scope->func->sig.return_type.type != NPTYPE_FUNCTION,
-                        }
-                    );
-                    break;
                 case SCOPE_CLOSURE_CHILD:
                     add_instruction(
                         compiler,
@@ -4575,21 +4715,55 @@ compile_assert(Compiler* compiler, AssertStatement* assert_)
     add_instruction(compiler, if_inst);
 }
 
+static void
+compile_import(Compiler* compiler, ImportStatement* import)
+{
+    // only the top level statements of a module are linked
+    if (!import->module_init)
+        unspecified_error(
+            compiler->file_index,
+            compiler->current_stmt_location,
+            "imports are only implemented at the top level of a module"
+        );
+
+    ImportModuleInst inst = {
+        .init_function = import->module_init,
+        .functions = arena_alloc(
+            compiler->arena, sizeof(FunctionStatement*) * import->symbols_count
+        ),
+        .variables =
+            arena_alloc(compiler->arena, sizeof(Variable*) * import->symbols_count),
+    };
+    for (size_t i = 0; i < import->symbols_count; i++) {
+        Symbol sym = import->symbols[i];
+        if (sym.kind == SYM_FUNCTION)
+            inst.functions[inst.functions_count++] = sym.func;
+        else
+            inst.variables[inst.variables_count++] = sym.globalvar;
+    }
+    add_instruction(
+        compiler, (Instruction){.kind = INST_IMPORT_MODULE, .import_module = inst}
+    );
+}
+
 static void
 compile_statement(Compiler* compiler, Statement* stmt)
 {
     compiler->current_stmt_location = stmt->loc;
     compiler->current_operation_location = stmt->loc;
+    Location outer_location = compiler->instruction_location;
+    compiler->instruction_location = stmt->loc;
 
     switch (stmt->kind) {
         case STMT_ASSERT:
-            compile_assert(compiler, stmt->assert_);
+            if (!compiler->opts.strip_asserts) compile_assert(compiler, stmt->assert_);
             break;
         case STMT_FOR_LOOP:
             compile_for_loop(compiler, stmt->for_loop);
             break;
         case STMT_IMPORT:
-            UNIMPLEMENTED("import compilation is unimplemented");
+            compile_import(compiler, stmt->import);
+            break;
         case STMT_WHILE:
             compile_while(compiler, stmt->while_loop);
             break;
@@ -4639,6 +4813,7 @@ compile_statement(Compiler* compiler, Statement* stmt)
         default:
             UNREACHABLE();
     }
+    compiler->instruction_location = outer_location;
 }
 
 static void
@@ -4702,7 +4877,7 @@ str_hm_grow(StringHashmap* hm)
     str_hm_rehash(hm);
 }
 
-static size_t
+size_t
 str_hm_put(StringHashmap* hm, SourceString element)
 {
     if (hm->count == hm->capacity) str_hm_grow(hm);
@@ -108,6 +108,17 @@ typedef struct {
     Instruction* instructions;
 } InstructionSequence;
 
+InstructionSequence instruction_sequence_init(Arena* arena);
+void instruction_sequence_append(InstructionSequence* sequence, Instruction inst);
+void instruction_sequence_finalize(InstructionSequence* sequence);
+
+#define NESTED_SEQUENCES_MAX 4
+
+// stores pointers to the sequences nested within `inst` and returns how many there are
+size_t nested_sequences(Instruction* inst, InstructionSequence* out[NESTED_SEQUENCES_MAX]);
+// the check on `global_exception` inserted by the compiler after unsafe instructions
+bool is_exception_check(Instruction inst);
+
 typedef struct {
     enum {
         IDENT_CSTR,
@@ -159,6 +170,8 @@ typedef struct {
         struct {
             StorageIdent function;
             StorageIdent* args;
+            // bound to the NpContext when `function` is a method called directly
+            StorageIdent self;
         };
         // C CALL
         struct {
@@ -208,8 +221,17 @@ typedef struct {
     InstructionSequence after;
 } LoopInst;
 
+// functions that don't own or share a closure and aren't methods never read their
+// NpContext, so they are compiled without one
+#define FUNCTION_USES_CONTEXT(fndef)                                                     \
+    ((fndef)->is_method || (fndef)->scope->kind != SCOPE_FUNCTION)
+
 typedef struct {
     const char* function_name;
+    // set when the function is compiled without an NpContext, names the function
+    // with the NpContext param that forwards calls made through `__addr__`
+    const char* adapter_name;
+    FunctionStatement* fndef;
     StorageIdent var_ident;
     Signature signature;
     InstructionSequence body;
@@ -229,9 +251,28 @@ typedef struct {
 
 typedef struct {
     StorageIdent rtval;
-    bool should_free_closure;
 } ReturnInst;
 
+// runs an imported module and declares the symbols taken from it
+typedef struct {
+    // the module's init function, it only runs the module the first time it's called
+    const char* init_function;
+    size_t functions_count;
+    FunctionStatement** functions;
+    size_t variables_count;
+    Variable** variables;
+} ImportModuleInst;
+
+typedef struct {
+    // name of the C struct typedef holding the closure variables
+    const char* type_name;
+    size_t variables_count;
+    Variable** variables;
+    // set when a closure child may be referenced after the parent function returns
+    // in which case the closure is allocated on the heap rather than the stack
+    bool escapes;
+} ClosureInst;
+
 struct Instruction {
     enum {
         INST_NO_OP,
@@ -251,6 +292,7 @@ struct Instruction {
         INST_RETURN,
         INST_ITER_NEXT,
         INST_INIT_CLOSURE,
+        INST_IMPORT_MODULE,
     } kind;
     union {
         AssignmentInst assignment;
@@ -264,8 +306,12 @@ struct Instruction {
         const char* label;
         ReturnInst return_;
         IterNextInst iter_next;
-        size_t* closure_size;
+        ClosureInst* closure;
+        ImportModuleInst import_module;
     };
+    // the statement the instruction was compiled from, unset for those the optimizer
+    // makes up
+    Location loc;
 };
 
 #define UNSAFE_INST(inst)                                                                \
@@ -293,6 +339,7 @@ typedef struct {
     int* lookup;
 } StringHashmap;
 
+size_t str_hm_put(StringHashmap* hm, SourceString element);
 void str_hm_free(StringHashmap* hm);
 
 typedef struct {
@@ -303,8 +350,20 @@ typedef struct {
     StringHashmap str_constants;
     InstructionSequence seq;
     Requirements req;
+    // set for modules imported by another, names the init function exported in place
+    // of `main`
+    const char* module_init;
+    // prefixed to generated C names so the modules of a program can't collide
+    const char* id_namespace;
 } CompiledInstructions;
 
-CompiledInstructions compile(Lexer* lexer);
+typedef struct {
+    // assert statements are left out of the program like `python -O`
+    bool strip_asserts;
+    // compile a module imported by another rather than the program's entry module
+    const char* module_init;
+} CompilerOptions;
+
+CompiledInstructions compile(Lexer* lexer, CompilerOptions opts);
 
 #endif
@@ -0,0 +1,435 @@
+#include "constant_folder.h"
+
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "optimizer_helpers.h"
+
+// repeating a string at compile time is only worth it while the result stays small
+#define FOLDED_STRING_MAX 1024
+
+#define IS_UNARY_OPERATOR(op)                                                            \
+    ((op) == OPERATOR_LOGICAL_NOT || (op) == OPERATOR_NEGATIVE ||                        \
+     (op) == OPERATOR_BITWISE_NOT)
+
+typedef struct {
+    Arena* arena;
+    StringHashmap* strings;
+    BindingTable bindings;
+    // bindings currently holding a constant
+    ScopedFlags constants;
+} Folder;
+
+static void
+substitute_operand(void* ctx, StorageIdent* ident, OperandRole role)
+{
+    Folder* folder = ctx;
+    if (role != OPERAND_READ || ident->reference) return;
+    Binding* binding = get_binding(&folder->bindings, *ident, false);
+    if (!binding || !binding->is_known) return;
+
+    TypeInfo info = ident->info;
+    *ident = binding->value;
+    ident->info = info;
+}
+
+static bool
+int_literal(int64_t value, StorageIdent* out)
+{
+    // int literals are written as C ints
+    if (value < INT_MIN || value > INT_MAX) return false;
+    *out = (StorageIdent){
+        .kind = IDENT_INT_LITERAL,
+        .int_value = (int)value,
+        .info = INT_TYPE,
+    };
+    return true;
+}
+
+// float literals are written with "%f" so this is the value the C compiler sees
+static double
+float_literal_value(float value)
+{
+    char buffer[128];
+    snprintf(buffer, sizeof(buffer), "%f", value);
+    return strtod(buffer, NULL);
+}
+
+static bool
+float_literal(double value, StorageIdent* out)
+{
+    // only fold when the literal that gets written reproduces the runtime result
+    if (!isfinite(value) || float_literal_value((float)value) != value) return false;
+    *out = (StorageIdent){
+        .kind = IDENT_FLOAT_LITERAL,
+        .float_value = (float)value,
+        .info = FLOAT_TYPE,
+    };
+    return true;
+}
+
+static bool
+truncated_int_literal(double value, StorageIdent* out)
+{
+    if (!(value > (double)INT_MIN - 1 && value < (double)INT_MAX + 1)) return false;
+    return int_literal((int64_t)value, out);
+}
+
+static bool
+fold_int_operation(Operator op, int64_t left, int64_t right, StorageIdent* out)
+{
+    // mirrors the C emitted by the writer for `NpInt` operands
+    switch (op) {
+        case OPERATOR_PLUS:
+            return int_literal(left + right, out);
+        case OPERATOR_MINUS:
+            return int_literal(left - right, out);
+        case OPERATOR_MULT:
+            return int_literal(left * right, out);
+        case OPERATOR_DIV:
+            if (right == 0) return false;
+            return float_literal((double)left / (double)right, out);
+        case OPERATOR_FLOORDIV:
+            if (right == 0) return false;
+            return truncated_int_literal((double)left / (double)right, out);
+        case OPERATOR_MOD:
+            if (right == 0) return false;
+            return int_literal(left % right, out);
+        case OPERATOR_EQUAL:
+            return int_literal(left == right, out);
+        case OPERATOR_IS:
+            return int_literal(left == right, out);
+        case OPERATOR_NOT_EQUAL:
+            return int_literal(left != right, out);
+        case OPERATOR_GREATER:
+            return int_literal(left > right, out);
+        case OPERATOR_LESS:
+            return int_literal(left < right, out);
+        case OPERATOR_GREATER_EQUAL:
+            return int_literal(left >= right, out);
+        case OPERATOR_LESS_EQUAL:
+            return int_literal(left <= right, out);
+        case OPERATOR_BITWISE_AND:
+            return int_literal(left & right, out);
+        case OPERATOR_BITWISE_OR:
+            return int_literal(left | right, out);
+        case OPERATOR_BITWISE_XOR:
+            return int_literal(left ^ right, out);
+        case OPERATOR_LSHIFT:
+            if (left < 0 || right < 0 || right > 62 || left > (INT64_MAX >> right))
+                return false;
+            return int_literal(left << right, out);
+        case OPERATOR_RSHIFT:
+            if (left < 0 || right < 0 || right > 63) return false;
+            return int_literal(left >> right, out);
+        case OPERATOR_LOGICAL_AND:
+            return int_literal(left && right, out);
+        case OPERATOR_LOGICAL_OR:
+            return int_literal(left || right, out);
+        default:
+            return false;
+    }
+}
+
+static bool
+fold_float_operation(Operator op, double left, double right, StorageIdent* out)
+{
+    switch (op) {
+        case OPERATOR_PLUS:
+            return float_literal(left + right, out);
+        case OPERATOR_MINUS:
+            return float_literal(left - right, out);
+        case OPERATOR_MULT:
+            return float_literal(left * right, out);
+        case OPERATOR_DIV:
+            if (right == 0) return false;
+            return float_literal(left / right, out);
+        case OPERATOR_FLOORDIV:
+            if (right == 0) return false;
+            return truncated_int_literal(left / right, out);
+        case OPERATOR_EQUAL:
+            return int_literal(left == right, out);
+        case OPERATOR_NOT_EQUAL:
+            return int_literal(left != right, out);
+        case OPERATOR_GREATER:
+            return int_literal(left > right, out);
+        case OPERATOR_LESS:
+            return int_literal(left < right, out);
+        case OPERATOR_GREATER_EQUAL:
+            return int_literal(left >= right, out);
+        case OPERATOR_LESS_EQUAL:
+            return int_literal(left <= right, out);
+        default:
+            return false;
+    }
+}
+
+static bool
+number_value(StorageIdent ident, double* out)
+{
+    if (ident.kind == IDENT_INT_LITERAL)
+        *out = ident.int_value;
+    else if (ident.kind == IDENT_FLOAT_LITERAL)
+        *out = float_literal_value(ident.float_value);
+    else
+        return false;
+    return true;
+}
+
+static bool
+fold_intrinsic(Operator op, StorageIdent left, StorageIdent right, StorageIdent* out)
+{
+    double left_value;
+    double right_value;
+
+    switch (op) {
+        case OPERATOR_LOGICAL_NOT:
+            if (right.kind != IDENT_INT_LITERAL) return false;
+            return int_literal(!right.int_value, out);
+        case OPERATOR_BITWISE_NOT:
+            if (right.kind != IDENT_INT_LITERAL) return false;
+            return int_literal(~(int64_t)right.int_value, out);
+        case OPERATOR_NEGATIVE:
+            if (right.kind == IDENT_INT_LITERAL)
+                return int_literal(-(int64_t)right.int_value, out);
+            if (right.kind == IDENT_FLOAT_LITERAL)
+                return float_literal(-float_literal_value(right.float_value), out);
+            return false;
+        default:
+            break;
+    }
+
+    if (left.kind == IDENT_INT_LITERAL && right.kind == IDENT_INT_LITERAL)
+        return fold_int_operation(op, left.int_value, right.int_value, out);
+    if (number_value(left, &left_value) && number_value(right, &right_value))
+        return fold_float_operation(op, left_value, right_value, out);
+    return false;
+}
+
+static bool
+string_value(Folder* folder, StorageIdent ident, SourceString* out)
+{
+    if (ident.kind != IDENT_STRING_LITERAL) return false;
+    *out = folder->strings->elements[ident.str_literal_index];
+    // the table holds the source text, escape sequences would have to be re-parsed
+    return !memchr(out->data, '\\', out->length);
+}
+
+static bool
+string_literal(Folder* folder, const char* data, size_t length, StorageIdent* out)
+{
+    SourceString str = {.data = data, .length = length};
+    *out = (StorageIdent){
+        .kind = IDENT_STRING_LITERAL,
+        .str_literal_index = str_hm_put(folder->strings, str),
+        .info = STRING_TYPE,
+    };
+    return true;
+}
+
+static bool
+fold_c_call(
+    Folder* folder, NpLibFunctionData function_data, StorageIdent* args, StorageIdent* out
+)
+{
+    SourceString left;
+    SourceString right;
+
+    if (IS_LIB_FUNCTION(function_data, NPLIB_STR_ADD)) {
+        if (!string_value(folder, args[0], &left) ||
+            !string_value(folder, args[1], &right))
+            return false;
+        char* data = arena_alloc(folder->arena, left.length + right.length + 1);
+        memcpy(data, left.data, left.length);
+        memcpy(data + left.length, right.data, right.length);
+        return string_literal(folder, data, left.length + right.length, out);
+    }
+    if (IS_LIB_FUNCTION(function_data, NPLIB_STR_MUL)) {
+        if (!string_value(folder, args[0], &left) || args[1].kind != IDENT_INT_LITERAL)
+            return false;
+        int n = args[1].int_value;
+        if (n < 0 || left.length * n > FOLDED_STRING_MAX) return false;
+        char* data = arena_alloc(folder->arena, left.length * n + 1);
+        for (int i = 0; i < n; i++)
+            memcpy(data + left.length * i, left.data, left.length);
+        return string_literal(folder, data, left.length * n, out);
+    }
+    if (IS_LIB_FUNCTION(function_data, NPLIB_STR_EQ)) {
+        if (!string_value(folder, args[0], &left) ||
+            !string_value(folder, args[1], &right))
+            return false;
+        return int_literal(SOURCESTRING_EQ(left, right), out);
+    }
+    if (IS_LIB_FUNCTION(function_data, NPLIB_INT_TO_STR)) {
+        if (args[0].kind != IDENT_INT_LITERAL) return false;
+        const char* data = arena_snprintf(folder->arena, 16, "%i", args[0].int_value);
+        return string_literal(folder, data, strlen(data), out);
+    }
+    return false;
+}
+
+static bool
+fold_operation(Folder* folder, OperationInst operation, StorageIdent* out)
+{
+    switch (operation.kind) {
+        case OPERATION_COPY:
+            if (!IS_LITERAL(operation.copy)) return false;
+            *out = operation.copy;
+            return true;
+        case OPERATION_INTRINSIC:
+            return fold_intrinsic(operation.op, operation.left, operation.right, out);
+        case OPERATION_C_CALL:
+            return fold_c_call(
+                folder, operation.c_function, operation.c_function_args, out
+            );
+        case OPERATION_C_CALL1:
+            return fold_c_call(
+                folder, operation.c_function, &operation.c_function_arg, out
+            );
+        default:
+            return false;
+    }
+}
+
+static bool
+is_int_literal(StorageIdent ident, int value)
+{
+    return ident.kind == IDENT_INT_LITERAL && ident.int_value == value;
+}
+
+// applies the identities of integer arithmetic with a single literal operand
+static void
+simplify_intrinsic(OperationInst* operation)
+{
+    StorageIdent left = operation->left;
+    StorageIdent right = operation->right;
+    if (left.info.type != NPTYPE_INT || right.info.type != NPTYPE_INT) return;
+
+    switch (operation->op) {
+        case OPERATOR_PLUS:
+            if (is_int_literal(left, 0))
+                *operation = (OperationInst){.kind = OPERATION_COPY, .copy = right};
+            else if (is_int_literal(right, 0))
+                *operation = (OperationInst){.kind = OPERATION_COPY, .copy = left};
+            break;
+        case OPERATOR_MINUS:
+            if (is_int_literal(right, 0))
+                *operation = (OperationInst){.kind = OPERATION_COPY, .copy = left};
+            break;
+        case OPERATOR_MULT:
+            if (is_int_literal(left, 1))
+                *operation = (OperationInst){.kind = OPERATION_COPY, .copy = right};
+            else if (is_int_literal(right, 1))
+                *operation = (OperationInst){.kind = OPERATION_COPY, .copy = left};
+            else if (is_int_literal(left, 0) || is_int_literal(right, 0))
+                *operation = (OperationInst){
+                    .kind = OPERATION_COPY,
+                    .copy = (StorageIdent){.kind = IDENT_INT_LITERAL, .info = INT_TYPE},
+                };
+            break;
+        default:
+            break;
+    }
+}
+
+static bool
+literal_fits_type(StorageIdent literal, TypeInfo info)
+{
+    switch (literal.kind) {
+        case IDENT_INT_LITERAL:
+            return info.type == NPTYPE_INT || info.type == NPTYPE_BOOL;
+        case IDENT_FLOAT_LITERAL:
+            return info.type == NPTYPE_FLOAT;
+        case IDENT_STRING_LITERAL:
+            return info.type == NPTYPE_STRING;
+        default:
+            return false;
+    }
+}
+
+static void
+fold_assignment(Folder* folder, AssignmentInst* assignment)
+{
+    OperationInst original = assignment->right;
+    visit_operation(&assignment->right, substitute_operand, folder);
+
+    StorageIdent value;
+    if (!fold_operation(folder, assignment->right, &value)) {
+        if (original.kind == OPERATION_INTRINSIC) {
+            OperationInst* operation = &assignment->right;
+            // literal operands are C ints where the variables they replaced were
+            // `NpInt`, which matters when nothing else in the expression is an `NpInt`
+            if (IS_UNARY_OPERATOR(operation->op) ||
+                (IS_LITERAL(operation->left) && IS_LITERAL(operation->right)) ||
+                operation->op == OPERATOR_LSHIFT || operation->op == OPERATOR_RSHIFT)
+                *operation = original;
+            else
+                simplify_intrinsic(operation);
+        }
+        return;
+    }
+    assignment->right = (OperationInst){.kind = OPERATION_COPY, .copy = value};
+
+    Binding* binding = get_binding(&folder->bindings, assignment->left, false);
+    if (binding && binding->declared && !binding->external && !binding->escapes &&
+        binding->writes == 1 && literal_fits_type(value, assignment->left.info)) {
+        binding->value = value;
+        scoped_flag_set(&folder->constants, &binding->is_known);
+    }
+}
+
+// constants are only visible to the instructions following their assignment within
+// the same sequence, any other path could reach the variable before it's assigned
+static void
+fold_sequence(Folder* folder, InstructionSequence* seq)
+{
+    size_t scope = folder->constants.count;
+
+    for (size_t i = 0; i < seq->count; i++) {
+        Instruction* inst = seq->instructions + i;
+        switch (inst->kind) {
+            case INST_LABEL:
+                // a jump may arrive from before the constants of this sequence were set
+                scoped_flags_unwind(&folder->constants, scope);
+                break;
+            case INST_ASSIGNMENT:
+            case INST_DECL_ASSIGNMENT: {
+                bool was_unsafe = UNSAFE_INST((*inst));
+                fold_assignment(folder, &inst->assignment);
+                if (was_unsafe && !UNSAFE_INST((*inst)) && i + 1 < seq->count &&
+                    is_exception_check(seq->instructions[i + 1]))
+                    // the call was evaluated at compile time so it can't have raised
+                    seq->instructions[i + 1] = NO_OP;
+                break;
+            }
+            default: {
+                visit_instruction(inst, substitute_operand, folder);
+                InstructionSequence* nested[NESTED_SEQUENCES_MAX];
+                size_t nested_count = nested_sequences(inst, nested);
+                for (size_t j = 0; j < nested_count; j++)
+                    fold_sequence(folder, nested[j]);
+            }
+        }
+    }
+
+    scoped_flags_unwind(&folder->constants, scope);
+}
+
+void
+fold_constants(CompiledInstructions* compiled)
+{
+    Folder folder = {
+        .arena = compiled->seq.arena,
+        .strings = &compiled->str_constants,
+    };
+
+    count_bindings(&folder.bindings, compiled->seq);
+    fold_sequence(&folder, &compiled->seq);
+
+    binding_table_free(&folder.bindings);
+    scoped_flags_free(&folder.constants);
+}
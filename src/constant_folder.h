@@ -0,0 +1,10 @@
+#ifndef CONSTANT_FOLDER_H
+#define CONSTANT_FOLDER_H
+
+#include "compiler.h"
+
+// evaluates operations on literals at compile time and propagates the results through
+// variables that are only ever assigned once
+void fold_constants(CompiledInstructions* compiled);
+
+#endif
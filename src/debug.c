@@ -8,22 +8,25 @@
 #include "lexer.h"
 #include "lexer_helpers.h"
 #include "tokens.h"
+#include "optimizer.h"
 #include "writer.h"
 
-void print_token(Token tok);
+void print_token(FileIndex* index, Token tok);
 void print_token_type(TokenType type);
 void print_operator_enum(Operator op);
 void print_keyword(Keyword kw);
 void print_statement(Statement* stmt, int indent);
 void print_scopes(Lexer* lexer);
+void print_instructions(CompiledInstructions* compiled);
 
 void
 debug_tokens_main(char* filepath)
 {
     size_t count;
-    Token* tokens = tokenize_file(filepath, &count);
+    FileIndex index;
+    Token* tokens = tokenize_file(filepath, &count, &index);
     for (size_t i = 0; i < count; i++) {
-        print_token(tokens[i]);
+        print_token(&index, tokens[i]);
     }
     free(tokens);
 }
@@ -31,7 +34,7 @@ debug_tokens_main(char* filepath)
 void
 debug_scopes_main(char* filepath)
 {
-    Lexer lexer = lex_file(filepath);
+    Lexer lexer = lex_file(filepath, (LexerOptions){0});
     print_scopes(&lexer);
     lexer_free(&lexer);
 }
@@ -39,7 +42,7 @@ debug_scopes_main(char* filepath)
 void
 debug_statements_main(char* filepath)
 {
-    Lexer lexer = lex_file(filepath);
+    Lexer lexer = lex_file(filepath, (LexerOptions){0});
     for (size_t i = 0; i < lexer.n_statements; i++) {
         print_statement(lexer.statements[i], 0);
     }
@@ -49,8 +52,31 @@ debug_statements_main(char* filepath)
 void
 debug_compiler_main(char* filepath)
 {
-    Lexer lexer = lex_file(filepath);
-    write_c_program(compile(&lexer), stdout);
+    Lexer lexer = lex_file(filepath, (LexerOptions){0});
+    write_c_program(
+        compile(&lexer, (CompilerOptions){0}), stdout, (WriterOptions){0}
+    );
+    lexer_free(&lexer);
+}
+
+static void
+print_pass_instructions(const char* pass_name, CompiledInstructions* compiled)
+{
+    printf("\n;; after %s\n", pass_name);
+    print_instructions(compiled);
+}
+
+void
+debug_ir_main(char* filepath, OptimizerOptions opts)
+{
+    Lexer lexer = lex_file(filepath, (LexerOptions){0});
+    CompiledInstructions compiled = compile(&lexer, (CompilerOptions){0});
+    printf(";; compiled\n");
+    print_instructions(&compiled);
+    // shows every pass whatever the -O level
+    opts.enabled = true;
+    opts.after_pass = print_pass_instructions;
+    optimize(&compiled, opts);
     lexer_free(&lexer);
 }
 
@@ -397,6 +423,9 @@ render_type_info(TypeInfo info)
         case NPTYPE_STRING:
             str_concat_cstr(&str, "str");
             break;
+        case NPTYPE_BOOL:
+            str_concat_cstr(&str, "bool");
+            break;
         case NPTYPE_FUNCTION:
             str_concat_cstr(&str, "Function[[");
             for (size_t i = 0; i < info.sig->params_count; i++) {
@@ -618,15 +647,10 @@ print_statement(Statement* stmt, int indent)
 }
 
 void
-print_token(Token tok)
+print_token(FileIndex* index, Token tok)
 {
-    printf(
-        "%s:%u:%u %s",
-        tok.loc->filepath,
-        tok.loc->line,
-        tok.loc->col,
-        token_type_to_cstr(tok.type)
-    );
+    Location loc = file_index_location(index, tok.offset);
+    printf("%s:%u:%u %s", loc.filepath, loc.line, loc.col, token_type_to_cstr(tok.type));
     if (tok.type == TOK_OPERATOR) {
         printf(": %s", op_to_cstr(tok.op));
     }
@@ -682,4 +706,263 @@ print_scopes(Lexer* lexer)
     }
 }
 
+static StringBuffer
+render_storage_ident(CompiledInstructions* compiled, StorageIdent ident)
+{
+    StringBuffer str = {0};
+    char literal[64];
+    if (ident.reference) str_append_char(&str, '&');
+
+    switch (ident.kind) {
+        case IDENT_CSTR:
+            str_concat_cstr(&str, (ident.cstr) ? ident.cstr : "_");
+            break;
+        case IDENT_VAR:
+            str_concat_cstr(&str, ident.var->compiled_name.data);
+            break;
+        case IDENT_FUNCTION:
+            str_concat_cstr(&str, ident.func->name.data);
+            break;
+        case IDENT_STRING_LITERAL: {
+            SourceString value =
+                compiled->str_constants.elements[ident.str_literal_index];
+            snprintf(literal, sizeof(literal), "\"%.*s\"", (int)value.length, value.data);
+            str_concat_cstr(&str, literal);
+            break;
+        }
+        case IDENT_INT_LITERAL:
+            snprintf(literal, sizeof(literal), "%i", ident.int_value);
+            str_concat_cstr(&str, literal);
+            break;
+        case IDENT_FLOAT_LITERAL:
+            snprintf(literal, sizeof(literal), "%f", ident.float_value);
+            str_concat_cstr(&str, literal);
+            break;
+        case IDENT_NPTYPE_ZERO_INIT_LITERAL:
+            str_concat_cstr(&str, "{0}");
+            break;
+    }
+    return str;
+}
+
+static void
+concat_storage_ident(
+    StringBuffer* str, CompiledInstructions* compiled, StorageIdent ident
+)
+{
+    StringBuffer rendered = render_storage_ident(compiled, ident);
+    str_concat(str, &rendered);
+}
+
+static StringBuffer
+render_call_args(CompiledInstructions* compiled, StorageIdent* args, size_t count)
+{
+    StringBuffer str = {0};
+    str_append_char(&str, '(');
+    for (size_t i = 0; i < count; i++) {
+        if (i > 0) str_concat_cstr(&str, ", ");
+        concat_storage_ident(&str, compiled, args[i]);
+    }
+    str_append_char(&str, ')');
+    return str;
+}
+
+static StringBuffer
+render_operation(CompiledInstructions* compiled, OperationInst operation)
+{
+    StringBuffer str = {0};
+    switch (operation.kind) {
+        case OPERATION_INTRINSIC:
+            if (operation.left.kind != IDENT_CSTR || operation.left.cstr) {
+                concat_storage_ident(&str, compiled, operation.left);
+                str_append_char(&str, ' ');
+            }
+            str_concat_cstr(&str, op_to_cstr(operation.op));
+            str_append_char(&str, ' ');
+            concat_storage_ident(&str, compiled, operation.right);
+            break;
+        case OPERATION_FUNCTION_CALL:
+            str_concat_cstr(&str, "call ");
+            concat_storage_ident(&str, compiled, operation.function);
+            if (operation.self.kind != IDENT_CSTR || operation.self.cstr) {
+                str_append_char(&str, '[');
+                concat_storage_ident(&str, compiled, operation.self);
+                str_append_char(&str, ']');
+            }
+            str_concat_cstr(
+                &str,
+                render_call_args(
+                    compiled, operation.args, operation.function.info.sig->params_count
+                )
+                    .data
+            );
+            break;
+        case OPERATION_C_CALL:
+            str_concat_cstr(&str, operation.c_function.name);
+            str_concat_cstr(
+                &str,
+                render_call_args(
+                    compiled, operation.c_function_args, operation.c_function.argc
+                )
+                    .data
+            );
+            break;
+        case OPERATION_C_CALL1:
+            str_concat_cstr(&str, operation.c_function.name);
+            str_concat_cstr(
+                &str, render_call_args(compiled, &operation.c_function_arg, 1).data
+            );
+            break;
+        case OPERATION_GET_ATTR:
+            concat_storage_ident(&str, compiled, operation.object);
+            str_append_char(&str, '.');
+            str_concat_cstr(&str, operation.attr.data);
+            break;
+        case OPERATION_SET_ATTR:
+            concat_storage_ident(&str, compiled, operation.object);
+            str_append_char(&str, '.');
+            str_concat_cstr(&str, operation.attr.data);
+            str_concat_cstr(&str, " = ");
+            concat_storage_ident(&str, compiled, operation.value);
+            break;
+        case OPERATION_COPY:
+            concat_storage_ident(&str, compiled, operation.copy);
+            break;
+        case OPERATION_DEREF:
+            str_append_char(&str, '*');
+            concat_storage_ident(&str, compiled, operation.ref);
+            break;
+    }
+    return str;
+}
+
+static void
+print_instruction_sequence(
+    CompiledInstructions* compiled, InstructionSequence seq, int indent
+);
+
+static void
+print_instruction(CompiledInstructions* compiled, Instruction inst, int indent)
+{
+    switch (inst.kind) {
+        case INST_NO_OP:
+            break;
+        case INST_ASSIGNMENT:
+            indent_printf(
+                "%s = %s\n",
+                render_storage_ident(compiled, inst.assignment.left).data,
+                render_operation(compiled, inst.assignment.right).data
+            );
+            break;
+        case INST_OPERATION:
+            indent_printf("%s\n", render_operation(compiled, inst.operation).data);
+            break;
+        case INST_LOOP:
+            indent_printf(
+                "loop %s:\n", render_storage_ident(compiled, inst.loop.condition).data
+            );
+            indent_print("  init:\n");
+            print_instruction_sequence(compiled, inst.loop.init, indent + 4);
+            indent_print("  before:\n");
+            print_instruction_sequence(compiled, inst.loop.before, indent + 4);
+            indent_print("  body:\n");
+            print_instruction_sequence(compiled, inst.loop.body, indent + 4);
+            indent_print("  after:\n");
+            print_instruction_sequence(compiled, inst.loop.after, indent + 4);
+            break;
+        case INST_DECLARE_VARIABLE: {
+            TypeInfo info = (inst.declare_variable.kind == IDENT_VAR)
+                                ? inst.declare_variable.var->type_info
+                                : inst.declare_variable.info;
+            indent_printf(
+                "declare %s: %s\n",
+                render_storage_ident(compiled, inst.declare_variable).data,
+                render_type_info(info).data
+            );
+            break;
+        }
+        case INST_DECL_ASSIGNMENT:
+            indent_printf(
+                "declare %s: %s = %s\n",
+                render_storage_ident(compiled, inst.assignment.left).data,
+                render_type_info(inst.assignment.left.info).data,
+                render_operation(compiled, inst.assignment.right).data
+            );
+            break;
+        case INST_DEFINE_FUNCTION:
+            indent_printf(
+                "def %s %s:\n",
+                inst.define_function.function_name,
+                render_type_info(inst.define_function.var_ident.info).data
+            );
+            print_instruction_sequence(compiled, inst.define_function.body, indent + 4);
+            break;
+        case INST_DEFINE_CLASS:
+            indent_printf("class %s:\n", inst.define_class.class_name);
+            print_instruction_sequence(compiled, inst.define_class.body, indent + 4);
+            break;
+        case INST_IF:
+            indent_printf(
+                "if %s%s:\n",
+                (inst.if_.negate) ? "not " : "",
+                render_storage_ident(compiled, inst.if_.condition_ident).data
+            );
+            print_instruction_sequence(compiled, inst.if_.body, indent + 4);
+            break;
+        case INST_ELSE:
+            indent_print("else:\n");
+            print_instruction_sequence(compiled, inst.else_, indent + 4);
+            break;
+        case INST_GOTO:
+            indent_printf("goto %s\n", inst.label);
+            break;
+        case INST_LABEL:
+            indent_printf("%s:\n", inst.label);
+            break;
+        case INST_BREAK:
+            indent_print("break\n");
+            break;
+        case INST_CONTINUE:
+            indent_print("continue\n");
+            break;
+        case INST_RETURN:
+            indent_printf(
+                "return %s\n", render_storage_ident(compiled, inst.return_.rtval).data
+            );
+            break;
+        case INST_ITER_NEXT:
+            indent_printf(
+                "%s = next %s\n",
+                render_storage_ident(compiled, inst.iter_next.unpack).data,
+                render_storage_ident(compiled, inst.iter_next.iter).data
+            );
+            break;
+        case INST_INIT_CLOSURE:
+            indent_printf(
+                "closure %s%s\n",
+                inst.closure->type_name,
+                (inst.closure->escapes) ? " (escapes)" : ""
+            );
+            break;
+        case INST_IMPORT_MODULE:
+            indent_printf("import %s\n", inst.import_module.init_function);
+            break;
+    }
+}
+
+static void
+print_instruction_sequence(
+    CompiledInstructions* compiled, InstructionSequence seq, int indent
+)
+{
+    for (size_t i = 0; i < seq.count; i++)
+        print_instruction(compiled, seq.instructions[i], indent);
+}
+
+void
+print_instructions(CompiledInstructions* compiled)
+{
+    print_instruction_sequence(compiled, compiled->seq, 0);
+}
+
 #endif
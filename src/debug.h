@@ -1,9 +1,12 @@
 #ifndef DEBUG_H
 #define DEBUG_H
 
+#include "optimizer.h"
+
 void debug_tokens_main(char* filepath);
 void debug_scopes_main(char* filepath);
 void debug_statements_main(char* filepath);
 void debug_compiler_main(char* filepath);
+void debug_ir_main(char* filepath, OptimizerOptions opts);
 
 #endif
@@ -35,6 +35,27 @@ file_index_index_line(FileIndex* index, size_t line_start)
     index->line_offsets[index->line_count++] = line_start;
 }
 
+// lines are indexed as they're scanned so any offset already scanned can be resolved
+Location
+file_index_location(const FileIndex* index, size_t offset)
+{
+    // the last line beginning at or before the offset
+    size_t low = 0;
+    size_t high = index->line_count;
+    while (high - low > 1) {
+        size_t mid = low + (high - low) / 2;
+        if (index->line_offsets[mid] <= offset)
+            low = mid;
+        else
+            high = mid;
+    }
+    return (Location){
+        .filepath = index->filepath,
+        .line = low + 1,
+        .col = offset - index->line_offsets[low] + 1,
+    };
+}
+
 #define LINE_BUFFER_LENGTH 1024
 
 typedef struct {
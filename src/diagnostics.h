@@ -18,6 +18,7 @@ typedef struct {
 
 FileIndex create_file_index(Arena* arena, const char* filepath);
 void file_index_index_line(FileIndex* index, size_t line_start);
+Location file_index_location(const FileIndex* index, size_t offset);
 
 typedef enum {
     LABEL_SYNTAX_ERROR,
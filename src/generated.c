@@ -5,8 +5,18 @@ this code is generated by `scripts/codegen.py` and should not be edited manually
 */
 #include "generated.h"
 
+#include <stdint.h>
 #include <string.h>
 
+static uint32_t
+perfect_hash(const char* str, size_t length, uint32_t seed)
+{
+    uint32_t hash = 2166136261u ^ seed;
+    for (size_t i = 0; i < length; i++)
+        hash = (hash ^ (unsigned char)str[i]) * 16777619u;
+    return hash ^ (hash >> 16);
+}
+
 static const char* kw_hashtable[KEYWORDS_MAX] = {
     [KW_FALSE] = "False",
     [KW_TRUE] = "True",
@@ -42,22 +52,34 @@ static const char* kw_hashtable[KEYWORDS_MAX] = {
     [KW_YIELD] = "yield",
 };
 
-size_t
-kw_hash(char* kw)
-{
-    size_t hash = kw[0] * 3;
-    for (size_t i = 0; kw[i] != '\0'; i++) hash += kw[i];
-    return hash % KEYWORDS_MAX;
-}
+static const uint32_t KW_SEEDS[16] = {
+    1,
+    4,
+    7,
+    1,
+    27,
+    1,
+    12,
+    0,
+    1,
+    0,
+    24,
+    3,
+    79,
+    1,
+    39,
+    2,
+};
 
 Keyword
-is_keyword(char* word)
+is_keyword(const char* str, size_t length)
 {
-    if (!word) return NOT_A_KEYWORD;
-    size_t hash = kw_hash(word);
-    const char* kw = kw_hashtable[hash];
-    if (!kw) return NOT_A_KEYWORD;
-    if (strcmp(word, kw_hashtable[hash]) == 0) return hash;
+    if (length == 0 || length > KEYWORD_LENGTH_MAX) return NOT_A_KEYWORD;
+    uint32_t seed = KW_SEEDS[perfect_hash(str, length, 0) % 16];
+    Keyword value = perfect_hash(str, length, seed) % 32 + 1;
+    const char* candidate = kw_hashtable[value];
+    if (strncmp(str, candidate, length) == 0 && candidate[length] == '\0')
+        return value;
     return NOT_A_KEYWORD;
 }
 
@@ -175,12 +197,40 @@ static const char* OP_TO_CSTR_TABLE[OPERATORS_MAX] = {
     [OPERATOR_BITWISE_NOT] = "~",
 };
 
+static const uint32_t OP_SEEDS[21] = {
+    1,
+    5,
+    5,
+    10,
+    1,
+    9,
+    1,
+    11,
+    6,
+    1,
+    0,
+    1,
+    4,
+    30,
+    27,
+    2,
+    5,
+    2,
+    7,
+    2,
+    49,
+};
+
 Operator
-op_from_cstr(char* op)
+op_from_cstr(const char* str, size_t length)
 {
-    size_t hash = op[0];
-    for (size_t i = 0; op[i] != '\0'; i++) hash += op[i];
-    return (Operator)hash % OPERATORS_MAX;
+    if (length == 0) return NOT_AN_OPERATOR;
+    uint32_t seed = OP_SEEDS[perfect_hash(str, length, 0) % 21];
+    Operator value = perfect_hash(str, length, seed) % 43 + 1;
+    const char* candidate = OP_TO_CSTR_TABLE[value];
+    if (strncmp(str, candidate, length) == 0 && candidate[length] == '\0')
+        return value;
+    return NOT_AN_OPERATOR;
 }
 
 const char*
@@ -188,3 +238,188 @@ op_to_cstr(Operator op)
 {
     return OP_TO_CSTR_TABLE[op];
 }
+
+const unsigned char CHAR_CLASS_TABLE[256] = {
+    [' '] = CHAR_BLANK,
+    ['\t'] = CHAR_BLANK,
+    ['\n'] = CHAR_NEWLINE,
+    ['#'] = CHAR_COMMENT,
+    ['_'] = CHAR_ALPHA,
+    ['A'] = CHAR_ALPHA,
+    ['B'] = CHAR_ALPHA,
+    ['C'] = CHAR_ALPHA,
+    ['D'] = CHAR_ALPHA,
+    ['E'] = CHAR_ALPHA,
+    ['F'] = CHAR_ALPHA,
+    ['G'] = CHAR_ALPHA,
+    ['H'] = CHAR_ALPHA,
+    ['I'] = CHAR_ALPHA,
+    ['J'] = CHAR_ALPHA,
+    ['K'] = CHAR_ALPHA,
+    ['L'] = CHAR_ALPHA,
+    ['M'] = CHAR_ALPHA,
+    ['N'] = CHAR_ALPHA,
+    ['O'] = CHAR_ALPHA,
+    ['P'] = CHAR_ALPHA,
+    ['Q'] = CHAR_ALPHA,
+    ['R'] = CHAR_ALPHA,
+    ['S'] = CHAR_ALPHA,
+    ['T'] = CHAR_ALPHA,
+    ['U'] = CHAR_ALPHA,
+    ['V'] = CHAR_ALPHA,
+    ['W'] = CHAR_ALPHA,
+    ['X'] = CHAR_ALPHA,
+    ['Y'] = CHAR_ALPHA,
+    ['Z'] = CHAR_ALPHA,
+    ['a'] = CHAR_ALPHA,
+    ['b'] = CHAR_ALPHA,
+    ['c'] = CHAR_ALPHA,
+    ['d'] = CHAR_ALPHA,
+    ['e'] = CHAR_ALPHA,
+    ['f'] = CHAR_ALPHA,
+    ['g'] = CHAR_ALPHA,
+    ['h'] = CHAR_ALPHA,
+    ['i'] = CHAR_ALPHA,
+    ['j'] = CHAR_ALPHA,
+    ['k'] = CHAR_ALPHA,
+    ['l'] = CHAR_ALPHA,
+    ['m'] = CHAR_ALPHA,
+    ['n'] = CHAR_ALPHA,
+    ['o'] = CHAR_ALPHA,
+    ['p'] = CHAR_ALPHA,
+    ['q'] = CHAR_ALPHA,
+    ['r'] = CHAR_ALPHA,
+    ['s'] = CHAR_ALPHA,
+    ['t'] = CHAR_ALPHA,
+    ['u'] = CHAR_ALPHA,
+    ['v'] = CHAR_ALPHA,
+    ['w'] = CHAR_ALPHA,
+    ['x'] = CHAR_ALPHA,
+    ['y'] = CHAR_ALPHA,
+    ['z'] = CHAR_ALPHA,
+    ['0'] = CHAR_DIGIT,
+    ['1'] = CHAR_DIGIT,
+    ['2'] = CHAR_DIGIT,
+    ['3'] = CHAR_DIGIT,
+    ['4'] = CHAR_DIGIT,
+    ['5'] = CHAR_DIGIT,
+    ['6'] = CHAR_DIGIT,
+    ['7'] = CHAR_DIGIT,
+    ['8'] = CHAR_DIGIT,
+    ['9'] = CHAR_DIGIT,
+    ['.'] = CHAR_DOT,
+    ['\''] = CHAR_QUOTE,
+    ['"'] = CHAR_QUOTE,
+    ['@'] = CHAR_PUNCTUATION,
+    [','] = CHAR_PUNCTUATION,
+    [':'] = CHAR_PUNCTUATION,
+    ['('] = CHAR_PUNCTUATION,
+    [')'] = CHAR_PUNCTUATION,
+    ['['] = CHAR_PUNCTUATION,
+    [']'] = CHAR_PUNCTUATION,
+    ['{'] = CHAR_PUNCTUATION,
+    ['}'] = CHAR_PUNCTUATION,
+    ['!'] = CHAR_OPERATOR,
+    ['%'] = CHAR_OPERATOR,
+    ['&'] = CHAR_OPERATOR,
+    ['*'] = CHAR_OPERATOR,
+    ['+'] = CHAR_OPERATOR,
+    ['-'] = CHAR_OPERATOR,
+    ['/'] = CHAR_OPERATOR,
+    ['<'] = CHAR_OPERATOR,
+    ['='] = CHAR_OPERATOR,
+    ['>'] = CHAR_OPERATOR,
+    ['^'] = CHAR_OPERATOR,
+    ['|'] = CHAR_OPERATOR,
+    ['~'] = CHAR_OPERATOR,
+};
+
+const unsigned char OPERATOR_CHAR_INDEX[256] = {
+    ['!'] = 1,
+    ['%'] = 2,
+    ['&'] = 3,
+    ['*'] = 4,
+    ['+'] = 5,
+    ['-'] = 6,
+    ['/'] = 7,
+    ['<'] = 8,
+    ['='] = 9,
+    ['>'] = 10,
+    ['^'] = 11,
+    ['|'] = 12,
+    ['~'] = 13,
+};
+
+const unsigned char OPERATOR_DFA[OPERATOR_STATES][OPERATOR_COLUMNS] = {
+    {0, 29, 5, 16, 3, 1, 2, 4, 25, 8, 22, 20, 18, 33},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 9, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 10, 0, 0, 0, 0},
+    {0, 0, 0, 0, 6, 0, 0, 0, 0, 11, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 7, 0, 12, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 13, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 15, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 14, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 28, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 17, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 19, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 21, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 31, 23, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 24, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 26, 32, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 27, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 30, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+};
+
+const Operator OPERATOR_ACCEPTS[OPERATOR_STATES] = {
+    NOT_AN_OPERATOR,
+    OPERATOR_PLUS,
+    OPERATOR_MINUS,
+    OPERATOR_MULT,
+    OPERATOR_DIV,
+    OPERATOR_MOD,
+    OPERATOR_POW,
+    OPERATOR_FLOORDIV,
+    OPERATOR_ASSIGNMENT,
+    OPERATOR_PLUS_ASSIGNMENT,
+    OPERATOR_MINUS_ASSIGNMENT,
+    OPERATOR_MULT_ASSIGNMENT,
+    OPERATOR_DIV_ASSIGNMENT,
+    OPERATOR_MOD_ASSIGNMENT,
+    OPERATOR_FLOORDIV_ASSIGNMENT,
+    OPERATOR_POW_ASSIGNMENT,
+    OPERATOR_BITWISE_AND,
+    OPERATOR_AND_ASSIGNMENT,
+    OPERATOR_BITWISE_OR,
+    OPERATOR_OR_ASSIGNMENT,
+    OPERATOR_BITWISE_XOR,
+    OPERATOR_XOR_ASSIGNMENT,
+    OPERATOR_GREATER,
+    OPERATOR_RSHIFT,
+    OPERATOR_RSHIFT_ASSIGNMENT,
+    OPERATOR_LESS,
+    OPERATOR_LSHIFT,
+    OPERATOR_LSHIFT_ASSIGNMENT,
+    OPERATOR_EQUAL,
+    NOT_AN_OPERATOR,
+    OPERATOR_NOT_EQUAL,
+    OPERATOR_GREATER_EQUAL,
+    OPERATOR_LESS_EQUAL,
+    OPERATOR_BITWISE_NOT,
+};
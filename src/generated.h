@@ -11,96 +11,118 @@ this code is generated by `scripts/codegen.py` and should not be edited manually
 
 typedef enum {
     NOT_A_KEYWORD = 0,
-    KW_FALSE = 71,
-    KW_TRUE = 38,
-    KW_AND = 94,
-    KW_AS = 125,
-    KW_ASSERT = 67,
-    KW_BREAK = 55,
-    KW_CLASS = 75,
-    KW_CONTINUE = 32,
-    KW_DEF = 99,
-    KW_DEL = 105,
-    KW_ELIF = 89,
-    KW_ELSE = 98,
-    KW_EXCEPT = 70,
-    KW_FINALLY = 49,
-    KW_FOR = 3,
-    KW_FROM = 112,
-    KW_GLOBAL = 52,
-    KW_IF = 18,
-    KW_IMPORT = 100,
-    KW_IN = 26,
-    KW_IS = 31,
-    KW_LAMBDA = 51,
-    KW_NONLOCAL = 50,
-    KW_NOT = 37,
-    KW_OR = 54,
-    KW_PASS = 19,
-    KW_RAISE = 118,
-    KW_RETURN = 6,
-    KW_TRY = 69,
-    KW_WHILE = 12,
-    KW_WITH = 45,
-    KW_YIELD = 16,
+    KW_FALSE = 25,
+    KW_TRUE = 29,
+    KW_AND = 27,
+    KW_AS = 4,
+    KW_ASSERT = 10,
+    KW_BREAK = 18,
+    KW_CLASS = 9,
+    KW_CONTINUE = 12,
+    KW_DEF = 13,
+    KW_DEL = 31,
+    KW_ELIF = 24,
+    KW_ELSE = 28,
+    KW_EXCEPT = 21,
+    KW_FINALLY = 2,
+    KW_FOR = 1,
+    KW_FROM = 15,
+    KW_GLOBAL = 7,
+    KW_IF = 20,
+    KW_IMPORT = 32,
+    KW_IN = 17,
+    KW_IS = 23,
+    KW_LAMBDA = 19,
+    KW_NONLOCAL = 5,
+    KW_NOT = 14,
+    KW_OR = 16,
+    KW_PASS = 6,
+    KW_RAISE = 8,
+    KW_RETURN = 26,
+    KW_TRY = 3,
+    KW_WHILE = 30,
+    KW_WITH = 22,
+    KW_YIELD = 11,
 } Keyword;
 
-#define KEYWORDS_MAX 126
-size_t kw_hash(char* kw);
-Keyword is_keyword(char* word);
+#define KEYWORDS_MAX 33
+#define KEYWORD_LENGTH_MAX 8
+Keyword is_keyword(const char* str, size_t length);
 const char* kw_to_cstr(Keyword kw);
 
 typedef enum {
-    OPERATOR_PLUS = 86,
-    OPERATOR_MINUS = 90,
-    OPERATOR_MULT = 84,
-    OPERATOR_DIV = 94,
-    OPERATOR_MOD = 74,
-    OPERATOR_POW = 126,
-    OPERATOR_FLOORDIV = 5,
-    OPERATOR_ASSIGNMENT = 122,
-    OPERATOR_PLUS_ASSIGNMENT = 11,
-    OPERATOR_MINUS_ASSIGNMENT = 15,
+    NOT_AN_OPERATOR = 0,
+    OPERATOR_PLUS = 1,
+    OPERATOR_MINUS = 20,
+    OPERATOR_MULT = 11,
+    OPERATOR_DIV = 15,
+    OPERATOR_MOD = 36,
+    OPERATOR_POW = 31,
+    OPERATOR_FLOORDIV = 16,
+    OPERATOR_ASSIGNMENT = 40,
+    OPERATOR_PLUS_ASSIGNMENT = 7,
+    OPERATOR_MINUS_ASSIGNMENT = 43,
     OPERATOR_MULT_ASSIGNMENT = 9,
-    OPERATOR_DIV_ASSIGNMENT = 19,
-    OPERATOR_MOD_ASSIGNMENT = 135,
-    OPERATOR_FLOORDIV_ASSIGNMENT = 66,
-    OPERATOR_POW_ASSIGNMENT = 51,
-    OPERATOR_AND_ASSIGNMENT = 1,
-    OPERATOR_OR_ASSIGNMENT = 37,
-    OPERATOR_XOR_ASSIGNMENT = 113,
-    OPERATOR_RSHIFT_ASSIGNMENT = 111,
-    OPERATOR_LSHIFT_ASSIGNMENT = 105,
-    OPERATOR_EQUAL = 47,
-    OPERATOR_NOT_EQUAL = 127,
-    OPERATOR_GREATER = 124,
-    OPERATOR_LESS = 120,
-    OPERATOR_GREATER_EQUAL = 49,
-    OPERATOR_LESS_EQUAL = 45,
-    OPERATOR_BITWISE_AND = 76,
-    OPERATOR_BITWISE_OR = 112,
-    OPERATOR_BITWISE_XOR = 52,
-    OPERATOR_CONDITIONAL_IF = 40,
-    OPERATOR_CONDITIONAL_ELSE = 118,
-    OPERATOR_LSHIFT = 44,
-    OPERATOR_RSHIFT = 50,
-    OPERATOR_CALL = 71,
-    OPERATOR_GET_ITEM = 2,
-    OPERATOR_GET_ATTR = 14,
-    OPERATOR_LOGICAL_AND = 132,
-    OPERATOR_LOGICAL_OR = 64,
-    OPERATOR_LOGICAL_NOT = 39,
-    OPERATOR_IN = 48,
-    OPERATOR_IS = 53,
-    OPERATOR_NEGATIVE = 16,
-    OPERATOR_BITWISE_NOT = 116,
+    OPERATOR_DIV_ASSIGNMENT = 28,
+    OPERATOR_MOD_ASSIGNMENT = 23,
+    OPERATOR_FLOORDIV_ASSIGNMENT = 29,
+    OPERATOR_POW_ASSIGNMENT = 32,
+    OPERATOR_AND_ASSIGNMENT = 3,
+    OPERATOR_OR_ASSIGNMENT = 12,
+    OPERATOR_XOR_ASSIGNMENT = 19,
+    OPERATOR_RSHIFT_ASSIGNMENT = 5,
+    OPERATOR_LSHIFT_ASSIGNMENT = 21,
+    OPERATOR_EQUAL = 2,
+    OPERATOR_NOT_EQUAL = 38,
+    OPERATOR_GREATER = 41,
+    OPERATOR_LESS = 17,
+    OPERATOR_GREATER_EQUAL = 39,
+    OPERATOR_LESS_EQUAL = 33,
+    OPERATOR_BITWISE_AND = 30,
+    OPERATOR_BITWISE_OR = 22,
+    OPERATOR_BITWISE_XOR = 4,
+    OPERATOR_CONDITIONAL_IF = 26,
+    OPERATOR_CONDITIONAL_ELSE = 35,
+    OPERATOR_LSHIFT = 37,
+    OPERATOR_RSHIFT = 6,
+    OPERATOR_CALL = 10,
+    OPERATOR_GET_ITEM = 42,
+    OPERATOR_GET_ATTR = 24,
+    OPERATOR_LOGICAL_AND = 8,
+    OPERATOR_LOGICAL_OR = 25,
+    OPERATOR_LOGICAL_NOT = 34,
+    OPERATOR_IN = 27,
+    OPERATOR_IS = 13,
+    OPERATOR_NEGATIVE = 18,
+    OPERATOR_BITWISE_NOT = 14,
 } Operator;
 
-#define OPERATORS_MAX 136
+#define OPERATORS_MAX 44
 #define MAX_PRECEDENCE 16
 extern const unsigned int PRECEDENCE_TABLE[OPERATORS_MAX];
 extern const bool IS_ASSIGNMENT_OP[OPERATORS_MAX];
-Operator op_from_cstr(char* op);
+Operator op_from_cstr(const char* str, size_t length);
 const char* op_to_cstr(Operator op);
 
+typedef enum {
+    CHAR_INVALID,
+    CHAR_BLANK,
+    CHAR_NEWLINE,
+    CHAR_COMMENT,
+    CHAR_ALPHA,
+    CHAR_DIGIT,
+    CHAR_DOT,
+    CHAR_QUOTE,
+    CHAR_PUNCTUATION,
+    CHAR_OPERATOR,
+} CharClass;
+
+extern const unsigned char CHAR_CLASS_TABLE[256];
+
+#define OPERATOR_COLUMNS 14
+#define OPERATOR_STATES 34
+extern const unsigned char OPERATOR_CHAR_INDEX[256];
+extern const unsigned char OPERATOR_DFA[OPERATOR_STATES][OPERATOR_COLUMNS];
+extern const Operator OPERATOR_ACCEPTS[OPERATOR_STATES];
+
 #endif
@@ -138,6 +138,8 @@ symbol_hm_get(SymbolHashmap* hm, SourceString identifier)
 void
 symbol_hm_finalize(SymbolHashmap* hm)
 {
+    // scopes are finalized when popped, which the compiler does again for every scope
+    if (hm->finalized) return;
     size_t total_bytes_required =
         (sizeof(int) * hm->lookup_capacity) + (sizeof(Symbol) * hm->elements_count);
     uint8_t* static_buffer = arena_alloc(hm->arena, total_bytes_required);
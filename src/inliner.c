@@ -0,0 +1,575 @@
+#include "inliner.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "diagnostics.h"
+
+typedef enum {
+    FUNCTION_UNVISITED,
+    FUNCTION_IN_PROGRESS,
+    FUNCTION_DONE,
+} FunctionState;
+
+typedef struct {
+    FunctionStatement* fndef;
+    DefineFunctionInst* def;
+    FunctionState state;
+    bool recursive;
+    bool inlinable;
+    // the body checks `global_exception` and returns, which needs the callers handler
+    bool has_exception_checks;
+} InlineCandidate;
+
+typedef struct {
+    size_t capacity;
+    InlineCandidate* elements;
+} CandidateTable;
+
+typedef struct {
+    // Variable* or const char* (temporaries and labels) from the callee's body
+    const void* key;
+    StorageIdent value;
+} Rename;
+
+typedef struct {
+    size_t count;
+    size_t capacity;
+    Rename* elements;
+} RenameMap;
+
+typedef struct {
+    Arena* arena;
+    InlineOptions opts;
+    CandidateTable candidates;
+    InlineCandidate* current;
+    const char* id_namespace;
+    size_t unique_vars_counter;
+} Inliner;
+
+// the compiler's temporaries are named `_np_N` so inlined copies get their own prefix
+#define INLINER_UNIQUE_ID(inliner)                                                       \
+    arena_snprintf(                                                                      \
+        (inliner)->arena,                                                                \
+        strlen((inliner)->id_namespace) + 24,                                            \
+        "_npi_%s%zu",                                                                    \
+        (inliner)->id_namespace,                                                         \
+        (inliner)->unique_vars_counter++                                                 \
+    )
+
+static size_t
+sequence_cost(InstructionSequence seq)
+{
+    size_t cost = seq.count;
+    for (size_t i = 0; i < seq.count; i++) {
+        InstructionSequence* nested[NESTED_SEQUENCES_MAX];
+        size_t nested_count = nested_sequences(seq.instructions + i, nested);
+        for (size_t j = 0; j < nested_count; j++) cost += sequence_cost(*nested[j]);
+    }
+    return cost;
+}
+
+static size_t
+count_functions(InstructionSequence seq)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < seq.count; i++) {
+        if (seq.instructions[i].kind == INST_DEFINE_FUNCTION) count++;
+        InstructionSequence* nested[NESTED_SEQUENCES_MAX];
+        size_t nested_count = nested_sequences(seq.instructions + i, nested);
+        for (size_t j = 0; j < nested_count; j++) count += count_functions(*nested[j]);
+    }
+    return count;
+}
+
+static InlineCandidate*
+candidate_slot(CandidateTable* table, FunctionStatement* fndef)
+{
+    uint64_t hash = (uint64_t)(uintptr_t)fndef;
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+
+    size_t i = hash & (table->capacity - 1);
+    while (table->elements[i].fndef && table->elements[i].fndef != fndef)
+        i = (i + 1) & (table->capacity - 1);
+    return table->elements + i;
+}
+
+static InlineCandidate*
+get_candidate(Inliner* inliner, FunctionStatement* fndef)
+{
+    InlineCandidate* slot = candidate_slot(&inliner->candidates, fndef);
+    return (slot->fndef) ? slot : NULL;
+}
+
+static void
+register_functions(Inliner* inliner, InstructionSequence seq)
+{
+    for (size_t i = 0; i < seq.count; i++) {
+        Instruction* inst = seq.instructions + i;
+        if (inst->kind == INST_DEFINE_FUNCTION) {
+            InlineCandidate* slot =
+                candidate_slot(&inliner->candidates, inst->define_function.fndef);
+            slot->fndef = inst->define_function.fndef;
+            slot->def = &inst->define_function;
+        }
+        InstructionSequence* nested[NESTED_SEQUENCES_MAX];
+        size_t nested_count = nested_sequences(inst, nested);
+        for (size_t j = 0; j < nested_count; j++)
+            register_functions(inliner, *nested[j]);
+    }
+}
+
+// checks inserted by the compiler that return from the function when an exception is
+// set, once inlined these are replaced with the caller's check
+static bool
+is_returning_exception_check(Instruction inst)
+{
+    return is_exception_check(inst) && inst.if_.body.count == 1 &&
+           inst.if_.body.instructions[0].kind == INST_RETURN;
+}
+
+// a body can be inlined when its only exit is the return at the end of the function
+static bool
+sequence_is_inlinable(InstructionSequence seq, bool top_level, bool* has_exception_checks)
+{
+    for (size_t i = 0; i < seq.count; i++) {
+        Instruction* inst = seq.instructions + i;
+        switch (inst->kind) {
+            case INST_DEFINE_FUNCTION:
+                return false;
+            case INST_DEFINE_CLASS:
+                return false;
+            case INST_INIT_CLOSURE:
+                return false;
+            case INST_RETURN:
+                if (!top_level || i != seq.count - 1) return false;
+                break;
+            case INST_IF:
+                if (is_returning_exception_check(*inst)) {
+                    *has_exception_checks = true;
+                    break;
+                }
+                if (!sequence_is_inlinable(inst->if_.body, false, has_exception_checks))
+                    return false;
+                break;
+            default: {
+                InstructionSequence* nested[NESTED_SEQUENCES_MAX];
+                size_t nested_count = nested_sequences(inst, nested);
+                for (size_t j = 0; j < nested_count; j++) {
+                    if (!sequence_is_inlinable(*nested[j], false, has_exception_checks))
+                        return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+static void
+rename_map_put(RenameMap* map, const void* key, StorageIdent value)
+{
+    if (map->count == map->capacity) {
+        map->capacity = (map->capacity) ? map->capacity * 2 : 16;
+        map->elements = realloc(map->elements, sizeof(Rename) * map->capacity);
+        if (!map->elements) error("out of memory");
+    }
+    map->elements[map->count++] = (Rename){.key = key, .value = value};
+}
+
+static Rename*
+rename_map_get(RenameMap* map, const void* key)
+{
+    for (size_t i = 0; i < map->count; i++) {
+        if (map->elements[i].key == key) return map->elements + i;
+    }
+    return NULL;
+}
+
+typedef struct {
+    Inliner* inliner;
+    RenameMap map;
+    // the call being replaced and the exception check that followed it
+    Instruction call;
+    Instruction* handler;
+} Expansion;
+
+static StorageIdent
+fresh_ident(Expansion* ex, TypeInfo info)
+{
+    return (StorageIdent){
+        .kind = IDENT_CSTR,
+        .cstr = INLINER_UNIQUE_ID(ex->inliner),
+        .info = info,
+    };
+}
+
+static StorageIdent
+rename_ident(Expansion* ex, StorageIdent ident)
+{
+    const void* key = NULL;
+    if (ident.kind == IDENT_VAR)
+        key = ident.var;
+    else if (ident.kind == IDENT_CSTR)
+        key = ident.cstr;
+    if (!key) return ident;
+
+    Rename* rename = rename_map_get(&ex->map, key);
+    if (!rename) return ident;
+    StorageIdent renamed = rename->value;
+    renamed.reference = ident.reference;
+    return renamed;
+}
+
+static const char*
+rename_label(Expansion* ex, const char* label)
+{
+    Rename* rename = rename_map_get(&ex->map, label);
+    if (rename) return rename->value.cstr;
+    StorageIdent renamed = fresh_ident(ex, NONE_TYPE);
+    rename_map_put(&ex->map, label, renamed);
+    return renamed.cstr;
+}
+
+// callee variables and temporaries are given fresh names where they are declared,
+// anything not declared in the callee (globals) keeps its name
+static StorageIdent
+declare_renamed_ident(Expansion* ex, StorageIdent ident)
+{
+    if (ident.kind == IDENT_VAR) {
+        StorageIdent renamed = fresh_ident(ex, ident.var->type_info);
+        rename_map_put(&ex->map, ident.var, renamed);
+        return renamed;
+    }
+    if (ident.kind == IDENT_CSTR && ident.cstr) {
+        StorageIdent renamed = fresh_ident(ex, ident.info);
+        rename_map_put(&ex->map, ident.cstr, renamed);
+        return renamed;
+    }
+    return ident;
+}
+
+static StorageIdent*
+rename_ident_array(Expansion* ex, StorageIdent* idents, size_t count)
+{
+    if (!idents || count == 0) return idents;
+    StorageIdent* renamed = arena_alloc(ex->inliner->arena, sizeof(StorageIdent) * count);
+    for (size_t i = 0; i < count; i++) renamed[i] = rename_ident(ex, idents[i]);
+    return renamed;
+}
+
+static OperationInst
+rename_operation(Expansion* ex, OperationInst op)
+{
+    switch (op.kind) {
+        case OPERATION_INTRINSIC:
+            op.left = rename_ident(ex, op.left);
+            op.right = rename_ident(ex, op.right);
+            break;
+        case OPERATION_FUNCTION_CALL:
+            op.function = rename_ident(ex, op.function);
+            op.args =
+                rename_ident_array(ex, op.args, op.function.info.sig->params_count);
+            op.self = rename_ident(ex, op.self);
+            break;
+        case OPERATION_C_CALL:
+            op.c_function_args =
+                rename_ident_array(ex, op.c_function_args, op.c_function.argc);
+            break;
+        case OPERATION_C_CALL1:
+            op.c_function_arg = rename_ident(ex, op.c_function_arg);
+            break;
+        case OPERATION_GET_ATTR:
+            op.object = rename_ident(ex, op.object);
+            break;
+        case OPERATION_SET_ATTR:
+            op.object = rename_ident(ex, op.object);
+            op.value = rename_ident(ex, op.value);
+            break;
+        case OPERATION_COPY:
+            op.copy = rename_ident(ex, op.copy);
+            break;
+        case OPERATION_DEREF:
+            op.ref = rename_ident(ex, op.ref);
+            break;
+    }
+    return op;
+}
+
+static void expand_instruction(Expansion* ex, InstructionSequence* out, Instruction inst);
+
+static InstructionSequence
+expand_sequence(Expansion* ex, InstructionSequence seq)
+{
+    InstructionSequence out = instruction_sequence_init(ex->inliner->arena);
+    for (size_t i = 0; i < seq.count; i++)
+        expand_instruction(ex, &out, seq.instructions[i]);
+    instruction_sequence_finalize(&out);
+    return out;
+}
+
+static void
+expand_instruction(Expansion* ex, InstructionSequence* out, Instruction inst)
+{
+    switch (inst.kind) {
+        case INST_NO_OP:
+            return;
+        case INST_ASSIGNMENT:
+            inst.assignment.right = rename_operation(ex, inst.assignment.right);
+            inst.assignment.left = rename_ident(ex, inst.assignment.left);
+            break;
+        case INST_DECL_ASSIGNMENT:
+            inst.assignment.right = rename_operation(ex, inst.assignment.right);
+            inst.assignment.left = declare_renamed_ident(ex, inst.assignment.left);
+            break;
+        case INST_OPERATION:
+            inst.operation = rename_operation(ex, inst.operation);
+            break;
+        case INST_DECLARE_VARIABLE:
+            if (inst.declare_variable.kind == IDENT_VAR &&
+                (inst.declare_variable.var->kind == VAR_ARGUMENT ||
+                 inst.declare_variable.var->kind == VAR_SELF))
+                // bound to fresh variables before the body
+                return;
+            inst.declare_variable = declare_renamed_ident(ex, inst.declare_variable);
+            break;
+        case INST_LOOP:
+            inst.loop.init = expand_sequence(ex, inst.loop.init);
+            inst.loop.condition = rename_ident(ex, inst.loop.condition);
+            inst.loop.after_label = rename_label(ex, inst.loop.after_label);
+            inst.loop.before = expand_sequence(ex, inst.loop.before);
+            inst.loop.body = expand_sequence(ex, inst.loop.body);
+            inst.loop.after = expand_sequence(ex, inst.loop.after);
+            break;
+        case INST_IF:
+            if (is_returning_exception_check(inst)) {
+                inst = *ex->handler;
+                break;
+            }
+            inst.if_.condition_ident = rename_ident(ex, inst.if_.condition_ident);
+            inst.if_.body = expand_sequence(ex, inst.if_.body);
+            break;
+        case INST_ELSE:
+            inst.else_ = expand_sequence(ex, inst.else_);
+            break;
+        case INST_GOTO:
+            inst.label = rename_label(ex, inst.label);
+            break;
+        case INST_LABEL:
+            inst.label = rename_label(ex, inst.label);
+            break;
+        case INST_BREAK:
+            break;
+        case INST_CONTINUE:
+            break;
+        case INST_RETURN:
+            // the final return stores into the call's destination
+            inst = (Instruction){
+                .kind = INST_ASSIGNMENT,
+                .assignment.left = ex->call.assignment.left,
+                .assignment.right =
+                    (OperationInst){
+                        .kind = OPERATION_COPY,
+                        .copy = rename_ident(ex, inst.return_.rtval),
+                    },
+            };
+            break;
+        case INST_ITER_NEXT:
+            inst.iter_next.iter = rename_ident(ex, inst.iter_next.iter);
+            inst.iter_next.unpack = rename_ident(ex, inst.iter_next.unpack);
+            break;
+        case INST_DEFINE_FUNCTION:
+            UNREACHABLE();
+        case INST_DEFINE_CLASS:
+            UNREACHABLE();
+        case INST_INIT_CLOSURE:
+            UNREACHABLE();
+        case INST_IMPORT_MODULE:
+            // imports are only compiled at the top level
+            UNREACHABLE();
+    }
+    instruction_sequence_append(out, inst);
+}
+
+static void
+expand_call(
+    Inliner* inliner,
+    InstructionSequence* out,
+    Instruction call,
+    Instruction* handler,
+    InlineCandidate* callee
+)
+{
+    FunctionStatement* fndef = callee->fndef;
+    OperationInst call_op = call.assignment.right;
+    Expansion ex = {.inliner = inliner, .call = call, .handler = handler};
+
+    if (call.kind == INST_DECL_ASSIGNMENT)
+        instruction_sequence_append(
+            out,
+            (Instruction){
+                .kind = INST_DECLARE_VARIABLE,
+                .declare_variable = call.assignment.left,
+            }
+        );
+
+    // arguments and `self` are copied into fresh variables so the inlined body is free
+    // to assign to them
+    for (size_t i = 0; i < fndef->sig.params_count; i++) {
+        Symbol* sym = symbol_hm_get(&fndef->scope->hm, fndef->sig.params[i]);
+        StorageIdent param = fresh_ident(&ex, fndef->sig.types[i]);
+        rename_map_put(&ex.map, sym->variable, param);
+        instruction_sequence_append(
+            out,
+            (Instruction){
+                .kind = INST_DECL_ASSIGNMENT,
+                .assignment.left = param,
+                .assignment.right =
+                    (OperationInst){.kind = OPERATION_COPY, .copy = call_op.args[i]},
+            }
+        );
+    }
+    for (size_t i = 0; fndef->is_method && i < fndef->scope->hm.elements_count; i++) {
+        Symbol* sym = fndef->scope->hm.elements + i;
+        if (sym->kind != SYM_VARIABLE || sym->variable->kind != VAR_SELF) continue;
+        StorageIdent self = fresh_ident(&ex, sym->variable->type_info);
+        rename_map_put(&ex.map, sym->variable, self);
+        instruction_sequence_append(
+            out,
+            (Instruction){
+                .kind = INST_DECL_ASSIGNMENT,
+                .assignment.left = self,
+                .assignment.right =
+                    (OperationInst){.kind = OPERATION_COPY, .copy = call_op.self},
+            }
+        );
+    }
+
+    InstructionSequence body = callee->def->body;
+    for (size_t i = 0; i < body.count; i++)
+        expand_instruction(&ex, out, body.instructions[i]);
+
+    free(ex.map.elements);
+}
+
+static void process_function(Inliner* inliner, InlineCandidate* candidate);
+
+static InlineCandidate*
+inlinable_callee(Inliner* inliner, Instruction inst, bool has_handler)
+{
+    if (inst.kind != INST_ASSIGNMENT && inst.kind != INST_DECL_ASSIGNMENT) return NULL;
+    OperationInst op = inst.assignment.right;
+    if (op.kind != OPERATION_FUNCTION_CALL || op.function.kind != IDENT_FUNCTION)
+        return NULL;
+
+    InlineCandidate* callee = get_candidate(inliner, op.function.func);
+    if (!callee) return NULL;
+    switch (callee->state) {
+        case FUNCTION_IN_PROGRESS:
+            inliner->current->recursive = true;
+            return NULL;
+        case FUNCTION_UNVISITED:
+            process_function(inliner, callee);
+            break;
+        case FUNCTION_DONE:
+            break;
+    }
+    if (!callee->inlinable) return NULL;
+    if (callee->has_exception_checks && !has_handler) return NULL;
+    return callee;
+}
+
+static void
+inline_sequence(Inliner* inliner, InstructionSequence* seq)
+{
+    InstructionSequence out = {0};
+    bool expanded = false;
+
+    for (size_t i = 0; i < seq->count; i++) {
+        Instruction* inst = seq->instructions + i;
+
+        if (inst->kind == INST_DEFINE_FUNCTION) {
+            InlineCandidate* candidate =
+                get_candidate(inliner, inst->define_function.fndef);
+            if (candidate->state == FUNCTION_UNVISITED)
+                process_function(inliner, candidate);
+        }
+        else {
+            InstructionSequence* nested[NESTED_SEQUENCES_MAX];
+            size_t nested_count = nested_sequences(inst, nested);
+            for (size_t j = 0; j < nested_count; j++) inline_sequence(inliner, nested[j]);
+        }
+
+        Instruction* handler = NULL;
+        if (i + 1 < seq->count && is_exception_check(seq->instructions[i + 1]))
+            handler = seq->instructions + i + 1;
+
+        InlineCandidate* callee = inlinable_callee(inliner, *inst, handler != NULL);
+        if (callee && !expanded) {
+            out = instruction_sequence_init(seq->arena);
+            for (size_t j = 0; j < i; j++)
+                instruction_sequence_append(&out, seq->instructions[j]);
+            expanded = true;
+        }
+
+        if (callee) {
+            expand_call(inliner, &out, *inst, handler, callee);
+            // the inlined body checks for exceptions wherever they can be set
+            if (handler) i++;
+        }
+        else if (expanded)
+            instruction_sequence_append(&out, *inst);
+    }
+
+    if (expanded) {
+        instruction_sequence_finalize(&out);
+        *seq = out;
+    }
+}
+
+static void
+process_function(Inliner* inliner, InlineCandidate* candidate)
+{
+    InlineCandidate* caller = inliner->current;
+    candidate->state = FUNCTION_IN_PROGRESS;
+    inliner->current = candidate;
+    inline_sequence(inliner, &candidate->def->body);
+    inliner->current = caller;
+    candidate->state = FUNCTION_DONE;
+
+    FunctionStatement* fndef = candidate->fndef;
+    candidate->inlinable =
+        !candidate->recursive && !fndef->decorator &&
+        fndef->scope->kind == SCOPE_FUNCTION &&
+        sequence_cost(candidate->def->body) <= inliner->opts.threshold &&
+        sequence_is_inlinable(
+            candidate->def->body, true, &candidate->has_exception_checks
+        );
+}
+
+void
+inline_functions(CompiledInstructions* compiled, InlineOptions opts)
+{
+    if (opts.threshold == 0) return;
+
+    size_t function_count = count_functions(compiled->seq);
+    if (function_count == 0) return;
+
+    Inliner inliner = {
+        .arena = compiled->seq.arena,
+        .opts = opts,
+        .id_namespace = compiled->id_namespace,
+    };
+    inliner.candidates.capacity = 8;
+    while (inliner.candidates.capacity < function_count * 2)
+        inliner.candidates.capacity *= 2;
+    inliner.candidates.elements =
+        calloc(inliner.candidates.capacity, sizeof(InlineCandidate));
+    if (!inliner.candidates.elements) error("out of memory");
+
+    register_functions(&inliner, compiled->seq);
+    inline_sequence(&inliner, &compiled->seq);
+
+    free(inliner.candidates.elements);
+}
@@ -0,0 +1,17 @@
+#ifndef INLINER_H
+#define INLINER_H
+
+#include "compiler.h"
+
+#define INLINE_DEFAULT_THRESHOLD 32
+
+typedef struct {
+    // functions made up of more instructions than this are never inlined
+    // a threshold of 0 disables inlining
+    size_t threshold;
+} InlineOptions;
+
+// substitutes the bodies of small, non-recursive functions in place of direct calls
+void inline_functions(CompiledInstructions* compiled, InlineOptions opts);
+
+#endif
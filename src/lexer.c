@@ -1,254 +1,292 @@
+// mmap
+#define _POSIX_C_SOURCE 200809L
+
 #include "lexer.h"
 
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "lexer_helpers.h"
+#include "np_hash.h"
 #include "syntax.h"
+#include "timing.h"
+
+typedef struct {
+    const char* data;
+    size_t length;
+} SourceMapping;
+
+static SourceMapping
+map_source(const char* filepath)
+{
+    int fd = open(filepath, O_RDONLY);
+    if (fd < 0) errorf("failed to open (%s) for reading: %s", filepath, strerror(errno));
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+        errorf("failed to stat (%s): %s", filepath, strerror(errno));
+
+    // tokens locate themselves with 32 bit offsets
+    if ((uint64_t)info.st_size > UINT32_MAX)
+        errorf("(%s) is too large to compile", filepath);
+
+    // an empty file can't be mapped
+    SourceMapping source = {.data = "", .length = (size_t)info.st_size};
+    if (source.length) {
+        void* data = mmap(NULL, source.length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+            errorf("failed to map (%s) into memory: %s", filepath, strerror(errno));
+        source.data = data;
+    }
+    close(fd);
+    return source;
+}
+
+static void
+unmap_source(SourceMapping source)
+{
+    if (source.length) munmap((void*)source.data, source.length);
+}
 
-#define SCANNER_BUF_CAPACITY 4096
-#define ASSERT_BUF_CAPACITY 1024
+// every occurrence of an identifier within a file shares a single copy
+typedef struct {
+    size_t capacity;
+    size_t count;
+    SourceString* elements;
+} InternTable;
 
+typedef enum {
+    BRACKET_NONE,
+    BRACKET_PARENS,
+    BRACKET_SQUARE,
+    BRACKET_CURLY,
+    BRACKET_KINDS,
+} BracketKind;
+
+// the source is scanned in place, the text of tokens is copied into the arena once the
+// whole token has been seen
 typedef struct {
-    FILE* srcfile;
     Arena* arena;
     TokenQueue* tq;
     Token token;
     Location loc;
     FileIndex* index;
-    size_t file_offset;
-    unsigned int open_parens;
-    unsigned int open_curly;
-    unsigned int open_square;
+    const char* source;
+    const char* end;
+    // the next character to scan
+    const char* cursor;
+    // columns are counted from here
+    const char* line_start;
+    // how many of each kind of bracket are open and how many of any kind
+    unsigned int open_brackets[BRACKET_KINDS];
+    unsigned int open_brackets_total;
     bool finished;
-    bool scanning_assert;
-    char c;
-    size_t buflen;
-    char buf[SCANNER_BUF_CAPACITY];
-    size_t assert_buflen;
-    char assert_buf[ASSERT_BUF_CAPACITY];
+    // the source code of an assert statement is kept for its error message, NULL
+    // when not scanning one
+    const char* assert_start;
+    unsigned int assert_col;
+    InternTable identifiers;
+    size_t tokens_count;
+    bool time_scanning;
+    double scan_seconds;
 } Scanner;
 
-static inline void
-scanner_getc(Scanner* scanner)
-{
-    if (scanner->buflen == SCANNER_BUF_CAPACITY) error("scanner buffer overflow");
-    scanner->c = fgetc(scanner->srcfile);
-    if (scanner->scanning_assert) {
-        if (scanner->assert_buflen == ASSERT_BUF_CAPACITY - 2)
-            error("assert buffer overflow");
-        switch (scanner->c) {
-            case '\n':
-                scanner->assert_buf[scanner->assert_buflen++] = '\\';
-                scanner->assert_buf[scanner->assert_buflen++] = 'n';
-                break;
-            case '\t':
-                scanner->assert_buf[scanner->assert_buflen++] = '\\';
-                scanner->assert_buf[scanner->assert_buflen++] = 't';
-                break;
-            case '\r':
-                scanner->assert_buf[scanner->assert_buflen++] = '\\';
-                scanner->assert_buf[scanner->assert_buflen++] = 'r';
-                break;
-            default:
-                scanner->assert_buf[scanner->assert_buflen++] = scanner->c;
-        }
+static Scanner
+scanner_init(
+    Arena* arena, SourceMapping source, Location start, FileIndex* index, TokenQueue* tq
+)
+{
+    return (Scanner){
+        .arena = arena,
+        .tq = tq,
+        .loc = start,
+        .index = index,
+        .source = source.data,
+        .end = source.data + source.length,
+        .cursor = source.data,
+        .line_start = source.data,
+    };
+}
+
+// '\0' once the end of the source is reached
+static inline char
+scanner_peekc(Scanner* scanner, size_t offset)
+{
+    if ((size_t)(scanner->end - scanner->cursor) <= offset) return '\0';
+    return scanner->cursor[offset];
+}
+
+static inline SourceString
+copy_source(Scanner* scanner, const char* start, size_t length)
+{
+    char* data = arena_alloc(scanner->arena, length + 1);
+    memcpy(data, start, length);
+    data[length] = '\0';
+    return (SourceString){.data = data, .length = length};
+}
+
+static SourceString*
+intern_slot(InternTable* table, const char* data, size_t length)
+{
+    size_t i = hash_bytes((void*)data, length) & (table->capacity - 1);
+    for (;;) {
+        SourceString* slot = table->elements + i;
+        if (!slot->data) return slot;
+        if (slot->length == length && memcmp(slot->data, data, length) == 0) return slot;
+        i = (i + 1) & (table->capacity - 1);
     }
-    scanner->file_offset++;
-    scanner->buf[scanner->buflen++] = scanner->c;
-    scanner->loc.col++;
-    scanner->buf[scanner->buflen] = '\0';
 }
 
-static inline void
-scanner_ungetc(Scanner* scanner)
-{
-    assert(scanner->buflen && "ungetc from empty buffer");
-    scanner->file_offset--;
-    scanner->loc.col--;
-    ungetc(scanner->buf[--scanner->buflen], scanner->srcfile);
-    if (scanner->scanning_assert) {
-        switch (scanner->c) {
-            case '\n':
-                scanner->assert_buflen -= 2;
-                break;
-            case '\t':
-                scanner->assert_buflen -= 2;
-                break;
-            case '\r':
-                scanner->assert_buflen -= 2;
-                break;
-            default:
-                scanner->assert_buflen -= 1;
-        }
+static void
+intern_table_grow(InternTable* table)
+{
+    InternTable grown = {
+        .count = table->count,
+        .capacity = (table->capacity) ? table->capacity * 2 : 256,
+    };
+    grown.elements = calloc(grown.capacity, sizeof(SourceString));
+    if (!grown.elements) error("out of memory");
+
+    for (size_t i = 0; i < table->capacity; i++) {
+        SourceString str = table->elements[i];
+        if (str.data) *intern_slot(&grown, str.data, str.length) = str;
     }
+    free(table->elements);
+    *table = grown;
 }
 
-static inline char
-scanner_peekc(Scanner* scanner)
-{
-    char c = fgetc(scanner->srcfile);
-    ungetc(c, scanner->srcfile);
-    return c;
-}
-
-static bool CHAR_IS_OPERATOR_TABLE[sizeof(unsigned char) * 256] = {
-    ['-'] = true,
-    ['!'] = true,
-    ['+'] = true,
-    ['*'] = true,
-    ['/'] = true,
-    ['|'] = true,
-    ['&'] = true,
-    ['%'] = true,
-    ['='] = true,
-    ['<'] = true,
-    ['>'] = true,
-    ['^'] = true,
-    ['~'] = true,
-};
+static SourceString
+intern_identifier(Scanner* scanner, const char* start, size_t length)
+{
+    InternTable* table = &scanner->identifiers;
+    if (table->count * 2 >= table->capacity) intern_table_grow(table);
+    SourceString* slot = intern_slot(table, start, length);
+    if (!slot->data) {
+        *slot = copy_source(scanner, start, length);
+        table->count++;
+    }
+    return *slot;
+}
+
+// character classes and the operator DFA are generated by scripts/codegen.py
+#define CHAR_CLASS(c) ((CharClass)CHAR_CLASS_TABLE[(unsigned char)(c)])
+#define CHAR_CONTINUES_WORD(c)                                                           \
+    (CHAR_CLASS(c) == CHAR_ALPHA || CHAR_CLASS(c) == CHAR_DIGIT)
 
-#define CHAR_IS_OPERATOR(c) CHAR_IS_OPERATOR_TABLE[(unsigned char)(c)]
+typedef struct {
+    TokenType type;
+    BracketKind bracket;
+    // +1 for opening brackets and -1 for closing brackets
+    int depth_change;
+} Punctuation;
+
+static const Punctuation PUNCTUATION_TABLE[sizeof(unsigned char) * 256] = {
+    ['@'] = {.type = TOK_DECORATOR},
+    [','] = {.type = TOK_COMMA},
+    [':'] = {.type = TOK_COLON},
+    ['('] = {.type = TOK_OPEN_PARENS, .bracket = BRACKET_PARENS, .depth_change = 1},
+    [')'] = {.type = TOK_CLOSE_PARENS, .bracket = BRACKET_PARENS, .depth_change = -1},
+    ['['] = {.type = TOK_OPEN_SQUARE, .bracket = BRACKET_SQUARE, .depth_change = 1},
+    [']'] = {.type = TOK_CLOSE_SQUARE, .bracket = BRACKET_SQUARE, .depth_change = -1},
+    ['{'] = {.type = TOK_OPEN_CURLY, .bracket = BRACKET_CURLY, .depth_change = 1},
+    ['}'] = {.type = TOK_CLOSE_CURLY, .bracket = BRACKET_CURLY, .depth_change = -1},
+};
 
-#define CHAR_IS_ALPHA(c)                                                                 \
-    (((c) >= 'A' && (c) <= 'Z') || ((c) >= 'a' && (c) <= 'z') || c == '_')
+static const char OPENING_BRACKETS[BRACKET_KINDS] = {
+    [BRACKET_PARENS] = '(',
+    [BRACKET_SQUARE] = '[',
+    [BRACKET_CURLY] = '{',
+};
 
-#define CHAR_IS_NUMERIC(c) (((c) >= '0' && (c) <= '9'))
+static inline void
+mark_token_start(Scanner* scanner)
+{
+    scanner->loc.col = (unsigned int)(scanner->cursor - scanner->line_start) + 1;
+    scanner->token.offset = (uint32_t)(scanner->cursor - scanner->source);
+}
 
 static inline void
-skip_whitespace(Scanner* scanner)
+scan_newline(Scanner* scanner)
 {
-    while (scanner->buflen == 0) {
-        scanner_getc(scanner);
-        switch (scanner->c) {
-            case ' ':
-                scanner->buflen--;
-                break;
-            case '\t':
-                scanner->buflen--;
-                break;
-            case EOF:
-                scanner->token.type = TOK_EOF;
-                scanner->token.loc = arena_alloc(scanner->arena, sizeof(Location));
-                memcpy(scanner->token.loc, &scanner->loc, sizeof(Location));
-                scanner->finished = true;
-                return;
-            default:
-                break;
-        }
-    }
+    scanner->cursor++;
+    file_index_index_line(scanner->index, scanner->cursor - scanner->source);
+    scanner->line_start = scanner->cursor;
+    scanner->loc.line++;
+}
+
+static inline bool
+should_tokenize_newlines(Scanner* scanner)
+{
+    return scanner->open_brackets_total == 0;
 }
 
+// skips whitespace, comments and newlines within brackets
 static inline void
-skip_comments(Scanner* scanner)
-{
-    // skip comments by advancing to newline token
-    if (scanner->c == '#') {
-        for (scanner_getc(scanner); scanner->c != '\n' && scanner->c != EOF;
-             scanner_getc(scanner))
-            ;
-        if (scanner->c == EOF) {
+skip_blanks(Scanner* scanner)
+{
+    for (;;) {
+        while (scanner->cursor < scanner->end &&
+               CHAR_CLASS(*scanner->cursor) == CHAR_BLANK)
+            scanner->cursor++;
+
+        // the newline ending a comment is still a token
+        if (scanner->cursor < scanner->end &&
+            CHAR_CLASS(*scanner->cursor) == CHAR_COMMENT) {
+            const char* newline =
+                memchr(scanner->cursor, '\n', scanner->end - scanner->cursor);
+            scanner->cursor = (newline) ? newline : scanner->end;
+        }
+
+        if (scanner->cursor == scanner->end) {
+            mark_token_start(scanner);
             scanner->token.type = TOK_EOF;
-            scanner->token.loc = arena_alloc(scanner->arena, sizeof(Location));
-            memcpy(scanner->token.loc, &scanner->loc, sizeof(Location));
             scanner->finished = true;
             return;
         }
-        // replace '#' with the newline
-        scanner->buf[scanner->buflen] = '\n';
-        scanner->c = '\n';
+        if (*scanner->cursor != '\n' || should_tokenize_newlines(scanner)) return;
+        scan_newline(scanner);
     }
 }
 
-static inline bool
-handle_single_char_tokens(Scanner* scanner)
+static inline void
+tokenize_punctuation(Scanner* scanner)
 {
-    switch (scanner->c) {
-        case '@':
-            scanner->token.type = TOK_DECORATOR;
-            return true;
-        case '\n':
-            file_index_index_line(scanner->index, scanner->file_offset);
-            scanner->token.type = TOK_NEWLINE;
-            scanner->loc.line++;
-            scanner->loc.col = 0;
-            return true;
-        case '(':
-            scanner->open_parens += 1;
-            scanner->token.type = TOK_OPEN_PARENS;
-            return true;
-        case ')':
-            if (scanner->open_parens == 0)
-                syntax_error(*scanner->index, scanner->loc, 2, "no matching `(`");
-            scanner->open_parens -= 1;
-            scanner->token.type = TOK_CLOSE_PARENS;
-            return true;
-        case '[':
-            scanner->open_square += 1;
-            scanner->token.type = TOK_OPEN_SQUARE;
-            return true;
-        case ']':
-            if (scanner->open_square == 0)
-                syntax_error(*scanner->index, scanner->loc, 2, "no matching `[`");
-            scanner->open_square -= 1;
-            scanner->token.type = TOK_CLOSE_SQUARE;
-            return true;
-        case '{':
-            scanner->open_curly += 1;
-            scanner->token.type = TOK_OPEN_CURLY;
-            return true;
-        case '}':
-            if (scanner->open_curly == 0)
-                syntax_error(*scanner->index, scanner->loc, 2, "no matching `{`");
-            scanner->open_curly -= 1;
-            scanner->token.type = TOK_CLOSE_CURLY;
-            return true;
-        case ':':
-            scanner->token.type = TOK_COLON;
-            return true;
-        case ',':
-            scanner->token.type = TOK_COMMA;
-            return true;
-        case '.':
-            if (CHAR_IS_ALPHA(scanner_peekc(scanner))) {
-                scanner->token.type = TOK_DOT;
-                return true;
-            }
-            return false;
-        case '-': {
-            // not really a single char token
-            char next = scanner_peekc(scanner);
-            if (next == '>') {
-                scanner_getc(scanner);
-                scanner->token.type = TOK_ARROW;
-                return true;
-            }
-            break;
-        }
-        default:
-            return false;
-    }
-    return false;
+    Punctuation punctuation = PUNCTUATION_TABLE[(unsigned char)*scanner->cursor];
+    unsigned int* open = scanner->open_brackets + punctuation.bracket;
+    if (punctuation.depth_change < 0 && *open == 0)
+        syntax_errorf(
+            *scanner->index,
+            scanner->loc,
+            2,
+            "no matching `%c`",
+            OPENING_BRACKETS[punctuation.bracket]
+        );
+    *open += punctuation.depth_change;
+    scanner->open_brackets_total += punctuation.depth_change;
+    scanner->token.type = punctuation.type;
+    scanner->cursor++;
 }
 
 static inline void
 tokenize_word(Scanner* scanner)
 {
-    for (scanner_getc(scanner); CHAR_IS_ALPHA(scanner->c) || CHAR_IS_NUMERIC(scanner->c);
-         scanner_getc(scanner))
-        ;
-    scanner_ungetc(scanner);
-    scanner->buf[scanner->buflen] = '\0';
-    Keyword kw;
-    if ((kw = is_keyword(scanner->buf))) {
+    const char* start = scanner->cursor;
+    do {
+        scanner->cursor++;
+    } while (CHAR_CONTINUES_WORD(scanner_peekc(scanner, 0)));
+    size_t length = scanner->cursor - start;
+
+    Keyword kw = is_keyword(start, length);
+    if (kw) {
         scanner->token.kw = kw;
         scanner->token.type = TOK_KEYWORD;
     }
     else {
-        scanner->token.value.data =
-            arena_copy(scanner->arena, scanner->buf, scanner->buflen + 1);
-        scanner->token.value.length = scanner->buflen;
+        scanner->token.value = intern_identifier(scanner, start, length);
         scanner->token.type = TOK_IDENTIFIER;
     }
 }
@@ -256,126 +294,186 @@ tokenize_word(Scanner* scanner)
 static inline void
 tokenize_numeric(Scanner* scanner)
 {
-    for (scanner_getc(scanner);
-         CHAR_IS_NUMERIC(scanner->c) || scanner->c == '.' || scanner->c == '_';
-         scanner_getc(scanner)) {
-        if (scanner->c == '_') scanner->buflen--;  // skip `_` such as in `1_000_000`
+    const char* start = scanner->cursor;
+    char c;
+    do {
+        scanner->cursor++;
+        c = scanner_peekc(scanner, 0);
+    } while (CHAR_CLASS(c) == CHAR_DIGIT || c == '.' || c == '_');
+
+    char* data = arena_alloc(scanner->arena, scanner->cursor - start + 1);
+    size_t length = 0;
+    for (const char* p = start; p < scanner->cursor; p++) {
+        if (*p != '_') data[length++] = *p;  // skip `_` such as in `1_000_000`
     }
-    scanner_ungetc(scanner);
-    scanner->buf[scanner->buflen] = '\0';
-    scanner->token.value.data =
-        arena_copy(scanner->arena, scanner->buf, scanner->buflen + 1);
-    scanner->token.value.length = scanner->buflen;
+    data[length] = '\0';
+    scanner->token.value = (SourceString){.data = data, .length = length};
     scanner->token.type = TOK_NUMBER;
 }
 
 static inline void
 tokenize_string_literal(Scanner* scanner)
 {
-    char opening_quote = scanner->c;
-    for (scanner_getc(scanner);
-         scanner->c != opening_quote || scanner->buf[scanner->buflen - 2] == '\\';
-         scanner_getc(scanner)) {
-        if (scanner->c == EOF)
+    char opening_quote = *scanner->cursor++;
+    const char* start = scanner->cursor;
+    for (;;) {
+        if (scanner->cursor == scanner->end)
             syntax_error(
-                *scanner->index, *scanner->token.loc, 0, "unterminated string literal"
+                *scanner->index, scanner->loc, 0, "unterminated string literal"
             );
-        if (scanner->c == opening_quote) {
-            // an escaped version of starting quote
-            // we should overwrite the preceding `\` with this quote
-            scanner->buf[--scanner->buflen - 1] = scanner->c;
-        }
-    }
-    scanner->buf[scanner->buflen - 1] = '\0';
-    scanner->token.value.data =
-        arena_copy(scanner->arena, scanner->buf + 1, scanner->buflen - 1);
-    scanner->token.value.length = scanner->buflen - 2;
+        if (*scanner->cursor == opening_quote) break;
+        // escape sequences are kept as they are and passed on to the C compiler
+        bool escaped = *scanner->cursor == '\\' && scanner_peekc(scanner, 1);
+        scanner->cursor += (escaped) ? 2 : 1;
+    }
+
+    char* data = arena_alloc(scanner->arena, scanner->cursor - start + 1);
+    size_t length = 0;
+    for (const char* p = start; p < scanner->cursor; p++) {
+        // an escaped version of the opening quote is just the quote
+        if (*p == '\\' && p[1] == opening_quote) p++;
+        else if (*p == '\\') data[length++] = *p++;
+        data[length++] = *p;
+    }
+    data[length] = '\0';
+    scanner->cursor++;
+    scanner->token.value = (SourceString){.data = data, .length = length};
     scanner->token.type = TOK_STRING;
 }
 
+// takes the longest operator starting at the cursor, `!` alone is a prefix of `!=` but
+// isn't an operator itself
 static inline void
 tokenize_operator(Scanner* scanner)
 {
-    assert(CHAR_IS_OPERATOR(scanner->c));
-    for (scanner_getc(scanner); CHAR_IS_OPERATOR(scanner->c); scanner_getc(scanner))
-        ;
-    scanner_ungetc(scanner);
-    scanner->buf[scanner->buflen] = '\0';
-    scanner->token.op = op_from_cstr(scanner->buf);
+    unsigned int state = 0;
+    for (;;) {
+        unsigned char c = scanner_peekc(scanner, 0);
+        unsigned int next = OPERATOR_DFA[state][OPERATOR_CHAR_INDEX[c]];
+        if (!next) break;
+        state = next;
+        scanner->cursor++;
+    }
+    if (!OPERATOR_ACCEPTS[state])
+        syntax_error(*scanner->index, scanner->loc, 0, "unexpected token");
+    scanner->token.op = OPERATOR_ACCEPTS[state];
     scanner->token.type = TOK_OPERATOR;
 }
 
-static inline bool
-should_tokenize_newlines(Scanner* scanner)
-{
-    return (
-        scanner->open_parens == 0 && scanner->open_square == 0 && scanner->open_curly == 0
-    );
-}
-
 static void
-scan_token(Scanner* scanner)
+scan_next_token(Scanner* scanner)
 {
-    scanner->buflen = 0;
     memset(&scanner->token, 0, sizeof(Token));
 
-    skip_whitespace(scanner);
-    if (scanner->finished) goto push_token;
-
-    skip_comments(scanner);
+    skip_blanks(scanner);
     if (scanner->finished) goto push_token;
 
-    if (scanner->c == '\n' && !should_tokenize_newlines(scanner)) {
-        file_index_index_line(scanner->index, scanner->file_offset);
-        scanner->loc.line++;
-        scanner->loc.col = 0;
-        scan_token(scanner);
-        return;
-    }
-
     // we're now at the start of a new token
-    scanner->token.loc = arena_alloc(scanner->arena, sizeof(Location));
-    memcpy(scanner->token.loc, &scanner->loc, sizeof(Location));
-
-    if (handle_single_char_tokens(scanner))
-        ;
-    else if (CHAR_IS_ALPHA(scanner->c))
-        tokenize_word(scanner);
-    else if (CHAR_IS_NUMERIC(scanner->c) || scanner->c == '.')
-        tokenize_numeric(scanner);
-    else if (scanner->c == '\'' || scanner->c == '"')
-        tokenize_string_literal(scanner);
-    else {
-        if (!CHAR_IS_OPERATOR(scanner->c)) {
-            syntax_error(*scanner->index, *scanner->token.loc, 0, "unexpected token");
-        }
-        tokenize_operator(scanner);
+    mark_token_start(scanner);
+    switch (CHAR_CLASS(*scanner->cursor)) {
+        case CHAR_ALPHA:
+            tokenize_word(scanner);
+            break;
+        case CHAR_DOT:
+            // `.` followed by a name is attribute access, otherwise a float like `.5`
+            if (CHAR_CLASS(scanner_peekc(scanner, 1)) == CHAR_ALPHA) {
+                scanner->token.type = TOK_DOT;
+                scanner->cursor++;
+                break;
+            }
+            // fall through
+        case CHAR_DIGIT:
+            tokenize_numeric(scanner);
+            break;
+        case CHAR_QUOTE:
+            tokenize_string_literal(scanner);
+            break;
+        case CHAR_NEWLINE:
+            scanner->token.type = TOK_NEWLINE;
+            scan_newline(scanner);
+            break;
+        case CHAR_PUNCTUATION:
+            tokenize_punctuation(scanner);
+            break;
+        case CHAR_OPERATOR:
+            if (*scanner->cursor == '-' && scanner_peekc(scanner, 1) == '>') {
+                scanner->token.type = TOK_ARROW;
+                scanner->cursor += 2;
+                break;
+            }
+            tokenize_operator(scanner);
+            break;
+        default:
+            syntax_error(*scanner->index, scanner->loc, 0, "unexpected token");
     }
 
 push_token:
     if (scanner->token.type == TOK_KEYWORD && scanner->token.kw == KW_ASSERT) {
-        memset(scanner->assert_buf, ' ', scanner->token.loc->col - 1);
-        memcpy(scanner->assert_buf + scanner->token.loc->col - 1, "assert", 6);
-        scanner->assert_buflen += scanner->token.loc->col + 5;
-        scanner->scanning_assert = true;
+        scanner->assert_start = scanner->cursor - (sizeof("assert") - 1);
+        scanner->assert_col = scanner->loc.col;
     }
     tq_push(scanner->tq, scanner->token);
 }
 
+static void
+scan_token(Scanner* scanner)
+{
+    scanner->tokens_count++;
+    if (!scanner->time_scanning) {
+        scan_next_token(scanner);
+        return;
+    }
+    double start = wall_seconds();
+    scan_next_token(scanner);
+    scanner->scan_seconds += wall_seconds() - start;
+}
+
+// the statement as it was written from the `assert` keyword up to what's been scanned
+// with whitespace characters, quotes and backslashes escaped
 static SourceString
 get_assert_source_code(Scanner* scanner)
 {
-    while (memcmp(scanner->assert_buf + scanner->assert_buflen - 2, "\\n", 2) == 0)
-        // knock off any trailing newlines
-        scanner->assert_buflen -= 2;
-
-    scanner->assert_buf[scanner->assert_buflen] = '\0';
-    const char* source_code =
-        arena_copy(scanner->arena, scanner->assert_buf, scanner->assert_buflen + 1);
-    SourceString rtval = {.data = source_code, .length = scanner->assert_buflen};
-    scanner->assert_buflen = 0;
-    scanner->scanning_assert = false;
-    return rtval;
+    assert(scanner->assert_start && "not scanning an assert statement");
+    const char* end = scanner->cursor;
+    // knock off any trailing newlines
+    while (end > scanner->assert_start && end[-1] == '\n') end--;
+
+    size_t indent = scanner->assert_col - 1;
+    size_t length = indent + (end - scanner->assert_start);
+    size_t escapes = 0;
+    for (const char* p = scanner->assert_start; p < end; p++)
+        escapes += (*p == '\n' || *p == '\t' || *p == '\r' || *p == '"' || *p == '\\');
+
+    char* source_code = arena_alloc(scanner->arena, length + escapes + 1);
+    memset(source_code, ' ', indent);
+    char* write = source_code + indent;
+    for (const char* p = scanner->assert_start; p < end; p++) {
+        switch (*p) {
+            case '\n':
+                *write++ = '\\';
+                *write++ = 'n';
+                break;
+            case '\t':
+                *write++ = '\\';
+                *write++ = 't';
+                break;
+            case '\r':
+                *write++ = '\\';
+                *write++ = 'r';
+                break;
+            case '"':
+            case '\\':
+                *write++ = '\\';
+                *write++ = *p;
+                break;
+            default:
+                *write++ = *p;
+        }
+    }
+    *write = '\0';
+    scanner->assert_start = NULL;
+    // the length of the string once the C compiler has unescaped it
+    return (SourceString){.data = source_code, .length = length};
 }
 
 typedef enum {
@@ -399,12 +497,25 @@ typedef struct {
     const char* file_namespace;
     size_t file_namespace_length;
 
+    // names bound by `import module [as name]`
+    SourceString* module_aliases;
+    size_t module_aliases_capacity;
+    size_t module_aliases_count;
+
     AnnotationStatement* current_class_members;
     size_t current_class_members_capacity;
     size_t current_class_members_count;
     size_t current_class_members_defaults_count;
+
+    size_t statements_count;
 } Parser;
 
+static inline Location
+token_loc(Parser* parser, Token token)
+{
+    return file_index_location(parser->scanner->index, token.offset);
+}
+
 static inline ConsumableParserRule
 consume_rule(Parser* parser)
 {
@@ -538,14 +649,19 @@ parse_iterable_identifiers(Parser* parser)
                 break;
             }
             default:
-                syntax_error(*parser->scanner->index, *token.loc, 0, "unexpected token");
+                syntax_error(
+                    *parser->scanner->index,
+                    token_loc(parser, token),
+                    0,
+                    "unexpected token"
+                );
         }
     }
 return_it_group:
     if (vec.count == 0)
         syntax_error(
             *parser->scanner->index,
-            *peek_next_token(parser).loc,
+            token_loc(parser, peek_next_token(parser)),
             0,
             "no identifiers given"
         );
@@ -808,7 +924,7 @@ parse_getitem_arguments(Parser* parser)
     if (peek.type == TOK_CLOSE_SQUARE)
         syntax_error(
             *parser->scanner->index,
-            *peek.loc,
+            token_loc(parser, peek),
             0,
             "some argument is required for the getitem operator"
         );
@@ -831,7 +947,10 @@ parse_getitem_arguments(Parser* parser)
         }
         else {
             syntax_error(
-                *parser->scanner->index, *next.loc, 0, "expected either `:` or `]`"
+                *parser->scanner->index,
+                token_loc(parser, next),
+                0,
+                "expected either `:` or `]`"
             );
         }
     }
@@ -868,7 +987,12 @@ slice_stop_expr:
         goto return_slice_operand;
     }
     else
-        syntax_error(*parser->scanner->index, *next.loc, 0, "expected either `:` or `]`");
+        syntax_error(
+            *parser->scanner->index,
+            token_loc(parser, next),
+            0,
+            "expected either `:` or `]`"
+        );
 slice_step_expr:
     // [...:...:...
     peek = peek_next_token(parser);
@@ -893,7 +1017,11 @@ expect_keyword(Parser* parser, Keyword kw)
     Token tok = get_next_token(parser);
     if (tok.type != TOK_KEYWORD || tok.kw != kw)
         syntax_errorf(
-            *parser->scanner->index, *tok.loc, 0, "expected keyword `%s`", kw_to_cstr(kw)
+            *parser->scanner->index,
+            token_loc(parser, tok),
+            0,
+            "expected keyword `%s`",
+            kw_to_cstr(kw)
         );
     return tok;
 }
@@ -905,7 +1033,7 @@ expect_token_type(Parser* parser, TokenType type)
     if (tok.type != type)
         syntax_errorf(
             *parser->scanner->index,
-            *tok.loc,
+            token_loc(parser, tok),
             0,
             "expected token type `%s`, got `%s`",
             token_type_to_cstr(type),
@@ -914,6 +1042,72 @@ expect_token_type(Parser* parser, TokenType type)
     return tok;
 }
 
+static SourceString
+join_with_dot(Arena* arena, SourceString left, SourceString right)
+{
+    SourceString joined = {.length = left.length + 1 + right.length};
+    char* data = arena_alloc(arena, joined.length + 1);
+    memcpy(data, left.data, left.length);
+    data[left.length] = '.';
+    memcpy(data + left.length + 1, right.data, right.length);
+    joined.data = data;
+    return joined;
+}
+
+static void
+add_module_alias(Parser* parser, SourceString alias)
+{
+    if (parser->module_aliases_count == parser->module_aliases_capacity) {
+        parser->module_aliases_capacity =
+            (parser->module_aliases_capacity) ? parser->module_aliases_capacity * 2 : 4;
+        size_t size = sizeof(SourceString) * parser->module_aliases_capacity;
+        parser->module_aliases =
+            (parser->module_aliases)
+                ? arena_dynamic_realloc(parser->arena, parser->module_aliases, size)
+                : arena_dynamic_alloc(parser->arena, size);
+    }
+    parser->module_aliases[parser->module_aliases_count++] = alias;
+}
+
+typedef enum { ALIAS_NONE, ALIAS_PREFIX, ALIAS_EXACT } AliasMatch;
+
+// `import a.b` binds `a.b` so `a` alone is a prefix of the alias
+static AliasMatch
+match_module_alias(Parser* parser, SourceString identifier)
+{
+    AliasMatch match = ALIAS_NONE;
+    for (size_t i = 0; i < parser->module_aliases_count; i++) {
+        SourceString alias = parser->module_aliases[i];
+        if (SOURCESTRING_EQ(alias, identifier)) return ALIAS_EXACT;
+        if (alias.length > identifier.length && alias.data[identifier.length] == '.' &&
+            memcmp(alias.data, identifier.data, identifier.length) == 0)
+            match = ALIAS_PREFIX;
+    }
+    return match;
+}
+
+// `module.name` is parsed as a single identifier, its symbol is added to the top level
+// scope when the modules of the program are linked together
+static SourceString
+parse_module_member(Parser* parser, SourceString identifier)
+{
+    for (;;) {
+        AliasMatch match = match_module_alias(parser, identifier);
+        if (match == ALIAS_NONE || peek_next_token(parser).type != TOK_DOT)
+            return identifier;
+        discard_next_token(parser);
+        SourceString attr = expect_token_type(parser, TOK_IDENTIFIER).value;
+        identifier = join_with_dot(parser->arena, identifier, attr);
+        if (match == ALIAS_EXACT) return identifier;
+    }
+}
+
+static bool
+is_module_member(SourceString identifier)
+{
+    return memchr(identifier.data, '.', identifier.length) != NULL;
+}
+
 // TODO: might want some kind of lookup table instead of the long switch statements
 // int the future
 static Expression*
@@ -930,11 +1124,13 @@ parse_expression(Parser* parser)
                         if (rule == DISALLOW_CONDITIONAL_EXPRESSION)
                             syntax_error(
                                 *parser->scanner->index,
-                                *tok.loc,
+                                token_loc(parser, tok),
                                 0,
                                 "conditional expression not allowed here"
                             );
-                        et_push_operation_type(&et, OPERATOR_CONDITIONAL_IF, tok.loc);
+                        et_push_operation_type(
+                            &et, OPERATOR_CONDITIONAL_IF, token_loc(parser, tok)
+                        );
 
                         Operand condition_operand = {
                             .kind = OPERAND_EXPRESSION, .expr = parse_expression(parser)};
@@ -942,7 +1138,7 @@ parse_expression(Parser* parser)
 
                         Token else_token = expect_keyword(parser, KW_ELSE);
                         et_push_operation_type(
-                            &et, OPERATOR_CONDITIONAL_ELSE, else_token.loc
+                            &et, OPERATOR_CONDITIONAL_ELSE, token_loc(parser, else_token)
                         );
 
                         Operand else_operand = {
@@ -950,19 +1146,25 @@ parse_expression(Parser* parser)
                         et_push_operand(&et, else_operand);
                         break;
                     case KW_AND:
-                        et_push_operation_type(&et, OPERATOR_LOGICAL_AND, tok.loc);
+                        et_push_operation_type(
+                            &et, OPERATOR_LOGICAL_AND, token_loc(parser, tok)
+                        );
                         break;
                     case KW_OR:
-                        et_push_operation_type(&et, OPERATOR_LOGICAL_OR, tok.loc);
+                        et_push_operation_type(
+                            &et, OPERATOR_LOGICAL_OR, token_loc(parser, tok)
+                        );
                         break;
                     case KW_NOT:
-                        et_push_operation_type(&et, OPERATOR_LOGICAL_NOT, tok.loc);
+                        et_push_operation_type(
+                            &et, OPERATOR_LOGICAL_NOT, token_loc(parser, tok)
+                        );
                         break;
                     case KW_IN:
-                        et_push_operation_type(&et, OPERATOR_IN, tok.loc);
+                        et_push_operation_type(&et, OPERATOR_IN, token_loc(parser, tok));
                         break;
                     case KW_IS:
-                        et_push_operation_type(&et, OPERATOR_IS, tok.loc);
+                        et_push_operation_type(&et, OPERATOR_IS, token_loc(parser, tok));
                         break;
                     case KW_FALSE: {
                         Operand operand = {.kind = OPERAND_TOKEN, .token = tok};
@@ -977,7 +1179,7 @@ parse_expression(Parser* parser)
                     default:
                         syntax_errorf(
                             *parser->scanner->index,
-                            *tok.loc,
+                            token_loc(parser, tok),
                             0,
                             "not expecting keyword `%s` here",
                             kw_to_cstr(tok.kw)
@@ -988,10 +1190,12 @@ parse_expression(Parser* parser)
             case TOK_OPERATOR: {
                 if (tok.op == OPERATOR_MINUS &&
                     (et.previous == ET_NONE || et.previous == ET_OPERATION)) {
-                    et_push_operation_type(&et, OPERATOR_NEGATIVE, tok.loc);
+                    et_push_operation_type(
+                        &et, OPERATOR_NEGATIVE, token_loc(parser, tok)
+                    );
                 }
                 else
-                    et_push_operation_type(&et, tok.op, tok.loc);
+                    et_push_operation_type(&et, tok.op, token_loc(parser, tok));
                 break;
             }
             case TOK_NUMBER: {
@@ -1006,6 +1210,7 @@ parse_expression(Parser* parser)
             }
             case TOK_IDENTIFIER: {
                 Operand operand = {.kind = OPERAND_TOKEN, .token = tok};
+                operand.token.value = parse_module_member(parser, tok.value);
                 et_push_operand(&et, operand);
                 break;
             }
@@ -1013,7 +1218,7 @@ parse_expression(Parser* parser)
                 if (parser->previous.type == TOK_OPERATOR || et.operands_count == 0)
                     et_push_operand(&et, parse_sequence_enclosure(parser));
                 else {
-                    et_push_operation_type(&et, OPERATOR_CALL, tok.loc);
+                    et_push_operation_type(&et, OPERATOR_CALL, token_loc(parser, tok));
                     et_push_operand(&et, parse_arguments(parser));
                 }
                 break;
@@ -1022,7 +1227,9 @@ parse_expression(Parser* parser)
                 if (parser->previous.type == TOK_OPERATOR || et.operands_count == 0)
                     et_push_operand(&et, parse_sequence_enclosure(parser));
                 else {
-                    et_push_operation_type(&et, OPERATOR_GET_ITEM, tok.loc);
+                    et_push_operation_type(
+                        &et, OPERATOR_GET_ITEM, token_loc(parser, tok)
+                    );
                     et_push_operand(&et, parse_getitem_arguments(parser));
                 }
                 break;
@@ -1032,7 +1239,7 @@ parse_expression(Parser* parser)
                 break;
             }
             case TOK_DOT: {
-                et_push_operation_type(&et, OPERATOR_GET_ATTR, tok.loc);
+                et_push_operation_type(&et, OPERATOR_GET_ATTR, token_loc(parser, tok));
                 Operand right = {
                     .kind = OPERAND_TOKEN,
                     .token = expect_token_type(parser, TOK_IDENTIFIER)};
@@ -1040,7 +1247,9 @@ parse_expression(Parser* parser)
                 break;
             }
             default:
-                syntax_error(*parser->scanner->index, *tok.loc, 0, "unexpected token");
+                syntax_error(
+                    *parser->scanner->index, token_loc(parser, tok), 0, "unexpected token"
+                );
         };
     } while (!is_end_of_expression(parser, rule));
 
@@ -1071,16 +1280,22 @@ parse_block(Parser* parser, unsigned int parent_indent)
     for (;;) {
         consume_newline_tokens(parser);
         Token peek = peek_next_token(parser);
-        if (peek.loc->col < first_body_stmt->loc.col) {
-            if (peek.loc->col > parent_indent)
+        if (token_loc(parser, peek).col < first_body_stmt->loc.col) {
+            if (token_loc(parser, peek).col > parent_indent)
                 syntax_error(
-                    *parser->scanner->index, *peek.loc, 2, "inconsistent indentation"
+                    *parser->scanner->index,
+                    token_loc(parser, peek),
+                    2,
+                    "inconsistent indentation"
                 );
             break;
         }
-        if (peek.loc->col > first_body_stmt->loc.col)
+        if (token_loc(parser, peek).col > first_body_stmt->loc.col)
             syntax_error(
-                *parser->scanner->index, *peek.loc, 2, "inconsistent indentation"
+                *parser->scanner->index,
+                token_loc(parser, peek),
+                2,
+                "inconsistent indentation"
             );
         stmt_vector_append(&vec, parse_statement(parser));
     }
@@ -1112,7 +1327,12 @@ parse_import_group(Parser* parser, ImportStatement* stmt)
         discard_next_token(parser);
         Token peek = peek_next_token(parser);
         if (peek.type == TOK_CLOSE_PARENS)
-            syntax_error(*parser->scanner->index, *peek.loc, 0, "empty import statement");
+            syntax_error(
+                *parser->scanner->index,
+                token_loc(parser, peek),
+                0,
+                "empty import statement"
+            );
         end_of_stmt = TOK_CLOSE_PARENS;
     }
     else {
@@ -1145,7 +1365,9 @@ parse_import_group(Parser* parser, ImportStatement* stmt)
             break;
         }
         else
-            syntax_error(*parser->scanner->index, *peek.loc, 0, "unexpected token");
+            syntax_error(
+                *parser->scanner->index, token_loc(parser, peek), 0, "unexpected token"
+            );
     }
 
     stmt->what = str_vector_finalize(&what_vec);
@@ -1165,7 +1387,7 @@ parse_type_hint(Parser* parser)
         if (!sym || sym->kind != SYM_CLASS) {
             type_errorf(
                 *parser->scanner->index,
-                *ident_token.loc,
+                token_loc(parser, ident_token),
                 "unknown class `%s`",
                 ident_token.value.data
             );
@@ -1196,7 +1418,7 @@ parse_type_hint(Parser* parser)
             if (close_sq.type != TOK_CLOSE_SQUARE) {
                 syntax_error(
                     *parser->scanner->index,
-                    *close_sq.loc,
+                    token_loc(parser, close_sq),
                     0,
                     "returning multiple values from functions is not currently "
                     "implemented"
@@ -1283,8 +1505,15 @@ parse_import_statement(Parser* parser)
     Token peek = peek_next_token(parser);
     if (peek.type == TOK_KEYWORD && peek.kw == KW_AS) {
         discard_next_token(parser);
-        import->as = arena_alloc(parser->arena, sizeof(char**));
+        import->as = arena_alloc(parser->arena, sizeof(SourceString));
         import->as[0] = expect_token_type(parser, TOK_IDENTIFIER).value;
+        add_module_alias(parser, import->as[0]);
+    }
+    else {
+        SourceString alias = import->from.dotted_path[0];
+        for (size_t i = 1; i < import->from.path_count; i++)
+            alias = join_with_dot(parser->arena, alias, import->from.dotted_path[i]);
+        add_module_alias(parser, alias);
     }
     return import;
 }
@@ -1307,7 +1536,8 @@ parse_if_statement(Parser* parser, unsigned int indent)
     for (;;) {
         consume_newline_tokens(parser);
         peek = peek_next_token(parser);
-        if (peek.type == TOK_KEYWORD && peek.kw == KW_ELIF && peek.loc->col == indent) {
+        if (peek.type == TOK_KEYWORD && peek.kw == KW_ELIF &&
+            token_loc(parser, peek).col == indent) {
             discard_next_token(parser);
             ElifStatement elif = {0};
             elif.condition = parse_expression(parser);
@@ -1324,7 +1554,8 @@ parse_if_statement(Parser* parser, unsigned int indent)
 
     // maybe there is an else statment,
     // we have the next token in `peek` already
-    if (peek.type == TOK_KEYWORD && peek.kw == KW_ELSE && peek.loc->col == indent) {
+    if (peek.type == TOK_KEYWORD && peek.kw == KW_ELSE &&
+        token_loc(parser, peek).col == indent) {
         discard_next_token(parser);
         expect_token_type(parser, TOK_COLON);
         conditional->else_body = parse_block(parser, indent);
@@ -1351,9 +1582,12 @@ parse_try_statement(Parser* parser, unsigned int indent)
         // start at expect
         consume_newline_tokens(parser);
         Token begin = expect_keyword(parser, KW_EXCEPT);
-        if (begin.loc->col != indent)
+        if (token_loc(parser, begin).col != indent)
             syntax_error(
-                *parser->scanner->index, *begin.loc, 2, "inconsistent indentation"
+                *parser->scanner->index,
+                token_loc(parser, begin),
+                2,
+                "inconsistent indentation"
             );
         // we will need a str vector for exception names
         SourceStringVector exceptions = str_vector_init(parser->arena);
@@ -1382,7 +1616,7 @@ parse_try_statement(Parser* parser, unsigned int indent)
         else {
             syntax_errorf(
                 *parser->scanner->index,
-                *peek.loc,
+                token_loc(parser, peek),
                 0,
                 "unexpected token type (%s) (note bare excepts not "
                 "allowed)",
@@ -1418,12 +1652,13 @@ parse_try_statement(Parser* parser, unsigned int indent)
         except_vector_append(&excepts, except);
         consume_newline_tokens(parser);
         peek = peek_next_token(parser);
-        if (peek.loc->col < indent || peek.type != TOK_KEYWORD || peek.kw != KW_EXCEPT)
+        if (token_loc(parser, peek).col < indent || peek.type != TOK_KEYWORD ||
+            peek.kw != KW_EXCEPT)
             break;
     }
     try_stmt->excepts = except_vector_finalize(&excepts);
     try_stmt->excepts_count = excepts.count;
-    if (peek.loc->col < indent) return try_stmt;
+    if (token_loc(parser, peek).col < indent) return try_stmt;
     // maybe parse else
     if (peek.type == TOK_KEYWORD && peek.kw == KW_ELSE) {
         discard_next_token(parser);
@@ -2116,7 +2351,7 @@ parse_function_statement(Parser* parser, Location loc)
             if (self_token.type != TOK_IDENTIFIER) {
                 syntax_error(
                     *parser->scanner->index,
-                    *self_token.loc,
+                    token_loc(parser, self_token),
                     1,
                     "expecting `self` param for method def"
                 );
@@ -2144,7 +2379,7 @@ parse_function_statement(Parser* parser, Location loc)
         else if (defaults.count > 0) {
             syntax_error(
                 *parser->scanner->index,
-                *param.loc,
+                token_loc(parser, param),
                 1,
                 "non default argument follows default argument"
             );
@@ -2197,7 +2432,6 @@ parse_function_statement(Parser* parser, Location loc)
     func->scope = fn_scope;
     func->body = parse_block(parser, loc.col);
     scope_stack_pop(&parser->scope_stack);
-    symbol_hm_finalize(&fn_scope->hm);
 
     Symbol sym = {.kind = SYM_FUNCTION, .func = func, .identifier = func->name};
     if (parent_scope->kind == SCOPE_CLASS) {
@@ -2325,7 +2559,7 @@ parse_class_statement(Parser* parser, unsigned int indent)
     if (scope_stack_peek(&parser->scope_stack)->kind != SCOPE_TOP) {
         syntax_error(
             *parser->scanner->index,
-            *get_next_token(parser).loc,
+            token_loc(parser, get_next_token(parser)),
             0,
             "class definitions currenly only allowed at top level scope"
         );
@@ -2372,7 +2606,9 @@ parse_assignment_statement(Parser* parser, Expression* assign_to)
     assignment->storage = assign_to;
     assignment->op_type = expect_token_type(parser, TOK_OPERATOR).op;
     assignment->value = parse_expression(parser);
-    if (assignment->op_type == OPERATOR_ASSIGNMENT && assign_to->operations_count == 0) {
+    // assigning to a module member writes to the variable owned by that module
+    if (assignment->op_type == OPERATOR_ASSIGNMENT && assign_to->operations_count == 0 &&
+        !is_module_member(assign_to->operands[0].token.value)) {
         LexicalScope* scope = scope_stack_peek(&parser->scope_stack);
         Variable* var = arena_alloc(parser->arena, sizeof(Variable));
         var->kind = VAR_REGULAR;
@@ -2399,7 +2635,10 @@ parse_annotation_statement(Parser* parser, Location loc, SourceString identifier
     if (peek.type != TOK_NEWLINE) {
         if (peek.type != TOK_OPERATOR && peek.op != OPERATOR_ASSIGNMENT)
             syntax_error(
-                *parser->scanner->index, *peek.loc, 0, "expecting either `newline` or `=`"
+                *parser->scanner->index,
+                token_loc(parser, peek),
+                0,
+                "expecting either `newline` or `=`"
             );
         discard_next_token(parser);
         annotation->initial = parse_expression(parser);
@@ -2470,10 +2709,11 @@ parse_statement(Parser* parser)
 {
     ConsumableParserRule rule = consume_rule(parser);
     Statement* stmt = arena_alloc(parser->arena, sizeof(Statement));
+    parser->statements_count++;
 
     consume_newline_tokens(parser);
     Token peek = peek_next_token(parser);
-    stmt->loc = *peek.loc;
+    stmt->loc = token_loc(parser, peek);
     const char* error =
         indent_check(&parser->indent_stack, stmt->loc, rule == BLOCK_BEGIN);
     if (error) syntax_error(*parser->scanner->index, stmt->loc, 2, error);
@@ -2620,13 +2860,13 @@ parse_statement(Parser* parser)
     return stmt;
 }
 
-#define LEXER_STATEMENTS_CHUNK_SIZE 64
+#define LEXER_STATEMENTS_INITIAL_CAPACITY 64
 
 Lexer
-lex_file(const char* filepath)
+lex_file(const char* filepath, LexerOptions opts)
 {
-    FILE* file = fopen(filepath, "r");
-    if (!file) errorf("failed to open (%s) for reading: %s", filepath, strerror(errno));
+    double start = (opts.time_phases) ? wall_seconds() : 0;
+    SourceMapping source = map_source(filepath);
     Arena* arena = arena_init();
     const char* ns = file_namespace(arena, filepath);
     size_t ns_len = strlen(ns);
@@ -2638,12 +2878,9 @@ lex_file(const char* filepath)
         .index = create_file_index(arena, filepath)};
     Location start_location = {.line = 1, .filepath = filepath};
     TokenQueue tq = {0};
-    Scanner scanner = {
-        .arena = arena,
-        .loc = start_location,
-        .srcfile = file,
-        .index = &lexer.index,
-        .tq = &tq};
+    Scanner scanner =
+        scanner_init(arena, source, start_location, &lexer.index, &tq);
+    scanner.time_scanning = opts.time_phases;
     Parser parser = {
         .arena = arena,
         .scanner = &scanner,
@@ -2652,13 +2889,13 @@ lex_file(const char* filepath)
         .file_namespace_length = ns_len};
     scope_stack_push(&parser.scope_stack, lexer.top_level);
 
-    size_t statements_capacity = LEXER_STATEMENTS_CHUNK_SIZE;
+    size_t statements_capacity = LEXER_STATEMENTS_INITIAL_CAPACITY;
     lexer.statements = malloc(sizeof(Statement) * statements_capacity);
     if (!lexer.statements) error("out of memory");
 
     do {
         if (lexer.n_statements >= statements_capacity) {
-            statements_capacity += LEXER_STATEMENTS_CHUNK_SIZE;
+            statements_capacity *= 2;
             lexer.statements =
                 realloc(lexer.statements, sizeof(Statement) * statements_capacity);
             if (!lexer.statements) error("out of memory");
@@ -2666,9 +2903,15 @@ lex_file(const char* filepath)
         lexer.statements[lexer.n_statements] = parse_statement(&parser);
     } while (lexer.statements[lexer.n_statements++]->kind != STMT_EOF);
     symbol_hm_finalize(&lexer.top_level->hm);
+    if (parser.module_aliases) arena_dynamic_free(arena, parser.module_aliases);
 
-    fclose(file);
+    free(scanner.identifiers.elements);
+    unmap_source(source);
 
+    lexer.tokens_count = scanner.tokens_count;
+    lexer.statements_count = parser.statements_count;
+    lexer.scan_seconds = scanner.scan_seconds;
+    if (opts.time_phases) lexer.lex_seconds = wall_seconds() - start;
     return lexer;
 }
 
@@ -2681,21 +2924,15 @@ lexer_free(Lexer* lexer)
 
 #if DEBUG
 Token*
-tokenize_file(const char* filepath, size_t* token_count)
+tokenize_file(const char* filepath, size_t* token_count, FileIndex* index)
 {
-    FILE* file = fopen(filepath, "r");
-    if (!file) errorf("failed to open (%s) for reading: %s", filepath, strerror(errno));
+    SourceMapping source = map_source(filepath);
 
     Location start_location = {.line = 1, .filepath = filepath};
     TokenQueue tq = {0};
     Arena* arena = arena_init();
-    FileIndex index = create_file_index(arena, filepath);
-    Scanner scanner = {
-        .arena = arena,
-        .loc = start_location,
-        .srcfile = file,
-        .tq = &tq,
-        .index = &index};
+    *index = create_file_index(arena, filepath);
+    Scanner scanner = scanner_init(arena, source, start_location, index, &tq);
 
     size_t count = 0;
     size_t capacity = 64;
@@ -2714,7 +2951,8 @@ tokenize_file(const char* filepath, size_t* token_count)
     } while (scanner.token.type != TOK_EOF);
 
     *token_count = count;
-    fclose(file);
+    free(scanner.identifiers.elements);
+    unmap_source(source);
     return tokens;
 }
 #endif
@@ -19,13 +19,27 @@ typedef struct {
     size_t n_statements;
     Statement** statements;
     LexicalScope* top_level;
+
+    size_t tokens_count;
+    // including those nested within other statements unlike `n_statements`
+    size_t statements_count;
+    // only measured with LexerOptions.time_phases, scanning is interleaved with parsing
+    // so `scan_seconds` is part of `lex_seconds`
+    double scan_seconds;
+    double lex_seconds;
 } Lexer;
 
-Lexer lex_file(const char* filepath);
+typedef struct {
+    // timing every token has a noticeable cost so it's opt in
+    bool time_phases;
+} LexerOptions;
+
+Lexer lex_file(const char* filepath, LexerOptions opts);
 void lexer_free(Lexer* lexer);
 
 #if DEBUG
-Token* tokenize_file(const char* filepath, size_t* token_count);
+// `index` locates the tokens within the file
+Token* tokenize_file(const char* filepath, size_t* token_count, FileIndex* index);
 #endif
 
 #endif
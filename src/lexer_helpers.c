@@ -311,7 +311,7 @@ et_push_operation(ExpressionTable* et, Operation operation)
 }
 
 void
-et_push_operation_type(ExpressionTable* et, Operator op_type, Location* loc)
+et_push_operation_type(ExpressionTable* et, Operator op_type, Location loc)
 {
     Operation operation = {
         .loc = loc,
@@ -121,7 +121,7 @@ typedef struct {
 ExpressionTable et_init(Arena* arena);
 void et_push_operand(ExpressionTable* et, Operand operand);
 void et_push_operation(ExpressionTable* et, Operation operation);
-void et_push_operation_type(ExpressionTable* et, Operator op_type, Location* loc);
+void et_push_operation_type(ExpressionTable* et, Operator op_type, Location loc);
 Expression* et_to_expr(ExpressionTable* et);
 
 NpType cstr_to_python_type(const char* cstr);
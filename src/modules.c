@@ -0,0 +1,446 @@
+// realpath
+#define _XOPEN_SOURCE 700
+
+#include "modules.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "diagnostics.h"
+#include "lexer_helpers.h"
+
+typedef struct {
+    pthread_mutex_t lock;
+    size_t next;
+    size_t count;
+    void (*task)(void* ctx, size_t index);
+    void* ctx;
+} TaskQueue;
+
+static void*
+run_tasks(void* arg)
+{
+    TaskQueue* queue = arg;
+    for (;;) {
+        pthread_mutex_lock(&queue->lock);
+        size_t index = queue->next++;
+        pthread_mutex_unlock(&queue->lock);
+        if (index >= queue->count) return NULL;
+        queue->task(queue->ctx, index);
+    }
+}
+
+void
+run_parallel(size_t count, size_t jobs, void (*task)(void* ctx, size_t index), void* ctx)
+{
+    if (jobs > count) jobs = count;
+    if (jobs <= 1) {
+        for (size_t i = 0; i < count; i++) task(ctx, i);
+        return;
+    }
+
+    TaskQueue queue = {.count = count, .task = task, .ctx = ctx};
+    if (pthread_mutex_init(&queue.lock, NULL) != 0) error("unable to create mutex");
+    pthread_t* threads = malloc(sizeof(pthread_t) * (jobs - 1));
+    if (!threads) error("out of memory");
+
+    // the calling thread works through the queue as well
+    for (size_t i = 0; i < jobs - 1; i++) {
+        int status = pthread_create(threads + i, NULL, run_tasks, &queue);
+        if (status != 0) errorf("unable to create thread (%s)", strerror(status));
+    }
+    run_tasks(&queue);
+    for (size_t i = 0; i < jobs - 1; i++) pthread_join(threads[i], NULL);
+
+    free(threads);
+    pthread_mutex_destroy(&queue.lock);
+}
+
+typedef struct {
+    size_t count;
+    size_t capacity;
+    Module** modules;
+} ModuleList;
+
+static void
+module_list_append(ModuleList* list, Module* module)
+{
+    if (list->count == list->capacity) {
+        list->capacity = (list->capacity) ? list->capacity * 2 : 8;
+        list->modules = realloc(list->modules, sizeof(Module*) * list->capacity);
+        if (!list->modules) error("out of memory");
+    }
+    list->modules[list->count++] = module;
+}
+
+static char*
+copy_cstr(const char* cstr)
+{
+    size_t length = strlen(cstr);
+    char* copy = malloc(length + 1);
+    if (!copy) error("out of memory");
+    memcpy(copy, cstr, length + 1);
+    return copy;
+}
+
+// `importer` is NULL for the entry module
+static Module*
+find_or_add_module(ModuleList* all, char* path, Module* importer)
+{
+    char* real_path = realpath(path, NULL);
+    if (!real_path && importer)
+        errorf(
+            "unable to find module (%s) imported by (%s): %s",
+            path,
+            importer->path,
+            strerror(errno)
+        );
+    if (!real_path) errorf("failed to open (%s) for reading: %s", path, strerror(errno));
+
+    for (size_t i = 0; i < all->count; i++) {
+        if (strcmp(all->modules[i]->real_path, real_path) == 0) {
+            free(real_path);
+            free(path);
+            return all->modules[i];
+        }
+    }
+
+    Module* module = calloc(1, sizeof(Module));
+    if (!module) error("out of memory");
+    module->path = path;
+    module->real_path = real_path;
+    module_list_append(all, module);
+    return module;
+}
+
+// `a.b` imported from `dir/main.np` is found at `dir/a/b.np`
+static char*
+resolve_import_path(const char* importer, ImportPath import_path)
+{
+    const char* slash = strrchr(importer, '/');
+    size_t directory_length = (slash) ? (size_t)(slash - importer) + 1 : 0;
+    const char* extension = strrchr(importer + directory_length, '.');
+    if (!extension) extension = "";
+
+    size_t length = directory_length + strlen(extension);
+    for (size_t i = 0; i < import_path.path_count; i++)
+        length += import_path.dotted_path[i].length + 1;
+
+    char* path = malloc(length + 1);
+    if (!path) error("out of memory");
+    char* write = path;
+    memcpy(write, importer, directory_length);
+    write += directory_length;
+    for (size_t i = 0; i < import_path.path_count; i++) {
+        if (i > 0) *write++ = '/';
+        memcpy(write, import_path.dotted_path[i].data, import_path.dotted_path[i].length);
+        write += import_path.dotted_path[i].length;
+    }
+    strcpy(write, extension);
+    return path;
+}
+
+static void
+add_import(Module* module, Module* imported, Statement* stmt)
+{
+    size_t count = module->imports_count + 1;
+    module->imports = realloc(module->imports, sizeof(Module*) * count);
+    module->import_statements =
+        realloc(module->import_statements, sizeof(Statement*) * count);
+    if (!module->imports || !module->import_statements) error("out of memory");
+    module->imports[module->imports_count] = imported;
+    module->import_statements[module->imports_count++] = stmt;
+}
+
+// imports nested within functions or blocks aren't linked and are reported by the
+// compiler
+static void
+find_imports(ModuleList* all, Module* module)
+{
+    for (size_t i = 0; i < module->lexer.n_statements; i++) {
+        Statement* stmt = module->lexer.statements[i];
+        if (stmt->kind != STMT_IMPORT) continue;
+        char* path = resolve_import_path(module->path, stmt->import->from);
+        add_import(module, find_or_add_module(all, path, module), stmt);
+    }
+}
+
+typedef struct {
+    Module** modules;
+    LexerOptions lexer_opts;
+} LexTask;
+
+static void
+lex_module(void* ctx, size_t index)
+{
+    LexTask* task = ctx;
+    Module* module = task->modules[index];
+    module->lexer = lex_file(module->path, task->lexer_opts);
+}
+
+static void
+order_module(Program* program, Module* module)
+{
+    if (module->ordered) return;
+    if (module->visiting) errorf("circular import of (%s)", module->path);
+    module->visiting = true;
+
+    for (size_t i = 0; i < module->imports_count; i++) {
+        Module* imported = module->imports[i];
+        order_module(program, imported);
+        if (imported->depth + 1 > module->depth) module->depth = imported->depth + 1;
+    }
+
+    module->visiting = false;
+    module->ordered = true;
+    program->modules[program->count++] = module;
+}
+
+static bool
+has_object_type(TypeInfo info)
+{
+    return info.type == NPTYPE_OBJECT;
+}
+
+// an importer declares the symbol itself so object types, which would need the class
+// declared as well, are left out for now
+static bool
+is_exportable(Symbol sym)
+{
+    switch (sym.kind) {
+        case SYM_FUNCTION: {
+            Signature sig = sym.func->sig;
+            if (sym.func->decorator || has_object_type(sig.return_type)) return false;
+            for (size_t i = 0; i < sig.params_count; i++)
+                if (has_object_type(sig.types[i])) return false;
+            return true;
+        }
+        case SYM_VARIABLE:
+            return sym.variable->kind == VAR_REGULAR &&
+                   !has_object_type(sym.variable->type_info);
+        case SYM_GLOBAL:
+            return true;
+        case SYM_CLASS:
+        case SYM_MEMBER:
+            return false;
+    }
+    UNREACHABLE();
+}
+
+// the symbol as it's bound within the importing module
+static Symbol
+export_symbol(Symbol sym, SourceString identifier)
+{
+    switch (sym.kind) {
+        case SYM_FUNCTION:
+            return (Symbol){
+                .kind = SYM_FUNCTION, .identifier = identifier, .func = sym.func};
+        case SYM_VARIABLE:
+            sym.variable->shared = true;
+            return (Symbol){
+                .kind = SYM_GLOBAL, .identifier = identifier, .globalvar = sym.variable};
+        case SYM_GLOBAL:
+            // passed on from a module imported by the module being imported
+            return (Symbol){
+                .kind = SYM_GLOBAL, .identifier = identifier, .globalvar = sym.globalvar};
+        default:
+            UNREACHABLE();
+    }
+}
+
+static SourceString
+prefix_identifier(Arena* arena, SourceString prefix, SourceString identifier)
+{
+    SourceString prefixed = {.length = prefix.length + 1 + identifier.length};
+    char* data = arena_alloc(arena, prefixed.length + 1);
+    memcpy(data, prefix.data, prefix.length);
+    data[prefix.length] = '.';
+    memcpy(data + prefix.length + 1, identifier.data, identifier.length);
+    prefixed.data = data;
+    return prefixed;
+}
+
+static SourceString
+module_alias(Arena* arena, ImportStatement* import)
+{
+    if (import->as) return import->as[0];
+    SourceString alias = import->from.dotted_path[0];
+    for (size_t i = 1; i < import->from.path_count; i++)
+        alias = prefix_identifier(arena, alias, import->from.dotted_path[i]);
+    return alias;
+}
+
+static size_t
+import_symbols(Module* module, Module* imported, Statement* stmt, Symbol** out)
+{
+    Arena* arena = module->lexer.arena;
+    ImportStatement* import = stmt->import;
+    SymbolHashmap* exports = &imported->lexer.top_level->hm;
+
+    // `from module import name [as alias], ...`
+    if (import->what) {
+        *out = arena_alloc(arena, sizeof(Symbol) * import->what_count);
+        for (size_t i = 0; i < import->what_count; i++) {
+            Symbol* sym = symbol_hm_get(exports, import->what[i]);
+            if (!sym)
+                name_errorf(
+                    module->lexer.index,
+                    stmt->loc,
+                    "cannot import `%s` from (%s)",
+                    import->what[i].data,
+                    imported->path
+                );
+            if (!is_exportable(*sym))
+                name_errorf(
+                    module->lexer.index,
+                    stmt->loc,
+                    "importing `%s` is unimplemented, only functions and variables "
+                    "without class types can be imported",
+                    import->what[i].data
+                );
+            SourceString identifier =
+                (import->as[i].data) ? import->as[i] : import->what[i];
+            (*out)[i] = export_symbol(*sym, identifier);
+        }
+        return import->what_count;
+    }
+
+    // `import module [as alias]` binds `alias.name` for everything the module defines
+    SourceString alias = module_alias(arena, import);
+    *out = arena_alloc(arena, sizeof(Symbol) * exports->elements_count);
+    size_t count = 0;
+    for (size_t i = 0; i < exports->elements_count; i++) {
+        Symbol sym = exports->elements[i];
+        // names the module imported with `import` aren't passed on
+        bool module_member = memchr(sym.identifier.data, '.', sym.identifier.length);
+        if (!is_exportable(sym) || module_member) continue;
+        SourceString identifier = prefix_identifier(arena, alias, sym.identifier);
+        (*out)[count++] = export_symbol(sym, identifier);
+    }
+    return count;
+}
+
+// the top level hashmap is finalized by the lexer so it's rebuilt with the imports
+static void
+link_module(Module* module)
+{
+    if (module->imports_count == 0) return;
+
+    SymbolHashmap* top_level = &module->lexer.top_level->hm;
+    SymbolHashmap linked = symbol_hm_init(module->lexer.arena);
+    for (size_t i = 0; i < top_level->elements_count; i++)
+        symbol_hm_put(&linked, top_level->elements[i]);
+
+    for (size_t i = 0; i < module->imports_count; i++) {
+        Statement* stmt = module->import_statements[i];
+        Symbol* symbols;
+        size_t count = import_symbols(module, module->imports[i], stmt, &symbols);
+        for (size_t j = 0; j < count; j++) {
+            if (symbol_hm_get(&linked, symbols[j].identifier))
+                name_errorf(
+                    module->lexer.index,
+                    stmt->loc,
+                    "`%s` is already bound, rebinding imported names is unimplemented",
+                    symbols[j].identifier.data
+                );
+            symbol_hm_put(&linked, symbols[j]);
+        }
+        stmt->import->module_init = module->imports[i]->init_function;
+        stmt->import->symbols = symbols;
+        stmt->import->symbols_count = count;
+    }
+
+    symbol_hm_finalize(&linked);
+    *top_level = linked;
+}
+
+Program
+load_program(const char* entry_path, LexerOptions lexer_opts, size_t jobs)
+{
+    ModuleList all = {0};
+    find_or_add_module(&all, copy_cstr(entry_path), NULL);
+
+    // each pass lexes the modules found by the pass before it
+    size_t lexed = 0;
+    while (lexed < all.count) {
+        size_t found = all.count;
+        LexTask task = {.modules = all.modules + lexed, .lexer_opts = lexer_opts};
+        run_parallel(found - lexed, jobs, lex_module, &task);
+        for (size_t i = lexed; i < found; i++) find_imports(&all, all.modules[i]);
+        lexed = found;
+    }
+
+    for (size_t i = 1; i < all.count; i++) {
+        Lexer* lexer = &all.modules[i]->lexer;
+        for (size_t j = 0; j < i; j++) {
+            if (strcmp(all.modules[j]->lexer.file_namespace, lexer->file_namespace) == 0)
+                errorf(
+                    "modules (%s) and (%s) share a name which is unsupported",
+                    all.modules[j]->path,
+                    all.modules[i]->path
+                );
+        }
+        all.modules[i]->init_function = arena_snprintf(
+            lexer->arena,
+            lexer->file_namespace_length + sizeof("init_module"),
+            "%sinit_module",
+            lexer->file_namespace
+        );
+    }
+
+    Program program = {.modules = malloc(sizeof(Module*) * all.count)};
+    if (!program.modules) error("out of memory");
+    order_module(&program, all.modules[0]);
+    free(all.modules);
+
+    // symbols passed on from one module to the next are linked before they're needed
+    for (size_t i = 0; i < program.count; i++) link_module(program.modules[i]);
+    return program;
+}
+
+typedef struct {
+    Module** modules;
+    CompilerOptions compiler_opts;
+    OptimizerOptions optimizer_opts;
+} CompileTask;
+
+static void
+compile_module(void* ctx, size_t index)
+{
+    CompileTask* task = ctx;
+    Module* module = task->modules[index];
+    CompilerOptions opts = task->compiler_opts;
+    opts.module_init = module->init_function;
+    module->compiled = compile(&module->lexer, opts);
+    optimize(&module->compiled, task->optimizer_opts);
+}
+
+void
+compile_program(
+    Program* program,
+    CompilerOptions compiler_opts,
+    OptimizerOptions optimizer_opts,
+    size_t jobs
+)
+{
+    Module** level = malloc(sizeof(Module*) * program->count);
+    if (!level) error("out of memory");
+    CompileTask task = {
+        .modules = level,
+        .compiler_opts = compiler_opts,
+        .optimizer_opts = optimizer_opts,
+    };
+
+    // the entry module imports every other module directly or indirectly
+    size_t max_depth = program->modules[program->count - 1]->depth;
+    for (size_t depth = 0; depth <= max_depth; depth++) {
+        size_t count = 0;
+        for (size_t i = 0; i < program->count; i++) {
+            if (program->modules[i]->depth == depth) level[count++] = program->modules[i];
+        }
+        run_parallel(count, jobs, compile_module, &task);
+    }
+    free(level);
+}
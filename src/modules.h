@@ -0,0 +1,54 @@
+#ifndef MODULES_H
+#define MODULES_H
+
+#include <stddef.h>
+
+#include "compiler.h"
+#include "lexer.h"
+#include "optimizer.h"
+
+typedef struct Module Module;
+
+struct Module {
+    char* path;
+    // the same module may be imported through different paths
+    char* real_path;
+    Lexer lexer;
+    // one entry per top level import statement
+    size_t imports_count;
+    Module** imports;
+    Statement** import_statements;
+    // the longest chain of imports beneath this module, modules of the same depth never
+    // import one another
+    size_t depth;
+    // called by importers to run the module, NULL for the program's entry module
+    const char* init_function;
+    CompiledInstructions compiled;
+    bool visiting;
+    bool ordered;
+};
+
+typedef struct {
+    size_t count;
+    // every module comes after the modules it imports so the entry module is last
+    Module** modules;
+} Program;
+
+// lexes `entry_path` along with every module it imports on up to `jobs` threads and
+// binds the imported names within each module to the symbols of the imported modules
+Program load_program(const char* entry_path, LexerOptions lexer_opts, size_t jobs);
+// modules are compiled once the modules they import are, so the C names and types of
+// imported symbols are known by the time they're used
+void compile_program(
+    Program* program,
+    CompilerOptions compiler_opts,
+    OptimizerOptions optimizer_opts,
+    size_t jobs
+);
+
+// calls `task` once for every index below `count` spread over up to `jobs` threads
+void run_parallel(
+    size_t count, size_t jobs, void (*task)(void* ctx, size_t index), void* ctx
+);
+
+#endif
@@ -1,3 +1,5 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <not_python.h>
 #include <np_hash.h>
 #include <stdarg.h>
@@ -5,6 +7,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "syntax.h"
 
@@ -238,6 +241,136 @@ builtin_print(size_t argc, ...)
     return NULL;
 }
 
+#define STATS_ENV "NP_STATS"
+// lookups that examined 1, 2, 3-4, 5-8 ... slots of the lookup table
+#define STATS_PROBE_BUCKETS 8
+
+typedef struct {
+    uint64_t dict_grows;
+    uint64_t dict_shrinks;
+    uint64_t dict_rehashed_items;
+    uint64_t dict_tombstones_cleared;
+    // rehashes where the items array held more removed items than live ones
+    uint64_t dict_tombstone_heavy_rehashes;
+    double dict_worst_tombstone_ratio;
+    uint64_t dict_lookups;
+    uint64_t dict_probes;
+    uint64_t dict_longest_probe;
+    uint64_t dict_probe_histogram[STATS_PROBE_BUCKETS];
+    uint64_t list_grows;
+    uint64_t list_shrinks;
+    uint64_t list_realloc_bytes;
+    uint64_t list_moves;
+    uint64_t list_moved_bytes;
+} RuntimeStats;
+
+int np_stats_enabled = -1;
+static RuntimeStats stats = {0};
+
+static void
+stats_report(void)
+{
+    fprintf(stderr, "\n" STATS_ENV ":\n");
+    fprintf(
+        stderr,
+        "dict: %llu grows, %llu shrinks, %llu items rehashed\n",
+        (unsigned long long)stats.dict_grows,
+        (unsigned long long)stats.dict_shrinks,
+        (unsigned long long)stats.dict_rehashed_items
+    );
+    fprintf(
+        stderr,
+        "dict tombstones: %llu cleared by rehashes, %.1f%% of the items at worst, %llu "
+        "rehashes with more tombstones than items\n",
+        (unsigned long long)stats.dict_tombstones_cleared,
+        stats.dict_worst_tombstone_ratio * 100,
+        (unsigned long long)stats.dict_tombstone_heavy_rehashes
+    );
+    fprintf(
+        stderr,
+        "dict lookups: %llu, %.2f slots probed on average, %llu at most\n",
+        (unsigned long long)stats.dict_lookups,
+        (stats.dict_lookups) ? (double)stats.dict_probes / stats.dict_lookups : 0.0,
+        (unsigned long long)stats.dict_longest_probe
+    );
+    for (size_t i = 0; i < STATS_PROBE_BUCKETS; i++) {
+        if (!stats.dict_probe_histogram[i]) continue;
+        char label[32];
+        size_t low = (i == 0) ? 1 : ((size_t)1 << (i - 1)) + 1;
+        size_t high = (size_t)1 << i;
+        if (i == STATS_PROBE_BUCKETS - 1)
+            snprintf(label, sizeof(label), "%zu+", low);
+        else if (low == high)
+            snprintf(label, sizeof(label), "%zu", low);
+        else
+            snprintf(label, sizeof(label), "%zu-%zu", low, high);
+        fprintf(
+            stderr,
+            "  %8s slots: %12llu %6.1f%%\n",
+            label,
+            (unsigned long long)stats.dict_probe_histogram[i],
+            (double)stats.dict_probe_histogram[i] * 100 / stats.dict_lookups
+        );
+    }
+    fprintf(
+        stderr,
+        "list: %llu grows, %llu shrinks, %llu bytes reallocated\n",
+        (unsigned long long)stats.list_grows,
+        (unsigned long long)stats.list_shrinks,
+        (unsigned long long)stats.list_realloc_bytes
+    );
+    fprintf(
+        stderr,
+        "list inserts and dels: %llu moving %llu bytes\n",
+        (unsigned long long)stats.list_moves,
+        (unsigned long long)stats.list_moved_bytes
+    );
+}
+
+// NP_STATS is read by the first container operation that's counted
+static bool
+stats_on(void)
+{
+    if (np_stats_enabled < 0) {
+        const char* env = getenv(STATS_ENV);
+        np_stats_enabled = env && *env && strcmp(env, "0") != 0;
+        if (np_stats_enabled) atexit(stats_report);
+    }
+    return np_stats_enabled;
+}
+
+static void
+stats_dict_probe(uint64_t probes)
+{
+    size_t bucket = 0;
+    while (bucket < STATS_PROBE_BUCKETS - 1 && probes > ((uint64_t)1 << bucket)) bucket++;
+    stats.dict_lookups += 1;
+    stats.dict_probes += probes;
+    stats.dict_probe_histogram[bucket] += 1;
+    if (probes > stats.dict_longest_probe) stats.dict_longest_probe = probes;
+}
+
+static void
+stats_dict_rehash(NpDict* dict)
+{
+    size_t items = dict->count + dict->tombstone_count;
+    stats.dict_rehashed_items += dict->count;
+    stats.dict_tombstones_cleared += dict->tombstone_count;
+    if (dict->tombstone_count > dict->count) stats.dict_tombstone_heavy_rehashes += 1;
+    if (items) {
+        double ratio = (double)dict->tombstone_count / items;
+        if (ratio > stats.dict_worst_tombstone_ratio)
+            stats.dict_worst_tombstone_ratio = ratio;
+    }
+}
+
+static void
+stats_list_move(size_t bytes)
+{
+    stats.list_moves += 1;
+    stats.list_moved_bytes += bytes;
+}
+
 #define LIST_COPY_TO_OUT(list, index, out)                                               \
     memcpy(out, list->data + index * list->element_size, list->element_size)
 #define LIST_COPY_FROM_ITEM(list, index, item)                                           \
@@ -333,8 +466,13 @@ np_list_extend(NpList* list, NpList* other)
 {
     NpInt required_capacity = list->count + other->count + 1;
     if (list->capacity < required_capacity) {
-        np_realloc(list->data, list->element_size * required_capacity);
+        list->data = np_realloc(list->data, list->element_size * required_capacity);
         if (global_exception) return NULL;
+        list->capacity = required_capacity;
+        if (stats_on()) {
+            stats.list_grows += 1;
+            stats.list_realloc_bytes += list->element_size * list->capacity;
+        }
     }
     memcpy(
         list->data + list->element_size * list->count,
@@ -353,17 +491,23 @@ np_list_shrink(NpList* list)
     if (new_capacity < LIST_MIN_CAPACITY) new_capacity = LIST_MIN_CAPACITY;
     list->capacity = new_capacity;
     list->data = np_realloc(list->data, list->element_size * list->capacity);
+    if (stats_on()) {
+        stats.list_shrinks += 1;
+        stats.list_realloc_bytes += list->element_size * list->capacity;
+    }
 }
 
 void
 np_list_del(NpList* list, NpInt index)
 {
     // assume bounds checking has already occured
+    size_t moved = list->element_size * (list->count - index - 1);
     memmove(
         list->data + (list->element_size * index),
         list->data + (list->element_size * (index + 1)),
-        list->element_size * (list->count - index + 1)
+        moved
     );
+    if (stats_on()) stats_list_move(moved);
     list->count -= 1;
     if (list->count <= list->capacity * LIST_SHRINK_THRESHOLD) np_list_shrink(list);
 }
@@ -373,6 +517,10 @@ np_list_grow(NpList* list)
 {
     list->capacity *= 2;
     list->data = np_realloc(list->data, list->element_size * list->capacity);
+    if (stats_on()) {
+        stats.list_grows += 1;
+        stats.list_realloc_bytes += list->element_size * list->capacity;
+    }
 }
 
 void*
@@ -430,17 +578,11 @@ np_list_pop(NpList* list, NpInt index, void* out)
 NpInt
 np_list_index(NpList* list, void* item)
 {
-    NpInt location = -1;
     for (NpInt index = 0; index < list->count; index++) {
-        if (list->cmp_fn(item, LIST_ELEMENT(list, index))) {
-            location = (NpInt)index;
-        }
+        if (list->cmp_fn(item, LIST_ELEMENT(list, index))) return index;
     }
-    if (location < 0) {
-        value_error();
-        return 0;
-    }
-    return location;
+    value_error();
+    return 0;
 }
 
 void*
@@ -470,12 +612,14 @@ np_list_insert(NpList* list, NpInt index, void* item)
     if (list->count == list->capacity - 1) np_list_grow(list);
     if (global_exception) return NULL;
 
+    size_t moved = list->element_size * (list->count - index);
     list->count += 1;
     memmove(
         list->data + (list->element_size * (index + 1)),
         list->data + (list->element_size * index),
-        list->element_size * (list->count - index)
+        moved
     );
+    if (stats_on()) stats_list_move(moved);
     LIST_COPY_FROM_ITEM(list, index, item);
     return NULL;
 }
@@ -781,18 +925,34 @@ np_dict_clear(NpDict* dict)
 
 #define DICT_EFFECTIVE_COUNT(dict) dict->count + dict->tombstone_count
 #define DICT_FULL(dict) DICT_EFFECTIVE_COUNT(dict) == dict->capacity
+#define DICT_SHOULD_SHRINK(dict)                                                         \
+    (dict->capacity > DICT_MIN_CAPACITY &&                                               \
+     dict->count < dict->capacity * DICT_SHRINK_THRESHOLD)
 #define DICT_KEY_AT(dict, idx) dict->data + (idx * dict->item_size) + dict->key_offset
 
+// strings are equal by their characters rather than by the bytes of the NpString
+uint64_t
+np_dict_hash_key(NpDict* dict, void* key)
+{
+    if (dict->keycmp == np_void_str_eq) {
+        NpString* str = key;
+        return hash_bytes(str->data + str->offset, str->length);
+    }
+    return hash_bytes(key, dict->key_size);
+}
+
 size_t
 np_dict_find_lut_location(NpDict* dict, void* key, int* lut_value)
 {
-    uint64_t hash = hash_bytes(key, dict->key_size);
+    uint64_t hash = np_dict_hash_key(dict, key);
     size_t probe = hash % dict->lut_capacity;
 
-    for (;;) {
+    for (uint64_t probes = 1;; probes++) {
         int index = dict->lut[probe];
-        if (index < 0 || dict->keycmp(key, DICT_KEY_AT(dict, index))) {
+        if (index == DICT_LUT_EMPTY ||
+            (index >= 0 && dict->keycmp(key, DICT_KEY_AT(dict, index)))) {
             *lut_value = index;
+            if (stats_on()) stats_dict_probe(probes);
             return probe;
         }
         probe = (probe + 1) % dict->lut_capacity;
@@ -802,7 +962,7 @@ np_dict_find_lut_location(NpDict* dict, void* key, int* lut_value)
 void
 np_dict_lut_rehash_item(NpDict* dict, void* key, size_t item_index)
 {
-    uint64_t hash = hash_bytes(key, dict->key_size);
+    uint64_t hash = np_dict_hash_key(dict, key);
     size_t probe = hash % dict->lut_capacity;
 
     for (;;) {
@@ -818,9 +978,13 @@ np_dict_lut_rehash_item(NpDict* dict, void* key, size_t item_index)
 void
 np_dict_grow(NpDict* dict)
 {
+    if (stats_on()) {
+        stats.dict_grows += 1;
+        stats_dict_rehash(dict);
+    }
     dict->capacity *= DICT_GROW_FACTOR;
     dict->lut_capacity *= DICT_GROW_FACTOR;
-    dict->data = np_realloc(dict->data, sizeof(dict->item_size) * dict->capacity);
+    dict->data = np_realloc(dict->data, dict->item_size * dict->capacity);
     if (global_exception) return;
     dict->lut = np_realloc(dict->lut, sizeof(int) * dict->lut_capacity);
     if (global_exception) return;
@@ -857,11 +1021,15 @@ np_dict_grow(NpDict* dict)
 void
 np_dict_shrink(NpDict* dict)
 {
+    if (stats_on()) {
+        stats.dict_shrinks += 1;
+        stats_dict_rehash(dict);
+    }
     dict->capacity *= DICT_SHRINK_FACTOR;
     if (dict->capacity < DICT_MIN_CAPACITY) dict->capacity = DICT_MIN_CAPACITY;
     dict->lut_capacity = dict->capacity * DICT_LUT_FACTOR;
     uint8_t* old_data = dict->data;
-    dict->data = np_alloc(sizeof(dict->item_size) * dict->capacity);
+    dict->data = np_alloc(dict->item_size * dict->capacity);
     if (global_exception) return;
     dict->lut = np_realloc(dict->lut, sizeof(int) * dict->lut_capacity);
     if (global_exception) return;
@@ -961,12 +1129,11 @@ np_dict_pop_val(NpDict* dict, void* key, void* out)
             dict->data + (dict->item_size * item_index) + dict->val_offset,
             dict->val_size
         );
-        dict->lut[lut_index] = -1;
+        dict->lut[lut_index] = DICT_LUT_REMOVED;
         dict->data[dict->item_size * item_index] = 0;
         dict->tombstone_count += 1;
         dict->count -= 1;
-        if (DICT_EFFECTIVE_COUNT(dict) >= dict->capacity * DICT_SHRINK_THRESHOLD)
-            np_dict_shrink(dict);
+        if (DICT_SHOULD_SHRINK(dict)) np_dict_shrink(dict);
     }
     return NULL;
 }
@@ -980,13 +1147,15 @@ np_dict_del(NpDict* dict, void* key)
     }
     int item_index;
     size_t lut_index = np_dict_find_lut_location(dict, key, &item_index);
-    if (item_index < 0) key_error();
-    dict->lut[lut_index] = -1;
+    if (item_index < 0) {
+        key_error();
+        return;
+    }
+    dict->lut[lut_index] = DICT_LUT_REMOVED;
     dict->data[dict->item_size * item_index] = 0;
     dict->tombstone_count += 1;
     dict->count -= 1;
-    if (DICT_EFFECTIVE_COUNT(dict) >= dict->capacity * DICT_SHRINK_THRESHOLD)
-        np_dict_shrink(dict);
+    if (DICT_SHOULD_SHRINK(dict)) np_dict_shrink(dict);
 }
 
 void*
@@ -1008,9 +1177,158 @@ np_dict_update(NpDict* dict, NpDict* other)
 // allocs are coming from -- eventually these will need to be garbage collected
 // Until I get around to implementing that all python allocs will leak
 
+#define ALLOC_TOP_ENV "NP_ALLOC_TOP"
+#define ALLOC_TOP_DEFAULT 20
+
+// traced allocations are preceded by the site they're attributed to and their size so
+// the live bytes can be taken off that site when they're freed
+typedef union {
+    struct {
+        NpAllocSite* site;
+        size_t bytes;
+    };
+    max_align_t align;
+} AllocHeader;
+
+NpAllocSite* np_alloc_site = NULL;
+static bool alloc_tracing = false;
+static NpAllocSite* alloc_sites = NULL;
+// anything allocated before the program has set a site
+static NpAllocSite unattributed_site = {.file = "<runtime>"};
+
+static void
+alloc_site_record(NpAllocSite* site, size_t bytes)
+{
+    if (site->count == 0) {
+        site->next = alloc_sites;
+        alloc_sites = site;
+    }
+    site->count += 1;
+    site->bytes += bytes;
+    site->live_bytes += bytes;
+    if (site->live_bytes > site->peak_live_bytes)
+        site->peak_live_bytes = site->live_bytes;
+}
+
+static int
+alloc_site_location_cmp(const void* a, const void* b)
+{
+    const NpAllocSite* x = *(NpAllocSite* const*)a;
+    const NpAllocSite* y = *(NpAllocSite* const*)b;
+    int cmp = strcmp(x->file, y->file);
+    if (cmp) return cmp;
+    return (x->line > y->line) - (x->line < y->line);
+}
+
+static int
+alloc_site_bytes_cmp(const void* a, const void* b)
+{
+    const NpAllocSite* x = *(NpAllocSite* const*)a;
+    const NpAllocSite* y = *(NpAllocSite* const*)b;
+    return (x->bytes < y->bytes) - (x->bytes > y->bytes);
+}
+
+// a line may be given more than one site by the generated code, they're merged into
+// the first so the report has one row per line
+static void
+alloc_report(void)
+{
+    size_t count = 0;
+    for (NpAllocSite* site = alloc_sites; site; site = site->next) count++;
+    NpAllocSite** sorted = malloc(sizeof(NpAllocSite*) * count);
+    if (!sorted) return;
+    count = 0;
+    for (NpAllocSite* site = alloc_sites; site; site = site->next) sorted[count++] = site;
+    qsort(sorted, count, sizeof(NpAllocSite*), alloc_site_location_cmp);
+
+    size_t merged = 0;
+    uint64_t allocs = 0, bytes = 0, live_bytes = 0;
+    for (size_t i = 0; i < count; i++) {
+        NpAllocSite* site = sorted[i];
+        allocs += site->count;
+        bytes += site->bytes;
+        live_bytes += site->live_bytes;
+        if (merged > 0 && alloc_site_location_cmp(sorted + merged - 1, &site) == 0) {
+            NpAllocSite* into = sorted[merged - 1];
+            into->count += site->count;
+            into->bytes += site->bytes;
+            into->live_bytes += site->live_bytes;
+            into->peak_live_bytes += site->peak_live_bytes;
+        }
+        else
+            sorted[merged++] = site;
+    }
+    qsort(sorted, merged, sizeof(NpAllocSite*), alloc_site_bytes_cmp);
+
+    size_t top = ALLOC_TOP_DEFAULT;
+    const char* top_env = getenv(ALLOC_TOP_ENV);
+    if (top_env && *top_env) top = strtoul(top_env, NULL, 10);
+    if (top > merged) top = merged;
+
+    fprintf(
+        stderr,
+        "\nallocations: %llu totalling %llu bytes from %zu lines, %llu bytes live\n",
+        (unsigned long long)allocs,
+        (unsigned long long)bytes,
+        merged,
+        (unsigned long long)live_bytes
+    );
+    fprintf(
+        stderr,
+        "%-40s %12s %14s %14s %14s\n",
+        "site",
+        "allocs",
+        "bytes",
+        "live bytes",
+        "peak live"
+    );
+    for (size_t i = 0; i < top; i++) {
+        NpAllocSite* site = sorted[i];
+        char location[256];
+        snprintf(location, sizeof(location), "%s:%u", site->file, site->line);
+        fprintf(
+            stderr,
+            "%-40s %12llu %14llu %14llu %14llu\n",
+            location,
+            (unsigned long long)site->count,
+            (unsigned long long)site->bytes,
+            (unsigned long long)site->live_bytes,
+            (unsigned long long)site->peak_live_bytes
+        );
+    }
+    free(sorted);
+}
+
+void
+np_alloc_trace_start(void)
+{
+    alloc_tracing = true;
+    atexit(alloc_report);
+}
+
+void*
+np_alloc_traced(size_t bytes, NpAllocSite* site)
+{
+    AllocHeader* header = calloc(1, sizeof(AllocHeader) + bytes);
+    if (!header) {
+        memory_error();
+        return NULL;
+    }
+    if (!site) site = &unattributed_site;
+    header->site = site;
+    header->bytes = bytes;
+    alloc_site_record(site, bytes);
+    return header + 1;
+}
+
+// TODO: these are just stubs for now so I can keep track of where python
+// allocs are coming from -- eventually these will need to be garbage collected
+// Until I get around to implementing that all python allocs will leak
+
 void*
 np_alloc(size_t bytes)
 {
+    if (alloc_tracing) return np_alloc_traced(bytes, np_alloc_site);
     void* ptr = calloc(1, bytes);
     if (!ptr) memory_error();
     return ptr;
@@ -1018,6 +1336,23 @@ np_alloc(size_t bytes)
 void*
 np_realloc(void* ptr, size_t bytes)
 {
+    if (alloc_tracing) {
+        // the new size is attributed to the site that grew it
+        AllocHeader* header = NULL;
+        if (ptr) {
+            header = (AllocHeader*)ptr - 1;
+            header->site->live_bytes -= header->bytes;
+        }
+        header = realloc(header, sizeof(AllocHeader) + bytes);
+        if (!header) {
+            memory_error();
+            return NULL;
+        }
+        header->site = (np_alloc_site) ? np_alloc_site : &unattributed_site;
+        header->bytes = bytes;
+        alloc_site_record(header->site, bytes);
+        return header + 1;
+    }
     void* newptr = realloc(ptr, bytes);
     if (!newptr) memory_error();
     return newptr;
@@ -1025,5 +1360,142 @@ np_realloc(void* ptr, size_t bytes)
 void
 np_free(void* ptr)
 {
+    if (alloc_tracing && ptr) {
+        AllocHeader* header = (AllocHeader*)ptr - 1;
+        header->site->live_bytes -= header->bytes;
+        free(header);
+        return;
+    }
     free(ptr);
 }
+
+#define PROFILE_OUT_ENV "NP_PROFILE_OUT"
+#define PROFILE_OUT_DEFAULT "np_profile.json"
+
+static NpProfileEntry* profile_entries = NULL;
+static NpProfileFrame* profile_current = NULL;
+
+static uint64_t
+profile_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static int
+profile_entry_cmp(const void* a, const void* b)
+{
+    const NpProfileEntry* x = *(NpProfileEntry* const*)a;
+    const NpProfileEntry* y = *(NpProfileEntry* const*)b;
+    return (x->exclusive_ns < y->exclusive_ns) - (x->exclusive_ns > y->exclusive_ns);
+}
+
+static void
+profile_write_json(NpProfileEntry** sorted, size_t count, const char* path)
+{
+    FILE* out = fopen(path, "w");
+    if (!out) {
+        fprintf(stderr, "profile: couldn't open %s for writing\n", path);
+        return;
+    }
+    fprintf(out, "{\"functions\": [");
+    for (size_t i = 0; i < count; i++) {
+        NpProfileEntry* entry = sorted[i];
+        fprintf(
+            out,
+            "%s\n  {\"name\": \"%s\", \"symbol\": \"%s\", \"calls\": %llu, "
+            "\"inclusive_ns\": %llu, \"exclusive_ns\": %llu}",
+            (i) ? "," : "",
+            entry->name,
+            entry->symbol,
+            (unsigned long long)entry->calls,
+            (unsigned long long)entry->inclusive_ns,
+            (unsigned long long)entry->exclusive_ns
+        );
+    }
+    fprintf(out, "\n]}\n");
+    fclose(out);
+}
+
+// functions are sorted by the time spent in their own bodies
+static void
+profile_report(void)
+{
+    size_t count = 0;
+    uint64_t total_ns = 0;
+    for (NpProfileEntry* entry = profile_entries; entry; entry = entry->next) {
+        total_ns += entry->exclusive_ns;
+        count++;
+    }
+    NpProfileEntry** sorted = malloc(sizeof(NpProfileEntry*) * count);
+    if (!sorted) return;
+    count = 0;
+    for (NpProfileEntry* entry = profile_entries; entry; entry = entry->next)
+        sorted[count++] = entry;
+    qsort(sorted, count, sizeof(NpProfileEntry*), profile_entry_cmp);
+
+    const char* path = getenv(PROFILE_OUT_ENV);
+    if (!path || !*path) path = PROFILE_OUT_DEFAULT;
+
+    fprintf(
+        stderr,
+        "\nprofile: %.3f ms in %zu functions, written to %s\n",
+        (double)total_ns / 1e6,
+        count,
+        path
+    );
+    fprintf(
+        stderr,
+        "%-32s %12s %12s %12s %7s\n",
+        "function",
+        "calls",
+        "incl ms",
+        "excl ms",
+        "excl %"
+    );
+    for (size_t i = 0; i < count; i++) {
+        NpProfileEntry* entry = sorted[i];
+        fprintf(
+            stderr,
+            "%-32s %12llu %12.3f %12.3f %6.1f%%\n",
+            entry->name,
+            (unsigned long long)entry->calls,
+            (double)entry->inclusive_ns / 1e6,
+            (double)entry->exclusive_ns / 1e6,
+            (total_ns) ? (double)entry->exclusive_ns * 100 / (double)total_ns : 0.0
+        );
+    }
+    profile_write_json(sorted, count, path);
+    free(sorted);
+}
+
+void
+np_profile_enter(NpProfileEntry* entry, NpProfileFrame* frame)
+{
+    // entries are registered by the first call to their function
+    if (entry->calls == 0) {
+        if (!profile_entries) atexit(profile_report);
+        entry->next = profile_entries;
+        profile_entries = entry;
+    }
+    entry->calls += 1;
+    entry->active += 1;
+    *frame = (NpProfileFrame){
+        .entry = entry,
+        .parent = profile_current,
+        .start_ns = profile_now_ns(),
+    };
+    profile_current = frame;
+}
+
+void
+np_profile_exit(NpProfileFrame* frame)
+{
+    uint64_t elapsed = profile_now_ns() - frame->start_ns;
+    NpProfileEntry* entry = frame->entry;
+    entry->exclusive_ns += elapsed - frame->children_ns;
+    if (--entry->active == 0) entry->inclusive_ns += elapsed;
+    if (frame->parent) frame->parent->children_ns += elapsed;
+    profile_current = frame->parent;
+}
@@ -21,6 +21,31 @@ void* np_alloc(size_t bytes);
 void* np_realloc(void* ptr, size_t bytes);
 void np_free(void* ptr);
 
+// programs built with `npc --trace-allocs` point `np_alloc_site` at the line they're
+// running so the allocations the runtime makes on its behalf are attributed to it too
+typedef struct NpAllocSite NpAllocSite;
+struct NpAllocSite {
+    const char* file;
+    unsigned int line;
+    uint64_t count;
+    uint64_t bytes;
+    uint64_t live_bytes;
+    uint64_t peak_live_bytes;
+    // sites are registered by their first allocation
+    NpAllocSite* next;
+};
+
+extern NpAllocSite* np_alloc_site;
+// must be called before anything is allocated, the report is printed at exit
+void np_alloc_trace_start(void);
+void* np_alloc_traced(size_t bytes, NpAllocSite* site);
+
+#define NP_ALLOC_SITE(file_, line_)                                                      \
+    do {                                                                                 \
+        static NpAllocSite site_ = {.file = file_, .line = line_};                       \
+        np_alloc_site = &site_;                                                          \
+    } while (0)
+
 NpBool np_int_eq(NpInt int1, NpInt int2);
 NpBool np_float_eq(NpFloat float1, NpFloat float2);
 NpBool np_bool_eq(NpBool bool1, NpBool bool2);
@@ -114,6 +139,9 @@ typedef struct {
 #define DICT_GROW_FACTOR 2
 #define DICT_SHRINK_THRESHOLD 0.35
 #define DICT_SHRINK_FACTOR 0.5
+// an empty slot of the lookup table ends a probe, that of a removed item is probed past
+#define DICT_LUT_EMPTY -1
+#define DICT_LUT_REMOVED -2
 
 typedef NpBool (*NpDictKeyCmpFunc)(const void* key1, const void* key2);
 
@@ -142,6 +170,7 @@ NpIter np_dict_iter_vals(NpDict* dict);
 NpIter np_dict_iter_items(NpDict* dict);
 
 NpDict* np_dict_init(size_t key_size, size_t val_size, NpDictKeyCmpFunc cmp);
+uint64_t np_dict_hash_key(NpDict* dict, void* key);
 NpDict* np_dict_copy(NpDict* other);
 NpNone np_dict_clear(NpDict* dict);
 void np_dict_set_item(NpDict* dict, void* key, void* val);
@@ -223,4 +252,34 @@ typedef struct {
 
 void* builtin_print(size_t argc, ...);
 
+// programs built with `npc --profile` give every function an entry that's reported when
+// the program exits, the frames live on the stack of the function being timed
+typedef struct NpProfileEntry NpProfileEntry;
+struct NpProfileEntry {
+    const char* name;
+    // the name of the C function so the entry can be matched up with a perf report
+    const char* symbol;
+    uint64_t calls;
+    uint64_t inclusive_ns;
+    uint64_t exclusive_ns;
+    // recursive calls only count toward the inclusive time of the outermost call
+    uint64_t active;
+    NpProfileEntry* next;
+};
+
+typedef struct NpProfileFrame NpProfileFrame;
+struct NpProfileFrame {
+    NpProfileEntry* entry;
+    NpProfileFrame* parent;
+    uint64_t start_ns;
+    uint64_t children_ns;
+};
+
+void np_profile_enter(NpProfileEntry* entry, NpProfileFrame* frame);
+void np_profile_exit(NpProfileFrame* frame);
+
+// set by the first counted container operation from the NP_STATS environment variable,
+// -1 until then, the containers are counted and summarized at exit when it's set
+extern int np_stats_enabled;
+
 #endif
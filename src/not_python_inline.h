@@ -0,0 +1,82 @@
+#ifndef NOT_PYTHON_INLINE_H
+#define NOT_PYTHON_INLINE_H
+
+// Included by optimized builds in place of not_python.h so the C compiler can inline
+// the common case of the hottest runtime functions into the generated code. Anything
+// that isn't the common case (negative indices, errors, growing) falls back to the
+// definition in the runtime library.
+
+#include <not_python.h>
+#include <np_hash.h>
+#include <string.h>
+
+static inline NpBool
+np_str_eq_inline(NpString str1, NpString str2)
+{
+    return str1.length == str2.length &&
+           memcmp(str1.data + str1.offset, str2.data + str2.offset, str1.length) == 0;
+}
+
+static inline void
+np_list_get_item_inline(NpList* list, NpInt index, void* out)
+{
+    if ((NpUnsigned)index < (NpUnsigned)list->count) {
+        memcpy(out, list->data + index * list->element_size, list->element_size);
+        return;
+    }
+    (np_list_get_item)(list, index, out);
+}
+
+static inline void
+np_list_set_item_inline(NpList* list, NpInt index, void* item)
+{
+    if ((NpUnsigned)index < (NpUnsigned)list->count) {
+        memcpy(list->data + index * list->element_size, item, list->element_size);
+        return;
+    }
+    (np_list_set_item)(list, index, item);
+}
+
+static inline NpNone
+np_list_append_inline(NpList* list, void* item)
+{
+    if (list->count + 1 < list->capacity) {
+        memcpy(list->data + list->count++ * list->element_size, item, list->element_size);
+        return NULL;
+    }
+    return (np_list_append)(list, item);
+}
+
+static inline void
+np_dict_get_val_inline(NpDict* dict, void* key, void* out)
+{
+    // the library counts the probes when NP_STATS is set
+    if (dict->count == 0 || np_stats_enabled) {
+        (np_dict_get_val)(dict, key, out);
+        return;
+    }
+
+    size_t probe = np_dict_hash_key(dict, key) % dict->lut_capacity;
+    for (;;) {
+        int index = dict->lut[probe];
+        if (index == DICT_LUT_EMPTY) break;
+        if (index >= 0) {
+            NpByte* item = dict->data + dict->item_size * index;
+            if (dict->keycmp(key, item + dict->key_offset)) {
+                memcpy(out, item + dict->val_offset, dict->val_size);
+                return;
+            }
+        }
+        probe = (probe + 1) % dict->lut_capacity;
+    }
+    // raises the KeyError
+    (np_dict_get_val)(dict, key, out);
+}
+
+#define np_str_eq(str1, str2) np_str_eq_inline(str1, str2)
+#define np_list_get_item(list, index, out) np_list_get_item_inline(list, index, out)
+#define np_list_set_item(list, index, item) np_list_set_item_inline(list, index, item)
+#define np_list_append(list, item) np_list_append_inline(list, item)
+#define np_dict_get_val(dict, key, out) np_dict_get_val_inline(dict, key, out)
+
+#endif
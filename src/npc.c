@@ -1,14 +1,25 @@
+// fdopen
+#define _POSIX_C_SOURCE 200809L
+
+#include <dirent.h>
 #include <errno.h>
+#include <signal.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include "build_cache.h"
 #include "compiler.h"
 #include "diagnostics.h"
 #include "lexer.h"
+#include "modules.h"
+#include "optimizer.h"
+#include "timing.h"
 #include "writer.h"
 
 #if DEBUG
@@ -37,26 +48,98 @@ open_file_for_writing(char* filepath)
 }
 
 static void
-make_build_directory(void)
+make_directory(const char* path)
 {
-    int status = mkdir(BUILD_DIR, 0777);
+    int status = mkdir(path, 0777);
 
     if (status != 0 && errno != EEXIST)
-        errorf("failed to make " BUILD_DIR " directory (%s)", strerror(errno));
+        errorf("failed to make (%s) directory (%s)", path, strerror(errno));
+}
+
+#define BUILD_PATH_CAPACITY 256
+
+static void
+format_path(char* out, const char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    int length = vsnprintf(out, BUILD_PATH_CAPACITY, fmt, args);
+    va_end(args);
+    if (length >= BUILD_PATH_CAPACITY) errorf("build path (%s) is too long", out);
 }
 
-// TODO: in the future this will need to be more robust and support multiple files
-#define INTERMEDIATE_FILEPATH BUILD_DIR "/intermediate.c"
+// every invocation builds within its own directory so concurrent builds can't collide
+typedef struct {
+    char path[BUILD_PATH_CAPACITY];
+    char intermediate[BUILD_PATH_CAPACITY];
+    char profile[BUILD_PATH_CAPACITY];
+} BuildDirectory;
+
+// the build directory is removed when npc exits, however the build ended, by the process
+// that made it as forked children inherit the handler
+static char build_directory_path[BUILD_PATH_CAPACITY];
+static pid_t build_directory_owner;
 
-static Requirements
-compile_target_to_c(char* target)
+static BuildDirectory
+make_target_build_directory(const char* stem)
 {
-    Lexer lexer = lex_file(target);
-    FILE* outfile = open_file_for_writing(INTERMEDIATE_FILEPATH);
-    CompiledInstructions compiled = compile(&lexer);
-    write_c_program(compiled, outfile);
+    BuildDirectory dir;
+    format_path(dir.path, BUILD_DIR "/%s.%ld", stem, (long)getpid());
+    format_path(dir.intermediate, "%s/intermediate.c", dir.path);
+    format_path(dir.profile, "%s/profile", dir.path);
+    make_directory(BUILD_DIR);
+    make_directory(dir.path);
+    memcpy(build_directory_path, dir.path, sizeof(dir.path));
+    build_directory_owner = getpid();
+    return dir;
+}
+
+// removes `path` along with everything within it, a missing path is ignored
+static void
+remove_tree(const char* path)
+{
+    struct stat info;
+    if (stat(path, &info) != 0) {
+        if (errno == ENOENT) return;
+        errorf("unable to stat (%s) (%s)", path, strerror(errno));
+    }
+
+    if (S_ISDIR(info.st_mode)) {
+        DIR* dir = opendir(path);
+        if (!dir) errorf("unable to open (%s) (%s)", path, strerror(errno));
+        struct dirent* entry;
+        while ((entry = readdir(dir))) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+                continue;
+            char entry_path[BUILD_PATH_CAPACITY];
+            format_path(entry_path, "%s/%s", path, entry->d_name);
+            remove_tree(entry_path);
+        }
+        closedir(dir);
+        if (rmdir(path) != 0) errorf("unable to remove (%s) (%s)", path, strerror(errno));
+    }
+    else if (unlink(path) != 0)
+        errorf("unable to remove (%s) (%s)", path, strerror(errno));
+}
+
+static void
+remove_build_directory(void)
+{
+    if (!build_directory_path[0] || getpid() != build_directory_owner) return;
+    char path[BUILD_PATH_CAPACITY];
+    memcpy(path, build_directory_path, sizeof(path));
+    // an error removing it exits again, which mustn't try a second time
+    build_directory_path[0] = '\0';
+    remove_tree(path);
+}
+
+static size_t
+write_c_file(const char* path, CompiledInstructions compiled, WriterOptions writer_opts)
+{
+    FILE* outfile = open_file_for_writing((char*)path);
+    size_t written = write_c_program(compiled, outfile, writer_opts);
     fclose(outfile);
-    return compiled.req;
+    return written;
 }
 
 ShortString
@@ -92,44 +175,65 @@ shortstr_from_cstr(char* cstr)
     return str;
 }
 
-static void
-fork_and_run_sync(char* const* argv)
+// when `stdin_pipe` is given the child reads its stdin from the returned stream
+static pid_t
+spawn_process(char* const* argv, FILE** stdin_pipe)
 {
     // TODO: portability
+    int fds[2];
+    if (stdin_pipe && pipe(fds) != 0)
+        errorf("unable to create pipe (%s)", strerror(errno));
+
     pid_t child_pid = fork();
     if (child_pid < 0) errorf("unable to fork process (%s)", strerror(errno));
     if (child_pid == 0) {
+        if (stdin_pipe) {
+            if (dup2(fds[0], STDIN_FILENO) < 0)
+                errorf("unable to redirect stdin in child (%s)", strerror(errno));
+            close(fds[0]);
+            close(fds[1]);
+        }
         if (execvp(argv[0], argv) < 0)
             errorf("unable to exec `%s` in child (%s)", argv[0], strerror(errno));
     }
-    else {
-        int status;
-        for (;;) {
-            if (waitpid(child_pid, &status, 0) < 0) {
-                errorf(
-                    "failed waiting on process (pid: %i) -> %s",
-                    child_pid,
-                    strerror(errno)
-                );
-            }
-            if (WIFEXITED(status)) {
-                int exitcode = WEXITSTATUS(status);
-                if (exitcode != 0) {
-                    errorf("`%s` exited with exitcode: %i", argv[0], exitcode);
-                }
-                break;
-            }
-            if (WIFSIGNALED(status)) {
-                errorf(
-                    "`%s` process was terminated by a signal: %i",
-                    argv[0],
-                    WTERMSIG(status)
-                );
+
+    if (stdin_pipe) {
+        close(fds[0]);
+        *stdin_pipe = fdopen(fds[1], "w");
+        if (!*stdin_pipe) errorf("unable to open pipe (%s)", strerror(errno));
+    }
+    return child_pid;
+}
+
+static void
+wait_for_process(pid_t child_pid, const char* name)
+{
+    int status;
+    for (;;) {
+        if (waitpid(child_pid, &status, 0) < 0) {
+            errorf(
+                "failed waiting on process (pid: %i) -> %s", child_pid, strerror(errno)
+            );
+        }
+        if (WIFEXITED(status)) {
+            int exitcode = WEXITSTATUS(status);
+            if (exitcode != 0) {
+                errorf("`%s` exited with exitcode: %i", name, exitcode);
             }
+            break;
+        }
+        if (WIFSIGNALED(status)) {
+            errorf("`%s` process was terminated by a signal: %i", name, WTERMSIG(status));
         }
     }
 }
 
+static void
+fork_and_run_sync(char* const* argv)
+{
+    wait_for_process(spawn_process(argv, NULL), argv[0]);
+}
+
 #define ARGV_BUILDER_CAP 256
 
 typedef struct {
@@ -152,36 +256,281 @@ argv_extend(ArgvBuilder* argv, const char* args[])
     while ((arg = *args++)) argv_append(argv, arg);
 }
 
+#define OPT_LEVEL_MAX 3
+
+typedef struct {
+    // passed on to the C compiler as -O<level>, levels above 0 also link with LTO
+    int opt_level;
+    // build an instrumented binary, train it and then rebuild it using the profile
+    bool pgo;
+    // shell command used for the training run, by default the program is run as is
+    char* pgo_train;
+    // build with debug info that maps back onto the source through #line directives
+    bool debug_info;
+} BuildOptions;
+
+typedef enum { PROFILE_NONE, PROFILE_GENERATE, PROFILE_USE } ProfileMode;
+
+typedef enum {
+    PHASE_LEX,
+    PHASE_COMPILE,
+    PHASE_WRITE,
+    PHASE_CC,
+    PHASE_LINK,
+    PHASE_COUNT,
+} Phase;
+
+static const char* PHASE_NAMES[PHASE_COUNT] = {
+    [PHASE_LEX] = "lex",
+    [PHASE_COMPILE] = "compile",
+    [PHASE_WRITE] = "write",
+    [PHASE_CC] = "cc",
+    [PHASE_LINK] = "link",
+};
+
+typedef struct {
+    double wall;
+    // npc's own CPU time plus that of the subprocesses it has waited on
+    double cpu;
+} TimePoint;
+
+typedef enum { TIME_PHASES_NONE, TIME_PHASES_TEXT, TIME_PHASES_JSON } TimePhasesFormat;
+
+typedef struct {
+    bool enabled;
+    TimePoint phases[PHASE_COUNT];
+    // summed over the modules which are lexed in parallel
+    double scan_seconds;
+    double lex_seconds;
+    size_t tokens;
+    size_t statements;
+    size_t c_bytes;
+    // the C was streamed into cc so writing it overlapped with `link`
+    bool streamed;
+    bool cached;
+} PhaseTimes;
+
+static double
+timeval_seconds(struct timeval tv)
+{
+    return (double)tv.tv_sec + (double)tv.tv_usec / 1e6;
+}
+
+static TimePoint
+time_point(void)
+{
+    struct rusage children;
+    if (getrusage(RUSAGE_CHILDREN, &children) != 0)
+        errorf("unable to get resource usage (%s)", strerror(errno));
+    return (TimePoint){
+        .wall = wall_seconds(),
+        .cpu = cpu_seconds() + timeval_seconds(children.ru_utime) +
+               timeval_seconds(children.ru_stime),
+    };
+}
+
 static void
-compile_to_binary(Requirements req, char* outfile)
+end_phase(PhaseTimes* times, Phase phase, TimePoint start)
 {
-    ArgvBuilder args = {0};
+    if (!times->enabled) return;
+    TimePoint end = time_point();
+    times->phases[phase].wall += end.wall - start.wall;
+    times->phases[phase].cpu += end.cpu - start.cpu;
+}
 
+#if DEBUG
+#define RUNTIME_ARCHIVE "not_python_db.a"
+#define RUNTIME_LTO_ARCHIVE "not_python_lto_db.a"
+#else
+#define RUNTIME_ARCHIVE "not_python.a"
+#define RUNTIME_LTO_ARCHIVE "not_python_lto.a"
+#endif
+
+// a translation unit compiled on its own before linking
+typedef struct {
+    // when empty the C is streamed into cc's stdin instead
+    char source[BUILD_PATH_CAPACITY];
+    char object[BUILD_PATH_CAPACITY];
+    bool cached;
+} ObjectFile;
+
+typedef struct {
+    CompiledInstructions compiled;
+    WriterOptions writer_opts;
+    // declares what the units share when the module is split over more than one
+    char header[BUILD_PATH_CAPACITY];
+    size_t units_count;
+    ObjectFile* units;
+    size_t c_bytes;
+} GeneratedC;
+
+typedef struct {
+    size_t modules_count;
+    GeneratedC* modules;
+    // the units of every module
+    size_t objects_count;
+    ObjectFile* objects;
+} GeneratedProgram;
+
+// flags shared by compiling and linking, `profile_flag` is storage for the profile flag
+static void
+append_cc_flags(
+    ArgvBuilder* args,
+    BuildDirectory* dir,
+    BuildOptions opts,
+    ProfileMode profile,
+    char* profile_flag
+)
+{
+    static const char* opt_level_flags[OPT_LEVEL_MAX + 1] = {"-O0", "-O1", "-O2", "-O3"};
     argv_extend(
-        &args,
+        args,
         (const char*[]){
-            "cc",
-            "-o",
-            outfile,
-            (const char*)INTERMEDIATE_FILEPATH,
+            opt_level_flags[opts.opt_level],
             (const char*)"-L" INSTALL_DIR "/lib",
             (const char*)"-I" INSTALL_DIR "/include",
             NULL,
         }
     );
-#if DEBUG
-    argv_append(&args, "-l:not_python_db.a");
-#else
-    argv_append(&args, "-l:not_python.a");
-#endif
 
-    if (req.libs[LIB_MATH]) {
+    switch (profile) {
+        case PROFILE_NONE:
+            break;
+        case PROFILE_GENERATE:
+            format_path(profile_flag, "-fprofile-generate=%s", dir->profile);
+            argv_append(args, profile_flag);
+            break;
+        case PROFILE_USE:
+            format_path(profile_flag, "-fprofile-use=%s", dir->profile);
+            argv_append(args, profile_flag);
+            break;
+    }
+    // the LTO archive lets the runtime be optimized together with the program
+    if (opts.opt_level > 0) argv_append(args, "-flto");
+    if (opts.debug_info) argv_append(args, "-g");
+}
+
+static pid_t
+spawn_object_compile(
+    BuildDirectory* dir, ObjectFile* object, BuildOptions opts, ProfileMode profile
+)
+{
+    char profile_flag[BUILD_PATH_CAPACITY];
+    ArgvBuilder args = {0};
+    argv_extend(&args, (const char*[]){"cc", "-c", "-o", object->object, NULL});
+    append_cc_flags(&args, dir, opts, profile, profile_flag);
+    argv_append(&args, object->source);
+    argv_append(&args, NULL);
+    return spawn_process((char* const*)args.buffer, NULL);
+}
+
+// objects are compiled by up to `jobs` C compilers at once
+static void
+compile_objects(
+    BuildDirectory* dir,
+    ObjectFile* objects,
+    size_t count,
+    size_t jobs,
+    BuildOptions opts,
+    ProfileMode profile
+)
+{
+    pid_t* pids = malloc(sizeof(pid_t) * count);
+    if (!pids) error("out of memory");
+    size_t started = 0;
+    size_t finished = 0;
+
+    while (finished < started || started < count) {
+        if (started < count && started - finished < jobs) {
+            ObjectFile* object = objects + started;
+            pids[started] =
+                (object->cached) ? 0 : spawn_object_compile(dir, object, opts, profile);
+            started++;
+            continue;
+        }
+        if (pids[finished]) wait_for_process(pids[finished], "cc");
+        finished++;
+    }
+    free(pids);
+}
+
+// a program of a single translation unit is compiled by a single invocation of cc,
+// otherwise every unit is compiled to an object and then linked
+static void
+compile_to_binary(
+    BuildDirectory* dir,
+    GeneratedProgram* program,
+    size_t jobs,
+    char* outfile,
+    BuildOptions opts,
+    ProfileMode profile,
+    PhaseTimes* times
+)
+{
+    ObjectFile* objects = program->objects;
+    TimePoint start = time_point();
+    if (program->objects_count > 1) {
+        compile_objects(dir, objects, program->objects_count, jobs, opts, profile);
+        end_phase(times, PHASE_CC, start);
+        start = time_point();
+    }
+
+    // cc writes to a temporary file which is renamed over the outfile once complete
+    char tmp_outfile[BUILD_PATH_CAPACITY];
+    format_path(tmp_outfile, "%s.%ld.tmp", outfile, (long)getpid());
+
+    char profile_flag[BUILD_PATH_CAPACITY];
+    ArgvBuilder args = {0};
+    argv_extend(&args, (const char*[]){"cc", "-o", tmp_outfile, NULL});
+    append_cc_flags(&args, dir, opts, profile, profile_flag);
+
+    for (size_t i = 0; i < program->objects_count; i++) {
+        if (program->objects_count > 1)
+            argv_append(&args, objects[i].object);
+        else if (objects[i].source[0])
+            argv_append(&args, objects[i].source);
+        else
+            argv_extend(&args, (const char*[]){"-x", "c", "-", "-x", "none", NULL});
+    }
+    bool requires_math = false;
+    for (size_t i = 0; i < program->modules_count; i++)
+        requires_math = requires_math || program->modules[i].compiled.req.libs[LIB_MATH];
+
+    if (opts.opt_level > 0)
+        argv_append(&args, "-l:" RUNTIME_LTO_ARCHIVE);
+    else
+        argv_append(&args, "-l:" RUNTIME_ARCHIVE);
+
+    if (requires_math) {
         argv_append(&args, "-lm");
     }
 
     argv_append(&args, NULL);
 
-    fork_and_run_sync((char* const*)args.buffer);
+    if (program->objects_count > 1 || objects[0].source[0])
+        fork_and_run_sync((char* const*)args.buffer);
+    else {
+        // cc is only started once the C is generated, an error generating it would
+        // otherwise leave cc to report on a truncated program
+        GeneratedC* module = program->modules;
+        TimePoint write_start = time_point();
+        PendingC* c = generate_c_program(module->compiled, module->writer_opts);
+        FILE* cc_stdin;
+        pid_t cc_pid = spawn_process((char* const*)args.buffer, &cc_stdin);
+        times->c_bytes = write_pending_c(c, cc_stdin);
+        // a write error means cc exited early which waiting on it will report
+        fclose(cc_stdin);
+        end_phase(times, PHASE_WRITE, write_start);
+        // the time spent writing isn't counted again as linking
+        TimePoint write_end = time_point();
+        start.wall += write_end.wall - write_start.wall;
+        start.cpu += write_end.cpu - write_start.cpu;
+        times->streamed = true;
+        wait_for_process(cc_pid, args.buffer[0]);
+    }
+    end_phase(times, PHASE_LINK, start);
+    if (rename(tmp_outfile, outfile) != 0)
+        errorf("unable to move (%s) to (%s) (%s)", tmp_outfile, outfile, strerror(errno));
 }
 
 static void
@@ -199,20 +548,67 @@ run_program(char* program_name)
     fork_and_run_sync(argv);
 }
 
+static void
+build_with_profile(
+    BuildDirectory* dir,
+    GeneratedProgram* program,
+    size_t jobs,
+    char* outfile,
+    BuildOptions opts,
+    PhaseTimes* times
+)
+{
+    // profiles left over from an earlier build wouldn't match the new program
+    remove_tree(dir->profile);
+    compile_to_binary(dir, program, jobs, outfile, opts, PROFILE_GENERATE, times);
+
+    if (opts.pgo_train) {
+        char* const argv[] = {"/bin/sh", "-c", opts.pgo_train, NULL};
+        fork_and_run_sync(argv);
+    }
+    else
+        run_program(outfile);
+
+    compile_to_binary(dir, program, jobs, outfile, opts, PROFILE_USE, times);
+}
+
 #if DEBUG
 typedef enum {
     DEBUG_NONE,
     DEBUG_TOKENS,
     DEBUG_STATEMENTS,
     DEBUG_SCOPES,
-    DEBUG_C_COMPILER
+    DEBUG_C_COMPILER,
+    DEBUG_IR
 } DebugProgram;
 #endif
 
+#define TARGETS_MAX 256
+
 typedef struct {
     ShortString outfile;
-    ShortString target;
+    ShortString targets[TARGETS_MAX];
+    size_t target_count;
+    // how many targets are built at once when given more than one
+    size_t jobs;
     bool run;
+    bool no_cache;
+    // keep the generated C next to the binary as <outfile>.c
+    bool emit_c;
+    // stop once the C is written without building it
+    bool emit_c_only;
+    // how many translation units the C of each module is split into, 0 picks by size
+    size_t units;
+    // print the memory held by the arenas of the program after each phase
+    bool mem_stats;
+    // time every function of the program and report them when it exits
+    bool profile;
+    // report the lines of the program that allocate the most when it exits
+    bool trace_allocs;
+    TimePhasesFormat time_phases;
+    CompilerOptions compiler_opts;
+    OptimizerOptions optimizer_opts;
+    BuildOptions build_opts;
 #if DEBUG
     DebugProgram debug_program;
 #endif
@@ -224,6 +620,7 @@ typedef struct {
 #define DEBUG_STATEMENTS_FLAG "--debug-statements"
 #define DEBUG_SCOPES_FLAG "--debug-scopes"
 #define DEBUG_C_COMPILER_FLAG "--debug-c-compiler"
+#define DEBUG_IR_FLAG "--debug-ir"
 
 static void
 set_cli_debug_program(CommandLine* cli, DebugProgram program)
@@ -247,6 +644,9 @@ parse_debug_option(CommandLine* cli, char* arg)
     else if (strcmp(arg, DEBUG_C_COMPILER_FLAG) == 0)
         set_cli_debug_program(cli, DEBUG_C_COMPILER);
 
+    else if (strcmp(arg, DEBUG_IR_FLAG) == 0)
+        set_cli_debug_program(cli, DEBUG_IR);
+
     else
         return false;
 
@@ -255,11 +655,29 @@ parse_debug_option(CommandLine* cli, char* arg)
 
 #endif  // DEBUG
 
+static size_t
+parse_size_arg(char* flag, char* value)
+{
+    char* end;
+    if (!value) errorf("expecting a value for argument (%s)", flag);
+    unsigned long long parsed = strtoull(value, &end, 10);
+    if (*value == '\0' || *end != '\0' || value[0] == '-')
+        errorf(
+            "expecting a non-negative integer for argument (%s) but got (%s)", flag, value
+        );
+    return parsed;
+}
+
 static CommandLine
 parse_args(size_t argc, char** argv)
 {
     (void)argc;
-    CommandLine cli = {0};
+    CommandLine cli = {
+        .optimizer_opts.inline_opts.threshold = INLINE_DEFAULT_THRESHOLD,
+        .build_opts.opt_level = -1,
+    };
+    long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+    cli.jobs = (cpu_count > 0) ? (size_t)cpu_count : 1;
 
     argv++;
     for (;;) {
@@ -269,8 +687,50 @@ parse_args(size_t argc, char** argv)
             cli.run = true;
         else if (strcmp(arg, "-o") == 0 || strcmp(arg, "--out") == 0)
             cli.outfile = shortstr_from_cstr(*argv++);
-        else if (arg[0] != '-' && !cli.target.length)
-            cli.target = shortstr_from_cstr(arg);
+        else if (strcmp(arg, "-j") == 0 || strcmp(arg, "--jobs") == 0)
+            cli.jobs = parse_size_arg(arg, *argv++);
+        else if (strncmp(arg, "-j", 2) == 0)
+            cli.jobs = parse_size_arg("-j", arg + 2);
+        else if (strcmp(arg, "--no-cache") == 0)
+            cli.no_cache = true;
+        else if (strcmp(arg, "--emit-c") == 0)
+            cli.emit_c = true;
+        else if (strcmp(arg, "--emit-c-only") == 0)
+            cli.emit_c = cli.emit_c_only = true;
+        else if (strcmp(arg, "--c-units") == 0)
+            cli.units = parse_size_arg(arg, *argv++);
+        else if (strcmp(arg, "--mem-stats") == 0)
+            cli.mem_stats = true;
+        else if (strcmp(arg, "--profile") == 0)
+            cli.profile = true;
+        else if (strcmp(arg, "--trace-allocs") == 0)
+            cli.trace_allocs = true;
+        else if (strcmp(arg, "--time-phases") == 0)
+            cli.time_phases = TIME_PHASES_TEXT;
+        else if (strcmp(arg, "--time-phases=json") == 0)
+            cli.time_phases = TIME_PHASES_JSON;
+        else if (strcmp(arg, "--inline-threshold") == 0)
+            cli.optimizer_opts.inline_opts.threshold = parse_size_arg(arg, *argv++);
+        else if (strcmp(arg, "-g") == 0)
+            cli.build_opts.debug_info = true;
+        else if (strcmp(arg, "-O") == 0)
+            cli.compiler_opts.strip_asserts = true;
+        else if (arg[0] == '-' && arg[1] == 'O' && arg[2] >= '0' &&
+                 arg[2] <= '0' + OPT_LEVEL_MAX && arg[3] == '\0')
+            cli.build_opts.opt_level = arg[2] - '0';
+        else if (strcmp(arg, "--pgo") == 0)
+            cli.build_opts.pgo = true;
+        else if (strcmp(arg, "--pgo-train") == 0) {
+            cli.build_opts.pgo = true;
+            cli.build_opts.pgo_train = *argv++;
+            if (!cli.build_opts.pgo_train)
+                errorf("expecting a value for argument (%s)", arg);
+        }
+        else if (arg[0] != '-') {
+            if (cli.target_count == TARGETS_MAX)
+                errorf("too many targets (max %u)", TARGETS_MAX);
+            cli.targets[cli.target_count++] = shortstr_from_cstr(arg);
+        }
 #if DEBUG
         else if (parse_debug_option(&cli, arg))
             ;
@@ -280,39 +740,483 @@ parse_args(size_t argc, char** argv)
     }
 
     // TODO: usage string
-    if (!cli.target.length) errorf("no target provided");
-    if (!cli.outfile.length) cli.outfile = default_outfile(cli.target.data);
+    if (!cli.target_count) errorf("no target provided");
+    if (cli.target_count > 1) {
+        if (cli.outfile.length) errorf("-o can't be used with more than one target");
+        if (cli.run) errorf("--run can't be used with more than one target");
+    }
+    if (cli.emit_c_only && (cli.run || cli.build_opts.pgo))
+        errorf("--emit-c-only can't be used with --run or --pgo");
+    if (cli.jobs == 0) errorf("expecting at least 1 job");
+    // an inlined call would be counted toward its caller
+    if (cli.profile) cli.optimizer_opts.inline_opts.threshold = 0;
+    if (!cli.outfile.length) cli.outfile = default_outfile(cli.targets[0].data);
+    // a profile is of little use to an unoptimized build
+    if (cli.build_opts.opt_level < 0)
+        cli.build_opts.opt_level = (cli.build_opts.pgo) ? 2 : 0;
+    cli.optimizer_opts.enabled = cli.build_opts.opt_level > 0;
 
     return cli;
 }
 
+#define CACHE_DIRECTORY BUILD_DIR "/cache"
+#define CACHE_OPTIONS_CAPACITY 128
+
+static BuildCache
+init_build_cache(
+    CommandLine* cli,
+    const char* const* sources,
+    const char* const* namespaces,
+    size_t source_count
+)
+{
+    // the C includes the runtime's headers, those of its inlined fast paths from -O1 up
+    bool optimized = cli->build_opts.opt_level > 0;
+    const char* runtime_files[] = {
+        (optimized) ? INSTALL_DIR "/lib/" RUNTIME_LTO_ARCHIVE
+                    : INSTALL_DIR "/lib/" RUNTIME_ARCHIVE,
+        INSTALL_DIR "/include/not_python.h",
+        INSTALL_DIR "/include/not_python_inline.h",
+        INSTALL_DIR "/include/np_hash.h",
+    };
+    size_t runtime_files_count = (optimized) ? 4 : 2;
+    char options[CACHE_OPTIONS_CAPACITY];
+    snprintf(
+        options,
+        sizeof(options),
+        "-O%i -g%i strip_asserts=%i inline_threshold=%zu profile=%i trace_allocs=%i",
+        cli->build_opts.opt_level,
+        cli->build_opts.debug_info,
+        cli->compiler_opts.strip_asserts,
+        cli->optimizer_opts.inline_opts.threshold,
+        cli->profile,
+        cli->trace_allocs
+    );
+    return build_cache_init(
+        CACHE_DIRECTORY,
+        sources,
+        namespaces,
+        source_count,
+        runtime_files,
+        runtime_files_count,
+        options
+    );
+}
+
+static void
+write_module(void* ctx, size_t index)
+{
+    GeneratedC* module = (GeneratedC*)ctx + index;
+    if (module->units_count == 1) {
+        module->c_bytes =
+            write_c_file(module->units[0].source, module->compiled, module->writer_opts);
+        return;
+    }
+
+    // the units sit next to their header
+    const char* header_name = strrchr(module->header, '/');
+    SplitOutput out = {
+        .header = open_file_for_writing(module->header),
+        .header_name = (header_name) ? header_name + 1 : module->header,
+        .units_count = module->units_count,
+        .units = malloc(sizeof(FILE*) * module->units_count),
+    };
+    if (!out.units) error("out of memory");
+    for (size_t i = 0; i < out.units_count; i++)
+        out.units[i] = open_file_for_writing(module->units[i].source);
+    module->c_bytes = write_c_program_split(module->compiled, out, module->writer_opts);
+    fclose(out.header);
+    for (size_t i = 0; i < out.units_count; i++) fclose(out.units[i]);
+    free(out.units);
+}
+
+// the first unit of a module is `<base>.c` and the rest `<base>.<index>.c`, the source
+// is left empty when the C is streamed into cc
+static void
+set_unit_paths(
+    ObjectFile* unit, const char* source_base, const char* object_base, size_t index
+)
+{
+    if (index == 0) {
+        if (source_base) format_path(unit->source, "%s.c", source_base);
+        format_path(unit->object, "%s.o", object_base);
+    }
+    else {
+        if (source_base) format_path(unit->source, "%s.%zu.c", source_base, index);
+        format_path(unit->object, "%s.%zu.o", object_base, index);
+    }
+}
+
+#define KIB(bytes) ((double)(bytes) / 1024)
+
+// every module has its own arena which is used from lexing through to compiling
+static void
+print_memory_stats(const char* phase, Program* program)
+{
+    ArenaStats total = {0};
+    for (size_t i = 0; i < program->count; i++) {
+        ArenaStats stats = arena_stats(program->modules[i]->lexer.arena);
+        total.static_chunks += stats.static_chunks;
+        total.static_bytes_reserved += stats.static_bytes_reserved;
+        total.static_bytes_used += stats.static_bytes_used;
+        total.dynamic_regions += stats.dynamic_regions;
+        total.dynamic_chunks += stats.dynamic_chunks;
+        total.dynamic_chunks_in_use += stats.dynamic_chunks_in_use;
+        total.dynamic_chunks_peak += stats.dynamic_chunks_peak;
+        total.dynamic_bytes_in_use += stats.dynamic_bytes_in_use;
+        total.dynamic_bytes_peak += stats.dynamic_bytes_peak;
+        if (stats.dynamic_largest_free_run > total.dynamic_largest_free_run)
+            total.dynamic_largest_free_run = stats.dynamic_largest_free_run;
+    }
+
+    size_t static_unused = total.static_bytes_reserved - total.static_bytes_used;
+    size_t dynamic_free = total.dynamic_chunks - total.dynamic_chunks_in_use;
+    fprintf(
+        stderr,
+        "memory after %s (%zu arenas):\n"
+        "    static:  %zu chunks, %.1f KiB used of %.1f KiB (%.1f KiB unused)\n"
+        "    dynamic: %zu regions, %zu of %zu chunks in use (peak %zu), "
+        "%.1f KiB live (peak %.1f KiB)\n"
+        "             %zu chunks free, largest free run %zu chunks\n",
+        phase,
+        program->count,
+        total.static_chunks,
+        KIB(total.static_bytes_used),
+        KIB(total.static_bytes_reserved),
+        KIB(static_unused),
+        total.dynamic_regions,
+        total.dynamic_chunks_in_use,
+        total.dynamic_chunks,
+        total.dynamic_chunks_peak,
+        KIB(total.dynamic_bytes_in_use),
+        KIB(total.dynamic_bytes_peak),
+        dynamic_free,
+        total.dynamic_largest_free_run
+    );
+}
+
+static double
+per_second(size_t count, double seconds)
+{
+    return (seconds > 0) ? (double)count / seconds : 0;
+}
+
+static void
+print_phase_times_json(const char* target, PhaseTimes* times)
+{
+    double lex_wall = times->phases[PHASE_LEX].wall;
+    fprintf(stderr, "{\"target\": \"");
+    for (const char* c = target; *c; c++) {
+        if (*c == '"' || *c == '\\') fputc('\\', stderr);
+        fputc(*c, stderr);
+    }
+    fprintf(stderr, "\", \"cached\": %s, ", (times->cached) ? "true" : "false");
+    fprintf(stderr, "\"streamed\": %s, ", (times->streamed) ? "true" : "false");
+    fprintf(stderr, "\"phases\": {");
+    for (Phase phase = 0; phase < PHASE_COUNT; phase++) {
+        fprintf(
+            stderr,
+            "%s\"%s\": {\"wall\": %.6f, \"cpu\": %.6f}",
+            (phase) ? ", " : "",
+            PHASE_NAMES[phase],
+            times->phases[phase].wall,
+            times->phases[phase].cpu
+        );
+    }
+    fprintf(
+        stderr,
+        "}, \"scan_seconds\": %.6f, \"parse_seconds\": %.6f, \"tokens\": %zu, "
+        "\"tokens_per_second\": %.1f, \"statements\": %zu, "
+        "\"statements_per_second\": %.1f, \"c_bytes\": %zu}\n",
+        times->scan_seconds,
+        times->lex_seconds - times->scan_seconds,
+        times->tokens,
+        per_second(times->tokens, lex_wall),
+        times->statements,
+        per_second(times->statements, lex_wall),
+        times->c_bytes
+    );
+}
+
+static void
+print_phase_times(const char* target, PhaseTimes* times)
+{
+    TimePoint total = {0};
+    fprintf(stderr, "%s%s\n", target, (times->cached) ? " (cached)" : "");
+    fprintf(stderr, "    %-8s %10s %10s\n", "phase", "wall (s)", "cpu (s)");
+    for (Phase phase = 0; phase < PHASE_COUNT; phase++) {
+        TimePoint time = times->phases[phase];
+        const char* name = PHASE_NAMES[phase];
+        fprintf(stderr, "    %-8s %10.4f %10.4f", name, time.wall, time.cpu);
+        if (phase == PHASE_LEX)
+            fprintf(
+                stderr,
+                "  scan %.4f, parse %.4f summed over modules",
+                times->scan_seconds,
+                times->lex_seconds - times->scan_seconds
+            );
+        if (phase == PHASE_LINK && times->streamed)
+            fprintf(stderr, "  compiling as the C was written");
+        fprintf(stderr, "\n");
+        total.wall += time.wall;
+        total.cpu += time.cpu;
+    }
+    fprintf(stderr, "    %-8s %10.4f %10.4f\n", "total", total.wall, total.cpu);
+
+    double lex_wall = times->phases[PHASE_LEX].wall;
+    fprintf(
+        stderr,
+        "    %zu tokens (%.0f/s), %zu statements (%.0f/s), %.1f KiB of C\n",
+        times->tokens,
+        per_second(times->tokens, lex_wall),
+        times->statements,
+        per_second(times->statements, lex_wall),
+        KIB(times->c_bytes)
+    );
+}
+
+static void
+report_phase_times(CommandLine* cli, const char* target, PhaseTimes* times)
+{
+    if (cli->time_phases == TIME_PHASES_JSON)
+        print_phase_times_json(target, times);
+    else if (cli->time_phases == TIME_PHASES_TEXT)
+        print_phase_times(target, times);
+}
+
+static void
+build_target(CommandLine* cli, char* target, char* outfile)
+{
+    PhaseTimes times = {.enabled = cli->time_phases != TIME_PHASES_NONE};
+    LexerOptions lexer_opts = {.time_phases = times.enabled};
+    TimePoint start = time_point();
+    Program program = load_program(target, lexer_opts, cli->jobs);
+    end_phase(&times, PHASE_LEX, start);
+    for (size_t i = 0; i < program.count; i++) {
+        Lexer* lexer = &program.modules[i]->lexer;
+        times.scan_seconds += lexer->scan_seconds;
+        times.lex_seconds += lexer->lex_seconds;
+        times.tokens += lexer->tokens_count;
+        times.statements += lexer->statements_count;
+    }
+    if (cli->mem_stats) print_memory_stats("lex", &program);
+
+    // a profile depends on how the training run went and --emit-c needs the C to be
+    // generated so neither is cached
+    bool use_cache = !cli->no_cache && !cli->build_opts.pgo && !cli->emit_c;
+    BuildCache cache = {0};
+    if (use_cache) {
+        const char** sources = malloc(sizeof(char*) * program.count * 2);
+        if (!sources) error("out of memory");
+        const char** namespaces = sources + program.count;
+        for (size_t i = 0; i < program.count; i++) {
+            sources[i] = program.modules[i]->path;
+            namespaces[i] = program.modules[i]->lexer.file_namespace;
+        }
+        cache = init_build_cache(cli, sources, namespaces, program.count);
+        free(sources);
+        if (build_cache_fetch(cache, outfile)) {
+            times.cached = true;
+            report_phase_times(cli, target, &times);
+            return;
+        }
+    }
+
+    start = time_point();
+    compile_program(&program, cli->compiler_opts, cli->optimizer_opts, cli->jobs);
+    end_phase(&times, PHASE_COMPILE, start);
+    if (cli->mem_stats) print_memory_stats("compile", &program);
+    // the build directory is only made once the target is known to compile
+    BuildDirectory dir = make_target_build_directory(default_outfile(target).data);
+
+    GeneratedProgram generated = {.modules_count = program.count};
+    generated.modules = calloc(program.count, sizeof(GeneratedC));
+    if (!generated.modules) error("out of memory");
+    for (size_t i = 0; i < program.count; i++) {
+        GeneratedC* module = generated.modules + i;
+        module->compiled = program.modules[i]->compiled;
+        // the inlined fast paths are only worth the larger program in optimized builds
+        module->writer_opts.inline_runtime = cli->build_opts.opt_level > 0;
+        module->writer_opts.profile = cli->profile;
+        module->writer_opts.trace_allocs = cli->trace_allocs;
+        module->writer_opts.line_directives = cli->build_opts.debug_info;
+        module->units_count =
+            (cli->units) ? cli->units : split_units_count(module->compiled, cli->jobs);
+        generated.objects_count += module->units_count;
+    }
+    generated.objects = calloc(generated.objects_count, sizeof(ObjectFile));
+    if (!generated.objects) error("out of memory");
+
+    // the profile maps back onto the source by its filename so a PGO build needs files,
+    // as does anything compiled as more than one unit
+    bool write_files =
+        cli->emit_c || cli->build_opts.pgo || generated.objects_count > 1;
+    ObjectFile* next_unit = generated.objects;
+    for (size_t i = 0; i < program.count; i++) {
+        GeneratedC* module = generated.modules + i;
+        module->units = next_unit;
+        next_unit += module->units_count;
+
+        ShortString stem = default_outfile(program.modules[i]->path);
+        char object_base[BUILD_PATH_CAPACITY];
+        char source_base[BUILD_PATH_CAPACITY];
+        format_path(object_base, "%s/%s", dir.path, stem.data);
+        if (cli->emit_c && program.modules[i]->init_function)
+            format_path(source_base, "%s.%s", outfile, stem.data);
+        else if (cli->emit_c)
+            format_path(source_base, "%s", outfile);
+        else
+            format_path(source_base, "%s", object_base);
+
+        if (module->units_count > 1) format_path(module->header, "%s.h", source_base);
+        for (size_t j = 0; j < module->units_count; j++) {
+            set_unit_paths(
+                module->units + j, (write_files) ? source_base : NULL, object_base, j
+            );
+        }
+        // otherwise the C is piped into cc
+        module->writer_opts.c_filepath =
+            (write_files) ? module->units[0].source : "<stdin>";
+    }
+    if (write_files) {
+        start = time_point();
+        run_parallel(program.count, cli->jobs, write_module, generated.modules);
+        end_phase(&times, PHASE_WRITE, start);
+        for (size_t i = 0; i < program.count; i++)
+            times.c_bytes += generated.modules[i].c_bytes;
+    }
+
+    // the object of a unit is keyed by its C so a change to one module only
+    // recompiles the units it changes the C of
+    BuildCache* object_caches = NULL;
+    if (use_cache && generated.objects_count > 1) {
+        object_caches = malloc(sizeof(BuildCache) * generated.objects_count);
+        if (!object_caches) error("out of memory");
+        for (size_t i = 0; i < program.count; i++) {
+            GeneratedC* module = generated.modules + i;
+            for (size_t j = 0; j < module->units_count; j++) {
+                ObjectFile* unit = module->units + j;
+                const char* sources[2] = {unit->source, module->header};
+                const char* file_namespace = program.modules[i]->lexer.file_namespace;
+                const char* namespaces[2] = {file_namespace, file_namespace};
+                size_t sources_count = (module->header[0]) ? 2 : 1;
+                BuildCache* cache = object_caches + (unit - generated.objects);
+                *cache = init_build_cache(cli, sources, namespaces, sources_count);
+                unit->cached = build_cache_fetch(*cache, unit->object);
+            }
+        }
+    }
+
+    if (cli->build_opts.pgo)
+        build_with_profile(&dir, &generated, cli->jobs, outfile, cli->build_opts, &times);
+    else if (!cli->emit_c_only)
+        compile_to_binary(
+            &dir, &generated, cli->jobs, outfile, cli->build_opts, PROFILE_NONE, &times
+        );
+    if (cli->mem_stats) print_memory_stats("write", &program);
+    if (object_caches) {
+        for (size_t i = 0; i < generated.objects_count; i++) {
+            if (!generated.objects[i].cached)
+                build_cache_store(object_caches[i], generated.objects[i].object);
+        }
+        free(object_caches);
+    }
+    if (use_cache) build_cache_store(cache, outfile);
+    remove_build_directory();
+    free(generated.objects);
+    free(generated.modules);
+    report_phase_times(cli, target, &times);
+}
+
+// each target is built in a child process so one failing target doesn't take the
+// others down with it
+static void
+build_targets(CommandLine* cli)
+{
+    size_t next = 0;
+    size_t running = 0;
+    size_t failed = 0;
+    // the targets built at once split the jobs between their threads and cc processes
+    size_t concurrent = (cli->target_count < cli->jobs) ? cli->target_count : cli->jobs;
+    size_t target_jobs = cli->jobs / concurrent;
+
+    // each target is built to its stem in the cwd, so `a/main.np b/main.np` would race
+    // for `main`
+    for (size_t i = 0; i < cli->target_count; i++) {
+        ShortString outfile = default_outfile(cli->targets[i].data);
+        for (size_t j = 0; j < i; j++) {
+            if (strcmp(default_outfile(cli->targets[j].data).data, outfile.data) == 0)
+                errorf(
+                    "targets (%s) and (%s) would both be built to (%s)",
+                    cli->targets[j].data,
+                    cli->targets[i].data,
+                    outfile.data
+                );
+        }
+    }
+
+    while (next < cli->target_count || running > 0) {
+        if (next < cli->target_count && running < cli->jobs) {
+            fflush(stdout);
+            fflush(stderr);
+            pid_t child_pid = fork();
+            if (child_pid < 0) errorf("unable to fork process (%s)", strerror(errno));
+            if (child_pid == 0) {
+                cli->jobs = target_jobs;
+                char* target = cli->targets[next].data;
+                build_target(cli, target, default_outfile(target).data);
+                exit(0);
+            }
+            next++;
+            running++;
+            continue;
+        }
+
+        int status;
+        if (wait(&status) < 0) errorf("failed waiting on builds (%s)", strerror(errno));
+        running--;
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) failed++;
+    }
+
+    if (failed) errorf("%zu of %zu targets failed to build", failed, cli->target_count);
+}
+
 int
 main(int argc, char** argv)
 {
     (void)argc;
     CommandLine cli = parse_args(argc, argv);
+    // a cc that exits early is reported when it's waited on rather than killing npc
+    signal(SIGPIPE, SIG_IGN);
+    atexit(remove_build_directory);
 
 #if DEBUG
     switch (cli.debug_program) {
         case DEBUG_NONE:
             break;
         case DEBUG_TOKENS:
-            debug_tokens_main(cli.target.data);
+            debug_tokens_main(cli.targets[0].data);
             exit(0);
         case DEBUG_STATEMENTS:
-            debug_statements_main(cli.target.data);
+            debug_statements_main(cli.targets[0].data);
             exit(0);
         case DEBUG_SCOPES:
-            debug_scopes_main(cli.target.data);
+            debug_scopes_main(cli.targets[0].data);
             exit(0);
         case DEBUG_C_COMPILER:
-            debug_compiler_main(cli.target.data);
+            debug_compiler_main(cli.targets[0].data);
+            exit(0);
+        case DEBUG_IR:
+            debug_ir_main(cli.targets[0].data, cli.optimizer_opts);
             exit(0);
     }
 #endif
 
-    make_build_directory();
-    Requirements req = compile_target_to_c(cli.target.data);
-    compile_to_binary(req, cli.outfile.data);
+    if (cli.target_count > 1) {
+        build_targets(&cli);
+        return 0;
+    }
+
+    build_target(&cli, cli.targets[0].data, cli.outfile.data);
     if (cli.run) run_program(cli.outfile.data);
 }
@@ -0,0 +1,693 @@
+#include "optimizer.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "constant_folder.h"
+#include "diagnostics.h"
+#include "np_hash.h"
+#include "optimizer_helpers.h"
+#include "type_checker.h"
+
+// must be a power of 2
+#define AVAILABLE_EXPRESSION_BUCKETS 1024
+// the most operands taken by an intrinsic or a pure library function
+#define PURE_EXPRESSION_OPERANDS_MAX 2
+
+typedef struct {
+    uint64_t hash;
+    OperationInst expression;
+    // the temporary already holding the result of `expression`
+    StorageIdent result;
+    FunctionStatement* function;
+    // the entry this one shadows within the same bucket, offset by 1 so 0 is empty
+    size_t shadowed;
+} AvailableExpression;
+
+typedef struct {
+    size_t count;
+    size_t capacity;
+    AvailableExpression* elements;
+    size_t buckets[AVAILABLE_EXPRESSION_BUCKETS];
+} AvailableExpressions;
+
+typedef struct {
+    BindingTable bindings;
+    ScopedFlags flags;
+    // the function whose body is being visited, NULL for the top level
+    FunctionStatement* function;
+    AvailableExpressions available;
+} Optimizer;
+
+typedef void (*SequenceWalker)(Optimizer* opt, InstructionSequence* seq);
+
+static Optimizer*
+optimizer_init(InstructionSequence seq)
+{
+    Optimizer* opt = calloc(1, sizeof(Optimizer));
+    if (!opt) error("out of memory");
+    count_bindings(&opt->bindings, seq);
+    return opt;
+}
+
+static void
+optimizer_free(Optimizer* opt)
+{
+    binding_table_free(&opt->bindings);
+    scoped_flags_free(&opt->flags);
+    free(opt->available.elements);
+    free(opt);
+}
+
+static void
+walk_nested_sequences(Optimizer* opt, Instruction* inst, SequenceWalker walk)
+{
+    FunctionStatement* outer_function = opt->function;
+    if (inst->kind == INST_DEFINE_FUNCTION) opt->function = inst->define_function.fndef;
+
+    InstructionSequence* nested[NESTED_SEQUENCES_MAX];
+    size_t nested_count = nested_sequences(inst, nested);
+    for (size_t j = 0; j < nested_count; j++) walk(opt, nested[j]);
+
+    opt->function = outer_function;
+}
+
+// a compiler temporary that's only ever assigned by value
+static bool
+is_single_assignment(Binding* binding)
+{
+    return binding && !binding->is_variable && binding->declared && !binding->external &&
+           !binding->escapes && binding->writes == 1;
+}
+
+static void
+mark_assigned(void* ctx, StorageIdent* ident, OperandRole role)
+{
+    Optimizer* opt = ctx;
+    if (role != OPERAND_WRITE) return;
+    Binding* binding = get_binding(&opt->bindings, *ident, false);
+    if (binding && binding->writes == 1)
+        scoped_flag_set(&opt->flags, &binding->is_assigned);
+}
+
+// the value of `ident` can't change for the rest of the sequence being visited
+static bool
+is_stable(Optimizer* opt, StorageIdent ident)
+{
+    // the unused operand of unary operators
+    if (ident.kind == IDENT_CSTR && !ident.cstr) return true;
+    if (IS_LITERAL(ident)) return true;
+    if (ident.reference) return false;
+
+    Binding* binding = get_binding(&opt->bindings, ident, false);
+    if (!binding || !binding->declared || binding->escapes) return false;
+    return binding->writes == 0 || (binding->writes == 1 && binding->is_assigned);
+}
+
+// library functions without side effects other than allocating their result
+static bool
+is_pure_lib_function(NpLibFunctionData function_data)
+{
+    static const NpLibFunction pure_functions[] = {
+        NPLIB_STR_ADD,
+        NPLIB_STR_MUL,
+        NPLIB_STR_EQ,
+        NPLIB_STR_GT,
+        NPLIB_STR_GTE,
+        NPLIB_STR_LT,
+        NPLIB_STR_LTE,
+        NPLIB_INT_TO_STR,
+        NPLIB_FLOAT_TO_STR,
+        NPLIB_BOOL_TO_STR,
+        NPLIB_FMOD,
+        NPLIB_POW,
+    };
+    for (size_t i = 0; i < sizeof(pure_functions) / sizeof(pure_functions[0]); i++) {
+        if (IS_LIB_FUNCTION(function_data, pure_functions[i])) return true;
+    }
+    return false;
+}
+
+// intrinsics and pure library calls, those which always produce the same result
+// given the same operands
+static bool
+is_pure_expression(OperationInst operation)
+{
+    switch (operation.kind) {
+        case OPERATION_INTRINSIC:
+            return true;
+        case OPERATION_C_CALL:
+        case OPERATION_C_CALL1:
+            return is_pure_lib_function(operation.c_function);
+        default:
+            return false;
+    }
+}
+
+static size_t
+expression_operands(OperationInst* operation, StorageIdent** out)
+{
+    switch (operation->kind) {
+        case OPERATION_INTRINSIC:
+            *out = &operation->left;
+            out[1] = &operation->right;
+            return 2;
+        case OPERATION_C_CALL:
+            for (int i = 0; i < operation->c_function.argc; i++)
+                out[i] = operation->c_function_args + i;
+            return operation->c_function.argc;
+        case OPERATION_C_CALL1:
+            *out = &operation->c_function_arg;
+            return 1;
+        default:
+            UNREACHABLE();
+    }
+}
+
+// propagate copies
+// ----------------
+// reads of a temporary holding a copy of a value that can't change are replaced by
+// the value itself
+
+static void
+substitute_copy(void* ctx, StorageIdent* ident, OperandRole role)
+{
+    Optimizer* opt = ctx;
+    if ((role != OPERAND_READ && role != OPERAND_USE) || ident->reference) return;
+    Binding* binding = get_binding(&opt->bindings, *ident, false);
+    if (binding && binding->is_known) *ident = binding->value;
+}
+
+static bool
+is_copy_source(Optimizer* opt, StorageIdent ident)
+{
+    if (ident.kind == IDENT_FUNCTION)
+        // calls made through a copy of the function object become direct calls
+        return !ident.func->decorator && !ident.func->is_method;
+    if (ident.kind != IDENT_CSTR && ident.kind != IDENT_VAR) return false;
+    return is_stable(opt, ident);
+}
+
+static void
+record_copy(Optimizer* opt, AssignmentInst assignment)
+{
+    if (assignment.right.kind != OPERATION_COPY) return;
+    StorageIdent source = assignment.right.copy;
+    Binding* binding = get_binding(&opt->bindings, assignment.left, false);
+    if (is_single_assignment(binding) && is_copy_source(opt, source) &&
+        compare_types(source.info, assignment.left.info)) {
+        binding->value = source;
+        scoped_flag_set(&opt->flags, &binding->is_known);
+    }
+}
+
+// copies are only visible to the instructions following them within the same
+// sequence, the same as constants in the constant folder
+static void
+propagate_sequence(Optimizer* opt, InstructionSequence* seq)
+{
+    size_t scope = opt->flags.count;
+
+    for (size_t i = 0; i < seq->count; i++) {
+        Instruction* inst = seq->instructions + i;
+        // a jump may arrive from before anything in this sequence was assigned
+        if (inst->kind == INST_LABEL) scoped_flags_unwind(&opt->flags, scope);
+
+        visit_instruction(inst, substitute_copy, opt);
+        visit_instruction(inst, mark_assigned, opt);
+        if (inst->kind == INST_ASSIGNMENT || inst->kind == INST_DECL_ASSIGNMENT)
+            record_copy(opt, inst->assignment);
+
+        walk_nested_sequences(opt, inst, propagate_sequence);
+    }
+
+    scoped_flags_unwind(&opt->flags, scope);
+}
+
+static void
+propagate_copies(CompiledInstructions* compiled, OptimizerOptions opts)
+{
+    (void)opts;
+    Optimizer* opt = optimizer_init(compiled->seq);
+    propagate_sequence(opt, &compiled->seq);
+    optimizer_free(opt);
+}
+
+// eliminate common subexpressions
+// -------------------------------
+// a pure expression already computed into a temporary whose operands haven't changed
+// since is replaced by a copy of that temporary
+
+static uint64_t
+mix_hash(uint64_t hash, uint64_t value)
+{
+    hash ^= value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+static uint64_t
+ident_hash(StorageIdent ident)
+{
+    uint64_t hash = mix_hash(ident.kind, ident.info.type);
+    switch (ident.kind) {
+        case IDENT_CSTR:
+            if (!ident.cstr) return hash;
+            return mix_hash(hash, hash_bytes((void*)ident.cstr, strlen(ident.cstr)));
+        case IDENT_VAR:
+            return mix_hash(hash, (uintptr_t)ident.var);
+        case IDENT_FUNCTION:
+            return mix_hash(hash, (uintptr_t)ident.func);
+        case IDENT_STRING_LITERAL:
+            return mix_hash(hash, ident.str_literal_index);
+        case IDENT_INT_LITERAL:
+            return mix_hash(hash, (uint64_t)ident.int_value);
+        case IDENT_FLOAT_LITERAL: {
+            uint32_t bits;
+            memcpy(&bits, &ident.float_value, sizeof(bits));
+            return mix_hash(hash, bits);
+        }
+        case IDENT_NPTYPE_ZERO_INIT_LITERAL:
+            return hash;
+    }
+    UNREACHABLE();
+}
+
+static bool
+ident_equal(StorageIdent a, StorageIdent b)
+{
+    if (a.kind != b.kind || a.reference != b.reference || !compare_types(a.info, b.info))
+        return false;
+
+    switch (a.kind) {
+        case IDENT_CSTR:
+            if (!a.cstr || !b.cstr) return a.cstr == b.cstr;
+            return strcmp(a.cstr, b.cstr) == 0;
+        case IDENT_VAR:
+            return a.var == b.var;
+        case IDENT_FUNCTION:
+            return a.func == b.func;
+        case IDENT_STRING_LITERAL:
+            return a.str_literal_index == b.str_literal_index;
+        case IDENT_INT_LITERAL:
+            return a.int_value == b.int_value;
+        case IDENT_FLOAT_LITERAL:
+            return memcmp(&a.float_value, &b.float_value, sizeof(a.float_value)) == 0;
+        case IDENT_NPTYPE_ZERO_INIT_LITERAL:
+            return true;
+    }
+    UNREACHABLE();
+}
+
+static uint64_t
+expression_hash(OperationInst* expression)
+{
+    uint64_t hash = expression->kind;
+    if (expression->kind == OPERATION_INTRINSIC)
+        hash = mix_hash(hash, expression->op);
+    else
+        hash = mix_hash(hash, (uintptr_t)expression->c_function.name);
+
+    StorageIdent* operands[PURE_EXPRESSION_OPERANDS_MAX];
+    size_t operands_count = expression_operands(expression, operands);
+    for (size_t i = 0; i < operands_count; i++)
+        hash = mix_hash(hash, ident_hash(*operands[i]));
+    return hash;
+}
+
+static bool
+expression_equal(OperationInst* a, OperationInst* b)
+{
+    if (a->kind != b->kind) return false;
+    if (a->kind == OPERATION_INTRINSIC && a->op != b->op) return false;
+    if (a->kind != OPERATION_INTRINSIC && a->c_function.name != b->c_function.name)
+        return false;
+
+    StorageIdent* a_operands[PURE_EXPRESSION_OPERANDS_MAX];
+    StorageIdent* b_operands[PURE_EXPRESSION_OPERANDS_MAX];
+    size_t operands_count = expression_operands(a, a_operands);
+    if (expression_operands(b, b_operands) != operands_count) return false;
+    for (size_t i = 0; i < operands_count; i++) {
+        if (!ident_equal(*a_operands[i], *b_operands[i])) return false;
+    }
+    return true;
+}
+
+static AvailableExpression*
+find_available_expression(Optimizer* opt, uint64_t hash, OperationInst* expression)
+{
+    AvailableExpressions* available = &opt->available;
+    size_t index = available->buckets[hash & (AVAILABLE_EXPRESSION_BUCKETS - 1)];
+    while (index) {
+        AvailableExpression* candidate = available->elements + index - 1;
+        // temporaries of another function are out of reach
+        if (candidate->hash == hash && candidate->function == opt->function &&
+            expression_equal(&candidate->expression, expression))
+            return candidate;
+        index = candidate->shadowed;
+    }
+    return NULL;
+}
+
+static void
+add_available_expression(
+    Optimizer* opt, uint64_t hash, OperationInst expression, StorageIdent result
+)
+{
+    AvailableExpressions* available = &opt->available;
+    if (available->count == available->capacity) {
+        available->capacity = (available->capacity) ? available->capacity * 2 : 64;
+        available->elements = realloc(
+            available->elements, sizeof(AvailableExpression) * available->capacity
+        );
+        if (!available->elements) error("out of memory");
+    }
+    size_t* bucket = available->buckets + (hash & (AVAILABLE_EXPRESSION_BUCKETS - 1));
+    available->elements[available->count++] = (AvailableExpression){
+        .hash = hash,
+        .expression = expression,
+        .result = result,
+        .function = opt->function,
+        .shadowed = *bucket,
+    };
+    *bucket = available->count;
+}
+
+static void
+forget_available_expressions(Optimizer* opt, size_t scope)
+{
+    AvailableExpressions* available = &opt->available;
+    while (available->count > scope) {
+        AvailableExpression* expression = available->elements + --available->count;
+        available->buckets[expression->hash & (AVAILABLE_EXPRESSION_BUCKETS - 1)] =
+            expression->shadowed;
+    }
+}
+
+static void
+eliminate_expression(Optimizer* opt, AssignmentInst* assignment)
+{
+    OperationInst* expression = &assignment->right;
+    if (!is_pure_expression(*expression)) return;
+    if (!is_single_assignment(get_binding(&opt->bindings, assignment->left, false)))
+        return;
+
+    StorageIdent* operands[PURE_EXPRESSION_OPERANDS_MAX];
+    size_t operands_count = expression_operands(expression, operands);
+    for (size_t i = 0; i < operands_count; i++) {
+        if (!is_stable(opt, *operands[i])) return;
+    }
+
+    uint64_t hash = expression_hash(expression);
+    AvailableExpression* available = find_available_expression(opt, hash, expression);
+    if (available && compare_types(available->result.info, assignment->left.info))
+        *expression = (OperationInst){.kind = OPERATION_COPY, .copy = available->result};
+    else
+        add_available_expression(opt, hash, *expression, assignment->left);
+}
+
+static void
+eliminate_sequence(Optimizer* opt, InstructionSequence* seq)
+{
+    size_t flags_scope = opt->flags.count;
+    size_t available_scope = opt->available.count;
+
+    for (size_t i = 0; i < seq->count; i++) {
+        Instruction* inst = seq->instructions + i;
+        if (inst->kind == INST_LABEL) {
+            scoped_flags_unwind(&opt->flags, flags_scope);
+            forget_available_expressions(opt, available_scope);
+        }
+
+        // expressions only match once the copies they read are propagated
+        visit_instruction(inst, substitute_copy, opt);
+        if (inst->kind == INST_ASSIGNMENT || inst->kind == INST_DECL_ASSIGNMENT) {
+            bool was_unsafe = UNSAFE_INST((*inst));
+            eliminate_expression(opt, &inst->assignment);
+            if (was_unsafe && !UNSAFE_INST((*inst)) && i + 1 < seq->count &&
+                is_exception_check(seq->instructions[i + 1]))
+                // the call that could have raised now happens earlier
+                seq->instructions[i + 1] = NO_OP;
+        }
+        visit_instruction(inst, mark_assigned, opt);
+        if (inst->kind == INST_ASSIGNMENT || inst->kind == INST_DECL_ASSIGNMENT)
+            record_copy(opt, inst->assignment);
+
+        walk_nested_sequences(opt, inst, eliminate_sequence);
+    }
+
+    scoped_flags_unwind(&opt->flags, flags_scope);
+    forget_available_expressions(opt, available_scope);
+}
+
+static void
+eliminate_common_subexpressions(CompiledInstructions* compiled, OptimizerOptions opts)
+{
+    (void)opts;
+    Optimizer* opt = optimizer_init(compiled->seq);
+    eliminate_sequence(opt, &compiled->seq);
+    optimizer_free(opt);
+}
+
+// hoist loop invariants
+// ---------------------
+// pure expressions inside of a loop whose operands aren't written by the loop are
+// computed once before the loop begins
+
+static void
+count_loop_write(void* ctx, StorageIdent* ident, OperandRole role)
+{
+    Optimizer* opt = ctx;
+    if (role != OPERAND_WRITE) return;
+    Binding* binding = get_binding(&opt->bindings, *ident, false);
+    if (binding) binding->loop_writes++;
+}
+
+static void
+uncount_loop_write(void* ctx, StorageIdent* ident, OperandRole role)
+{
+    Optimizer* opt = ctx;
+    if (role != OPERAND_WRITE) return;
+    Binding* binding = get_binding(&opt->bindings, *ident, false);
+    if (binding && binding->loop_writes) binding->loop_writes--;
+}
+
+static void
+visit_loop(Instruction* loop, OperandVisitor visit, Optimizer* opt)
+{
+    InstructionSequence* nested[NESTED_SEQUENCES_MAX];
+    size_t nested_count = nested_sequences(loop, nested);
+    for (size_t i = 0; i < nested_count; i++) visit_sequence(*nested[i], visit, opt);
+}
+
+static bool
+is_loop_invariant(Optimizer* opt, StorageIdent ident)
+{
+    if (ident.kind == IDENT_CSTR && !ident.cstr) return true;
+    if (IS_LITERAL(ident)) return true;
+    if (ident.reference) return false;
+
+    Binding* binding = get_binding(&opt->bindings, ident, false);
+    if (!binding || !binding->declared || binding->escapes || binding->loop_writes)
+        return false;
+    // calls made from within the loop could reach writes made by another function
+    return binding->writes == 0 ||
+           (!binding->written_by_many_functions && binding->writer == opt->function);
+}
+
+static bool
+is_hoistable(Optimizer* opt, Instruction inst)
+{
+    if (inst.kind != INST_DECL_ASSIGNMENT) return false;
+    if (!is_single_assignment(get_binding(&opt->bindings, inst.assignment.left, false)))
+        return false;
+
+    // the loop body may never run so nothing that can fail is moved out of it
+    OperationInst* expression = &inst.assignment.right;
+    if (!is_pure_expression(*expression)) return false;
+    if (expression->kind == OPERATION_INTRINSIC && expression->op == OPERATOR_MOD &&
+        (expression->right.kind != IDENT_INT_LITERAL ||
+         expression->right.int_value == 0 || expression->right.int_value == -1))
+        return false;
+    if (expression->kind != OPERATION_INTRINSIC && expression->c_function.unsafe)
+        return false;
+
+    StorageIdent* operands[PURE_EXPRESSION_OPERANDS_MAX];
+    size_t operands_count = expression_operands(expression, operands);
+    for (size_t i = 0; i < operands_count; i++) {
+        if (!is_loop_invariant(opt, *operands[i])) return false;
+    }
+    return true;
+}
+
+// inner loops are visited first so their invariants can move on through outer loops
+static void
+hoist_sequence(Optimizer* opt, InstructionSequence* seq)
+{
+    InstructionSequence out = {0};
+    bool rebuilt = false;
+
+    for (size_t i = 0; i < seq->count; i++) {
+        Instruction* inst = seq->instructions + i;
+        walk_nested_sequences(opt, inst, hoist_sequence);
+
+        if (inst->kind == INST_LOOP) {
+            visit_loop(inst, count_loop_write, opt);
+
+            // only the unconditional part of each iteration is considered
+            InstructionSequence* candidates[2] = {&inst->loop.before, &inst->loop.body};
+            for (size_t j = 0; j < 2; j++) {
+                for (size_t k = 0; k < candidates[j]->count; k++) {
+                    Instruction* candidate = candidates[j]->instructions + k;
+                    if (!is_hoistable(opt, *candidate)) continue;
+
+                    if (!rebuilt) {
+                        out = instruction_sequence_init(seq->arena);
+                        for (size_t l = 0; l < i; l++)
+                            instruction_sequence_append(&out, seq->instructions[l]);
+                        rebuilt = true;
+                    }
+                    get_binding(&opt->bindings, candidate->assignment.left, false)
+                        ->loop_writes--;
+                    instruction_sequence_append(&out, *candidate);
+                    *candidate = NO_OP;
+                }
+            }
+
+            visit_loop(inst, uncount_loop_write, opt);
+        }
+
+        if (rebuilt) instruction_sequence_append(&out, *inst);
+    }
+
+    if (rebuilt) {
+        instruction_sequence_finalize(&out);
+        *seq = out;
+    }
+}
+
+static void
+hoist_loop_invariants(CompiledInstructions* compiled, OptimizerOptions opts)
+{
+    (void)opts;
+    Optimizer* opt = optimizer_init(compiled->seq);
+    hoist_sequence(opt, &compiled->seq);
+    optimizer_free(opt);
+}
+
+// eliminate dead code
+// -------------------
+// assignments to temporaries that are never read are dropped, keeping only the side
+// effects of the operation
+
+static bool
+is_removable(OperationInst operation)
+{
+    switch (operation.kind) {
+        case OPERATION_COPY:
+        case OPERATION_GET_ATTR:
+        case OPERATION_DEREF:
+            return true;
+        default:
+            return is_pure_expression(operation);
+    }
+}
+
+static bool
+remove_dead_code(Optimizer* opt, InstructionSequence* seq)
+{
+    bool removed = false;
+
+    for (size_t i = 0; i < seq->count; i++) {
+        Instruction* inst = seq->instructions + i;
+        Binding* binding;
+
+        switch (inst->kind) {
+            case INST_ASSIGNMENT:
+            case INST_DECL_ASSIGNMENT:
+                binding = get_binding(&opt->bindings, inst->assignment.left, false);
+                if (!is_single_assignment(binding) || binding->reads > 0) break;
+                if (is_removable(inst->assignment.right))
+                    *inst = NO_OP;
+                else
+                    *inst = (Instruction){
+                        .kind = INST_OPERATION,
+                        .operation = inst->assignment.right,
+                    };
+                removed = true;
+                break;
+            case INST_DECLARE_VARIABLE:
+                binding = get_binding(&opt->bindings, inst->declare_variable, false);
+                if (!binding || binding->is_variable || binding->escapes ||
+                    binding->reads > 0 || binding->writes > 0)
+                    break;
+                *inst = NO_OP;
+                removed = true;
+                break;
+            default: {
+                InstructionSequence* nested[NESTED_SEQUENCES_MAX];
+                size_t nested_count = nested_sequences(inst, nested);
+                for (size_t j = 0; j < nested_count; j++) {
+                    if (remove_dead_code(opt, nested[j])) removed = true;
+                }
+            }
+        }
+    }
+
+    return removed;
+}
+
+static void
+eliminate_dead_code(CompiledInstructions* compiled, OptimizerOptions opts)
+{
+    (void)opts;
+    // removing an assignment can leave the operands it read without readers
+    for (;;) {
+        Optimizer* opt = optimizer_init(compiled->seq);
+        bool removed = remove_dead_code(opt, &compiled->seq);
+        optimizer_free(opt);
+        if (!removed) break;
+    }
+}
+
+static void
+run_inliner(CompiledInstructions* compiled, OptimizerOptions opts)
+{
+    inline_functions(compiled, opts.inline_opts);
+}
+
+static void
+run_constant_folder(CompiledInstructions* compiled, OptimizerOptions opts)
+{
+    (void)opts;
+    fold_constants(compiled);
+}
+
+typedef struct {
+    const char* name;
+    void (*run)(CompiledInstructions* compiled, OptimizerOptions opts);
+    // only run when the optimizer is enabled
+    bool optimizing;
+} OptimizerPass;
+
+static const OptimizerPass PASSES[] = {
+    {.name = "propagate-copies", .run = propagate_copies},
+    {.name = "inline-functions", .run = run_inliner, .optimizing = true},
+    {.name = "fold-constants", .run = run_constant_folder, .optimizing = true},
+    {.name = "propagate-copies", .run = propagate_copies, .optimizing = true},
+    {.name = "eliminate-common-subexpressions",
+     .run = eliminate_common_subexpressions,
+     .optimizing = true},
+    {.name = "hoist-loop-invariants", .run = hoist_loop_invariants, .optimizing = true},
+    {.name = "eliminate-dead-code", .run = eliminate_dead_code, .optimizing = true},
+};
+
+void
+optimize(CompiledInstructions* compiled, OptimizerOptions opts)
+{
+    for (size_t i = 0; i < sizeof(PASSES) / sizeof(PASSES[0]); i++) {
+        if (PASSES[i].optimizing && !opts.enabled) continue;
+        PASSES[i].run(compiled, opts);
+        if (opts.after_pass) opts.after_pass(PASSES[i].name, compiled);
+    }
+}
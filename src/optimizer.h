@@ -0,0 +1,19 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "compiler.h"
+#include "inliner.h"
+
+typedef struct {
+    InlineOptions inline_opts;
+    // set from -O1 and above, otherwise only copies are propagated so that -O0 -g steps
+    // through the program as it was written
+    bool enabled;
+    // when set this is called with the name of each pass once it has run
+    void (*after_pass)(const char* pass_name, CompiledInstructions* compiled);
+} OptimizerOptions;
+
+// runs the optimization passes over the compiled instructions before they're written
+void optimize(CompiledInstructions* compiled, OptimizerOptions opts);
+
+#endif
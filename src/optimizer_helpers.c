@@ -0,0 +1,282 @@
+#include "optimizer_helpers.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "diagnostics.h"
+#include "np_hash.h"
+
+static bool
+is_variadic(NpLibFunctionData function_data)
+{
+    for (size_t i = 0; i < NPLIB_FUNCTION_COUNT; i++) {
+        if (function_data.name == NPLIB_FUNCTION_DATA[i].name)
+            return NPLIB_FUNCTION_DATA[i].argc < 0;
+    }
+    return false;
+}
+
+void
+visit_operation(OperationInst* operation, OperandVisitor visit, void* ctx)
+{
+    switch (operation->kind) {
+        case OPERATION_INTRINSIC:
+            visit(ctx, &operation->left, OPERAND_READ);
+            visit(ctx, &operation->right, OPERAND_READ);
+            break;
+        case OPERATION_FUNCTION_CALL:
+            visit(ctx, &operation->function, OPERAND_USE);
+            visit(ctx, &operation->self, OPERAND_USE);
+            for (size_t i = 0; i < operation->function.info.sig->params_count; i++)
+                visit(ctx, operation->args + i, OPERAND_READ);
+            break;
+        case OPERATION_C_CALL: {
+            // variadic args aren't converted to the parameter type so a literal would
+            // change the width of what's passed
+            OperandRole role =
+                (is_variadic(operation->c_function)) ? OPERAND_USE : OPERAND_READ;
+            for (int i = 0; i < operation->c_function.argc; i++)
+                visit(ctx, operation->c_function_args + i, role);
+            break;
+        }
+        case OPERATION_C_CALL1:
+            visit(ctx, &operation->c_function_arg, OPERAND_READ);
+            break;
+        case OPERATION_GET_ATTR:
+            visit(ctx, &operation->object, OPERAND_USE);
+            break;
+        case OPERATION_SET_ATTR:
+            visit(ctx, &operation->object, OPERAND_WRITE);
+            visit(ctx, &operation->value, OPERAND_READ);
+            break;
+        case OPERATION_COPY:
+            visit(ctx, &operation->copy, OPERAND_READ);
+            break;
+        case OPERATION_DEREF:
+            visit(ctx, &operation->ref, OPERAND_USE);
+            break;
+    }
+}
+
+void
+visit_instruction(Instruction* inst, OperandVisitor visit, void* ctx)
+{
+    switch (inst->kind) {
+        case INST_ASSIGNMENT:
+            visit(ctx, &inst->assignment.left, OPERAND_WRITE);
+            visit_operation(&inst->assignment.right, visit, ctx);
+            break;
+        case INST_DECL_ASSIGNMENT:
+            visit(ctx, &inst->assignment.left, OPERAND_DECLARE);
+            visit(ctx, &inst->assignment.left, OPERAND_WRITE);
+            visit_operation(&inst->assignment.right, visit, ctx);
+            break;
+        case INST_OPERATION:
+            visit_operation(&inst->operation, visit, ctx);
+            break;
+        case INST_DECLARE_VARIABLE:
+            visit(ctx, &inst->declare_variable, OPERAND_DECLARE);
+            break;
+        case INST_LOOP:
+            visit(ctx, &inst->loop.condition, OPERAND_USE);
+            break;
+        case INST_IF:
+            visit(ctx, &inst->if_.condition_ident, OPERAND_READ);
+            break;
+        case INST_RETURN:
+            visit(ctx, &inst->return_.rtval, OPERAND_READ);
+            break;
+        case INST_ITER_NEXT:
+            // advancing the iterator updates its state
+            visit(ctx, &inst->iter_next.iter, OPERAND_USE);
+            visit(ctx, &inst->iter_next.iter, OPERAND_WRITE);
+            visit(ctx, &inst->iter_next.unpack, OPERAND_WRITE);
+            break;
+        default:
+            break;
+    }
+}
+
+void
+visit_sequence(InstructionSequence seq, OperandVisitor visit, void* ctx)
+{
+    for (size_t i = 0; i < seq.count; i++) {
+        visit_instruction(seq.instructions + i, visit, ctx);
+        InstructionSequence* nested[NESTED_SEQUENCES_MAX];
+        size_t nested_count = nested_sequences(seq.instructions + i, nested);
+        for (size_t j = 0; j < nested_count; j++) visit_sequence(*nested[j], visit, ctx);
+    }
+}
+
+static uint64_t
+binding_hash(const void* key, bool is_variable)
+{
+    if (!is_variable) return hash_bytes((void*)key, strlen(key));
+
+    uint64_t hash = (uint64_t)(uintptr_t)key;
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+static Binding*
+binding_slot(BindingTable* table, const void* key, bool is_variable)
+{
+    size_t i = binding_hash(key, is_variable) & (table->capacity - 1);
+    for (;;) {
+        Binding* binding = table->elements + i;
+        if (!binding->key) return binding;
+        if (binding->is_variable == is_variable) {
+            // temporaries are matched by name as the same name may be built repeatedly
+            if (is_variable && binding->key == key) return binding;
+            if (!is_variable && strcmp(binding->key, key) == 0) return binding;
+        }
+        i = (i + 1) & (table->capacity - 1);
+    }
+}
+
+static void
+binding_table_grow(BindingTable* table)
+{
+    BindingTable grown = {
+        .count = table->count,
+        .capacity = (table->capacity) ? table->capacity * 2 : 64,
+    };
+    grown.elements = calloc(grown.capacity, sizeof(Binding));
+    if (!grown.elements) error("out of memory");
+
+    for (size_t i = 0; i < table->capacity; i++) {
+        Binding* binding = table->elements + i;
+        if (binding->key)
+            *binding_slot(&grown, binding->key, binding->is_variable) = *binding;
+    }
+    free(table->elements);
+    *table = grown;
+}
+
+Binding*
+get_binding(BindingTable* table, StorageIdent ident, bool create)
+{
+    const void* key;
+    bool is_variable;
+    if (ident.kind == IDENT_VAR) {
+        key = ident.var;
+        is_variable = true;
+    }
+    else if (ident.kind == IDENT_CSTR && ident.cstr) {
+        key = ident.cstr;
+        is_variable = false;
+    }
+    else
+        return NULL;
+
+    if (create && table->count * 2 >= table->capacity) binding_table_grow(table);
+    if (table->capacity == 0) return NULL;
+
+    Binding* binding = binding_slot(table, key, is_variable);
+    if (!binding->key) {
+        if (!create) return NULL;
+        binding->key = key;
+        binding->is_variable = is_variable;
+        if (is_variable) {
+            binding->declared = true;
+            // arguments are assigned by the caller and self is bound by the context
+            binding->external = ident.var->kind == VAR_ARGUMENT ||
+                                ident.var->kind == VAR_CLOSURE_ARGUMENT ||
+                                ident.var->kind == VAR_SELF;
+            // other modules can write to it from any call
+            binding->escapes = ident.var->shared;
+        }
+        table->count++;
+    }
+    return binding;
+}
+
+typedef struct {
+    BindingTable* table;
+    FunctionStatement* function;
+} Counter;
+
+static void
+count_operand(void* ctx, StorageIdent* ident, OperandRole role)
+{
+    Counter* counter = ctx;
+    Binding* binding = get_binding(counter->table, *ident, true);
+    if (!binding) return;
+
+    if (ident->reference) binding->escapes = true;
+    switch (role) {
+        case OPERAND_DECLARE:
+            binding->declared = true;
+            break;
+        case OPERAND_WRITE:
+            if (binding->writes > 0 && binding->writer != counter->function)
+                binding->written_by_many_functions = true;
+            binding->writer = counter->function;
+            binding->writes++;
+            break;
+        case OPERAND_READ:
+        case OPERAND_USE:
+            binding->reads++;
+            break;
+    }
+}
+
+static void
+count_sequence(Counter* counter, InstructionSequence seq)
+{
+    for (size_t i = 0; i < seq.count; i++) {
+        Instruction* inst = seq.instructions + i;
+        visit_instruction(inst, count_operand, counter);
+
+        FunctionStatement* outer_function = counter->function;
+        if (inst->kind == INST_DEFINE_FUNCTION)
+            counter->function = inst->define_function.fndef;
+        InstructionSequence* nested[NESTED_SEQUENCES_MAX];
+        size_t nested_count = nested_sequences(inst, nested);
+        for (size_t j = 0; j < nested_count; j++) count_sequence(counter, *nested[j]);
+        counter->function = outer_function;
+    }
+}
+
+void
+count_bindings(BindingTable* table, InstructionSequence seq)
+{
+    Counter counter = {.table = table};
+    count_sequence(&counter, seq);
+}
+
+void
+binding_table_free(BindingTable* table)
+{
+    free(table->elements);
+    *table = (BindingTable){0};
+}
+
+void
+scoped_flag_set(ScopedFlags* flags, bool* flag)
+{
+    if (*flag) return;
+    if (flags->count == flags->capacity) {
+        flags->capacity = (flags->capacity) ? flags->capacity * 2 : 16;
+        flags->elements = realloc(flags->elements, sizeof(bool*) * flags->capacity);
+        if (!flags->elements) error("out of memory");
+    }
+    *flag = true;
+    flags->elements[flags->count++] = flag;
+}
+
+void
+scoped_flags_unwind(ScopedFlags* flags, size_t scope)
+{
+    while (flags->count > scope) *flags->elements[--flags->count] = false;
+}
+
+void
+scoped_flags_free(ScopedFlags* flags)
+{
+    free(flags->elements);
+    *flags = (ScopedFlags){0};
+}
@@ -0,0 +1,77 @@
+#ifndef OPTIMIZER_HELPERS_H
+#define OPTIMIZER_HELPERS_H
+
+#include "compiler.h"
+
+#define IS_LITERAL(ident)                                                                \
+    ((ident).kind == IDENT_INT_LITERAL || (ident).kind == IDENT_FLOAT_LITERAL ||        \
+     (ident).kind == IDENT_STRING_LITERAL)
+
+#define IS_LIB_FUNCTION(function_data, lib_function)                                     \
+    ((function_data).name == NPLIB_FUNCTION_DATA[lib_function].name)
+
+typedef enum {
+    OPERAND_DECLARE,
+    OPERAND_WRITE,
+    // read by value so it may be replaced by a constant
+    OPERAND_READ,
+    // read in a way that requires the storage itself
+    OPERAND_USE,
+} OperandRole;
+
+typedef void (*OperandVisitor)(void* ctx, StorageIdent* ident, OperandRole role);
+
+// visits the operands of `operation`
+void visit_operation(OperationInst* operation, OperandVisitor visit, void* ctx);
+// visits the operands of `inst` itself, nested sequences are left to the caller
+void visit_instruction(Instruction* inst, OperandVisitor visit, void* ctx);
+// visits the operands of every instruction in `seq` and the sequences nested within it
+void visit_sequence(InstructionSequence seq, OperandVisitor visit, void* ctx);
+
+typedef struct {
+    // Variable* for program variables or the name of a compiler temporary
+    const void* key;
+    bool is_variable;
+    // declared by the program rather than owned by the runtime library
+    bool declared;
+    // assigned before the program gets to it, arguments and self
+    bool external;
+    // may be written through a reference
+    bool escapes;
+    size_t writes;
+    size_t reads;
+    // the function containing the writes, NULL for the top level
+    FunctionStatement* writer;
+    bool written_by_many_functions;
+
+    // state belonging to the pass currently running
+    bool is_known;
+    bool is_assigned;
+    StorageIdent value;
+    size_t loop_writes;
+} Binding;
+
+typedef struct {
+    size_t count;
+    size_t capacity;
+    Binding* elements;
+} BindingTable;
+
+// returns NULL for identifiers that don't name any storage
+Binding* get_binding(BindingTable* table, StorageIdent ident, bool create);
+// records how every binding within `seq` is declared, written and read
+void count_bindings(BindingTable* table, InstructionSequence seq);
+void binding_table_free(BindingTable* table);
+
+// flags that are cleared again once the sequence that set them is left
+typedef struct {
+    size_t count;
+    size_t capacity;
+    bool** elements;
+} ScopedFlags;
+
+void scoped_flag_set(ScopedFlags* flags, bool* flag);
+void scoped_flags_unwind(ScopedFlags* flags, size_t scope);
+void scoped_flags_free(ScopedFlags* flags);
+
+#endif
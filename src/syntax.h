@@ -85,7 +85,7 @@ struct Operand {
 };
 
 struct Operation {
-    Location* loc;
+    Location loc;
     Operator op_type;
     size_t left;
     size_t right;
@@ -176,6 +176,10 @@ typedef struct {
     size_t what_count;
     SourceString* what;
     SourceString* as;
+    // filled in when the modules of a program are linked together
+    const char* module_init;
+    size_t symbols_count;
+    Symbol* symbols;
 } ImportStatement;
 
 typedef struct {
@@ -234,6 +238,8 @@ struct Signature {
 typedef struct {
     SourceString name;
     SourceString ns_ident;
+    // name of the C function, assigned by the compiler
+    const char* compiled_name;
     Signature sig;
     bool is_method;
     Block body;
@@ -333,12 +339,17 @@ struct Variable {
         VAR_CLOSURE_ARGUMENT
     } kind;
     union {
-        bool in_scope;          // VAR_SEMI_SCOPED
-        size_t closure_offset;  // VAR_CLOSURE / VAR_CLOSURE_ARGUMENT
+        bool in_scope;  // VAR_SEMI_SCOPED
+        struct {        // VAR_CLOSURE / VAR_CLOSURE_ARGUMENT
+            size_t closure_index;
+            const char* closure_type;
+        };
     };
     SourceString identifier;
     SourceString compiled_name;
     TypeInfo type_info;
+    // imported by another module which may read or write it during any call
+    bool shared;
 };
 
 struct Symbol {
@@ -0,0 +1,31 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+// clock_gettime needs _POSIX_C_SOURCE 199309L or later defined by the includer
+
+#include <time.h>
+
+static inline double
+timespec_seconds(struct timespec ts)
+{
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static inline double
+wall_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return timespec_seconds(ts);
+}
+
+// summed over every thread of the process
+static inline double
+cpu_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return timespec_seconds(ts);
+}
+
+#endif
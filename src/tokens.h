@@ -1,6 +1,7 @@
 #ifndef TOKENS_H
 #define TOKENS_H
 
+#include <stdint.h>
 #include <string.h>
 
 #include "generated.h"
@@ -34,8 +35,10 @@ typedef struct {
     size_t length;
 } SourceString;
 
+// identifiers from the same file are interned so they're usually the same pointer
 #define SOURCESTRING_EQ(str1, str2)                                                      \
-    str1.length == str2.length&& strcmp(str1.data, str2.data) == 0
+    ((str1).length == (str2).length &&                                                   \
+     ((str1).data == (str2).data || strcmp((str1).data, (str2).data) == 0))
 
 typedef struct {
     const char* filepath;
@@ -44,7 +47,9 @@ typedef struct {
 } Location;
 
 typedef struct {
-    Location* loc;
+    // where the token begins within its file, the line and column are only worked out
+    // from the FileIndex when they're needed
+    uint32_t offset;
     TokenType type;
     union {
         Keyword kw;
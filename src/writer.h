@@ -3,6 +3,44 @@
 
 #include "compiler.h"
 
-void write_c_program(CompiledInstructions instructions, FILE* out);
+typedef struct {
+    // include not_python_inline.h so runtime fast paths can be inlined
+    bool inline_runtime;
+    // time every function with the runtime's np_profile hooks
+    bool profile;
+    // attribute every allocation to the line of the program that made it
+    bool trace_allocs;
+    // map the C back onto the source with #line directives
+    bool line_directives;
+    // the name cc is given the C by, needed with `line_directives` to map the code the
+    // writer adds itself back onto the C
+    const char* c_filepath;
+} WriterOptions;
+
+// a program whose function definitions are spread over several translation units, every
+// unit includes `header` by `header_name` and the first also defines the globals, the
+// module's init function and main
+typedef struct {
+    FILE* header;
+    const char* header_name;
+    size_t units_count;
+    FILE** units;
+} SplitOutput;
+
+// the C of a program held in memory until it's written out, so the output, like a pipe
+// into cc, only has to be opened once the whole program has been generated
+typedef struct PendingC PendingC;
+
+PendingC* generate_c_program(CompiledInstructions instructions, WriterOptions opts);
+// frees `program` once it's written
+size_t write_pending_c(PendingC* program, FILE* out);
+
+// these and write_pending_c return how many bytes of C were written
+size_t write_c_program(CompiledInstructions instructions, FILE* out, WriterOptions opts);
+size_t write_c_program_split(
+    CompiledInstructions instructions, SplitOutput out, WriterOptions opts
+);
+// how many translation units, up to `max_units`, the program is worth splitting into
+size_t split_units_count(CompiledInstructions instructions, size_t max_units);
 
 #endif